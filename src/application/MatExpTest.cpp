@@ -9,12 +9,39 @@ vec    TIME_LIST;
 SumKronProd SKP;
 cx_double PREFACTOR;
 
+/// A dense Hermitian matrix as a QuantumOperator of a single subsystem.
+class DenseOperator:public QuantumOperator
+{
+public:
+    DenseOperator(const cx_mat& H)
+    {
+        _dimension = H.n_rows;
+        _dim_list = DIM_LIST(1, H.n_rows);
+        KronProd kp(_dim_list);
+        kp.fill(INDICES(1, 0), 1.0, TERM(1, H));
+        _kron_form = SumKronProd( vector<KronProd>(1, kp) );
+        invalidate_plan();
+    };
+};
+
 void prepare_data(string filename);
+void make_test_hamiltonians(int nspin, Hamiltonian& h0, Hamiltonian& h1, vector<cSPIN>& sl);
 void test_small_mat();
 cx_mat test_large_mat();
 cx_mat test_large_mat_sparse();
 cx_mat test_very_large_mat_CPU();
 cx_mat test_very_large_mat_GPU();
+cx_mat test_very_large_mat_native();
+cx_mat test_large_mat_lanczos();
+cx_mat test_large_mat_sparse_native();
+cx_vec test_block_krylov();
+cx_mat test_very_large_mat_chebyshev();
+void test_spin_pair();
+void test_trace_evolution();
+void test_batch_coherence();
+void test_trotter();
+void test_floquet();
+void test_liouville_expand();
 
 int  main(int argc, char* argv[])
 {
@@ -26,11 +53,28 @@ int  main(int argc, char* argv[])
     cx_mat res_large_sp = test_large_mat_sparse();
     cx_mat res_very_large_CPU = test_very_large_mat_CPU();
     cx_mat res_very_large_GPU = test_very_large_mat_GPU();
+    cx_mat res_very_large_native = test_very_large_mat_native();
+    cx_mat res_large_lanczos = test_large_mat_lanczos();
+    cx_mat res_large_sp_native = test_large_mat_sparse_native();
+    cx_vec res_block = test_block_krylov();
+    cx_mat res_chebyshev = test_very_large_mat_chebyshev();
 
     cout << "diff 1 = " << norm(res_large_sp - res_large) << endl;
     cout << "diff 2 = " << norm(res_very_large_CPU - res_large) << endl;
     cout << "diff 3 = " << norm(res_very_large_GPU - res_large) << endl;
     cout << "diff 4 = " << norm(res_very_large_GPU - res_very_large_CPU) << endl;
+    cout << "diff 5 = " << norm(res_very_large_native - res_large) << endl;
+    cout << "diff 6 = " << norm(res_large_lanczos - res_large) << endl;
+    cout << "diff 7 = " << norm(res_large_sp_native - res_large) << endl;
+    cout << "diff 8 = " << norm(res_block - res_large.col(res_large.n_cols-1)) << endl;
+    cout << "diff 9 = " << norm(res_chebyshev - res_large) << endl;
+
+    test_spin_pair();
+    test_trace_evolution();
+    test_batch_coherence();
+    test_trotter();
+    test_floquet();
+    test_liouville_expand();
     return 0;
 }
 
@@ -62,8 +106,30 @@ void prepare_data(string filename)
     TIME_LIST = linspace<vec>(0.01, 0.1, 10);
 }/*}}}*/
 
+void make_test_hamiltonians(int nspin, Hamiltonian& h0, Hamiltonian& h1, vector<cSPIN>& sl)
+{/*{{{*/
+/// The first nspin spins of RoyCoord.xyz8 with their dipolar couplings; the two Hamiltonians
+/// differ by the field, as for the two center spin states.
+    cSpinSourceFromFile spin_file("./dat/input/RoyCoord.xyz8");
+    cSpinCollection spins(&spin_file);
+    spins.make();
+    vector<cSPIN> all = spins.getSpinList();
+    sl = vector<cSPIN>(all.begin(), all.begin()+nspin);
+
+    vec B0, B1;
+    B0 << 0.0 << 0.0 << 1e-3;
+    B1 << 2e-4 << 0.0 << 1.5e-3;
+    SpinDipolarInteraction dip(sl);
+    SpinZeemanInteraction zee0(sl, B0), zee1(sl, B1);
+    h0 = Hamiltonian(sl); h1 = Hamiltonian(sl);
+    h0.addInteraction(dip); h0.addInteraction(zee0); h0.make();
+    h1.addInteraction(dip); h1.addInteraction(zee1); h1.make();
+}/*}}}*/
+
 void test_small_mat()
 {/*{{{*/
+    // the scaling and squaring object is shared by all the times, as in the piecewise evolutions
+    MatExp expM3(MAT, MatExp::ScalingSquaring);
     for(int i=0; i<TIME_LIST.size(); ++i)
     {
         MatExp expM(MAT, PREFACTOR*TIME_LIST(i), MatExp::ArmadilloExpMat);
@@ -74,8 +140,10 @@ void test_small_mat()
         
         cx_mat resArma = expM.getResultMatrix();
         cx_mat resPade = expM2.getResultMatrix();
+        cx_mat resSS;
+        expM3.run(PREFACTOR*TIME_LIST(i), resSS);
         cout << "t = " << TIME_LIST(i) << "; diff = " ;
-        cout << norm(resArma-resPade) << endl; 
+        cout << norm(resArma-resPade) << "; diff_ss = " << norm(resArma-resSS) << endl; 
     }
 }/*}}}*/
 
@@ -115,3 +183,354 @@ cx_mat test_very_large_mat_GPU()
     MatExpVector expM(SKP, VEC, TIME_LIST, MatExpVector::InexplicitGPU);  
     return expM.run();
 }/*}}}*/
+
+cx_mat test_very_large_mat_native()
+{/*{{{*/
+    cout << endl;
+    cout << "Begin VERY_LARGE_MAT with native C++ engine " <<  endl;
+
+    MatExpVector expM(SKP, VEC, TIME_LIST, MatExpVector::InexplicitNative);  
+    return expM.run();
+}/*}}}*/
+
+cx_mat test_large_mat_lanczos()
+{/*{{{*/
+    cout << endl;
+    cout << "begin LARGE DENSE MAT with Lanczos" <<  endl;
+
+    MatExpVector expM(MAT, VEC, PREFACTOR, TIME_LIST);
+    expM.enable_hermitian();
+    return expM.run();
+}/*}}}*/
+
+cx_mat test_large_mat_sparse_native()
+{/*{{{*/
+    cout << endl;
+    cout << "begin LARGE SPARSE MAT with native C++ driver" <<  endl;
+
+    sp_cx_mat mat_sparse = sp_cx_mat(MAT);
+    MatExpVector expM(mat_sparse, VEC, PREFACTOR, TIME_LIST);
+    expM.enable_native();
+    cx_mat res = expM.run();
+    cout << "matvec = " << expM.getStats().nMatVec << "; steps = " << expM.getStats().nStep 
+         << "; err = " << expM.getStats().err_total << endl;
+    return res;
+}/*}}}*/
+
+cx_vec test_block_krylov()
+{/*{{{*/
+    cout << endl;
+    cout << "begin VERY_LARGE_MAT with a block of vectors" <<  endl;
+
+    // VEC and a few other basis states, propagated together; the first column is compared
+    int dim = VEC.n_elem, nb = 4;
+    cx_mat block = zeros<cx_mat>(dim, nb);
+    for(int b=0; b<nb; ++b)
+        block(b*(dim/nb), b) = 1.0;
+
+    KronApply op(SKP);
+    BlockKrylovExpv<KronApply> expv_run(op, dim, PREFACTOR);
+    cx_mat res;
+    expv_run.run(block, TIME_LIST(TIME_LIST.n_elem-1), res);
+    cout << "matvec = " << expv_run.getStats().nMatVec << "; steps = " << expv_run.getStats().nStep 
+         << "; err = " << expv_run.getStats().err_total << endl;
+    return res.col(0);
+}/*}}}*/
+
+cx_mat test_very_large_mat_chebyshev()
+{/*{{{*/
+    cout << endl;
+    cout << "Begin VERY_LARGE_MAT with Chebyshev expansion " <<  endl;
+
+    MatExpVector expM(SKP, VEC, TIME_LIST, MatExpVector::InexplicitChebyshev);  
+    cx_mat res = expM.run();
+    cout << "matvec = " << expM.getStats().nMatVec << "; steps = " << expM.getStats().nStep 
+         << "; err = " << expM.getStats().err_total << endl;
+    return res;
+}/*}}}*/
+
+void test_spin_pair()
+{/*{{{*/
+    cout << endl;
+    cout << "Begin spin pair: closed form vs. the piecewise engines" <<  endl;
+
+    vector<cSPIN> pair_list;
+    Hamiltonian hami0, hami1;
+    make_test_hamiltonians(2, hami0, hami1, pair_list);
+
+    vector<cx_mat> hm_list;
+    hm_list.push_back( hami0.getMatrix() );
+    hm_list.push_back( hami1.getMatrix() );
+    SpinPairCoherence pair(hm_list);
+
+    vec time_list = linspace<vec>(0.0, 0.1, 11);
+    PureState psi(4);
+    psi.setComponent(1, 1.0);
+    for(int pulse_num=1; pulse_num<=4; ++pulse_num)
+    {
+        vector<double> time_segment = Pulse_Interval("CPMG", pulse_num);
+
+        // ensemble: Re tr(L R)/4
+        vector<QuantumOperator> left_hm_list = riffle((QuantumOperator) hami0, (QuantumOperator) hami1, pulse_num);
+        vector<QuantumOperator> right_hm_list = pulse_num % 2 == 0 ?
+            riffle((QuantumOperator) hami1, (QuantumOperator) hami0, pulse_num) : left_hm_list;
+        PiecewiseTraceEvolution trace_kernel(left_hm_list, right_hm_list, time_segment, 4);
+        trace_kernel.setTimeSequence(time_list(0), time_list(time_list.n_elem-1), time_list.n_elem);
+        ClusterCoherenceEvolution trace_dynamics(&trace_kernel);
+        trace_dynamics.run();
+        vector<int> left_index = riffle(0, 1, pulse_num);
+        vector<int> right_index = pulse_num % 2 == 0 ? riffle(1, 0, pulse_num) : left_index;
+        vec trace_pair = pair.getTraceList(left_index, right_index, time_segment, time_list, eye<cx_mat>(4, 4)/4.0);
+
+        // single sample: Re <psi_1|psi_2>
+        vector<QuantumOperator> hm_list1 = riffle((QuantumOperator) hami0, (QuantumOperator) hami1, pulse_num);
+        vector<QuantumOperator> hm_list2 = riffle((QuantumOperator) hami1, (QuantumOperator) hami0, pulse_num);
+        PiecewiseEigenVectorEvolution kernel1(hm_list1, time_segment, psi);
+        PiecewiseEigenVectorEvolution kernel2(hm_list2, time_segment, psi);
+        kernel1.setTimeSequence(time_list(0), time_list(time_list.n_elem-1), time_list.n_elem);
+        kernel2.setTimeSequence(time_list(0), time_list(time_list.n_elem-1), time_list.n_elem);
+        ClusterCoherenceEvolution dynamics1(&kernel1);
+        dynamics1.run();
+        vector<cx_vec> state1 = kernel1.getResult();
+        OverlapObserver obs(state1);
+        kernel2.setObserver(&obs);
+        ClusterCoherenceEvolution dynamics2(&kernel2);
+        dynamics2.run();
+        vec overlap_pair = pair.getOverlapList(riffle(0, 1, pulse_num), riffle(1, 0, pulse_num), time_segment, time_list, psi.getVector());
+
+        cout << "pulse_num = " << pulse_num << "; diff_ensemble = " << norm(trace_pair - trace_kernel.getTraceList())
+             << "; diff_single_sample = " << norm(overlap_pair - obs.getResult()) << endl;
+    }
+}/*}}}*/
+
+void test_trace_evolution()
+{/*{{{*/
+    cout << endl;
+    cout << "Begin trace evolution vs. PiecewiseFullMatrixMatrixEvolution" <<  endl;
+
+    vector<cSPIN> spin_list;
+    Hamiltonian hami0, hami1;
+    make_test_hamiltonians(4, hami0, hami1, spin_list);
+    int dim = hami0.getDimension();
+
+    // rho ~ I, normalized below by its trace, and a polarized rho
+    vec pol0 = zeros<vec>(3), pol1;
+    pol1 << 0.0 << 0.0 << 0.3;
+    SpinPolarization p0(spin_list, pol0), p1(spin_list, pol1);
+    DensityOperator ds0(spin_list), ds1(spin_list);
+    ds0.addStateComponent(p0); ds0.make(); ds0.makeVector();
+    ds1.addStateComponent(p1); ds1.make(); ds1.makeVector();
+
+    vec time_list = linspace<vec>(0.0, 0.1, 11);
+    for(int pulse_num=1; pulse_num<=3; ++pulse_num)
+    {
+        vector<double> time_segment = Pulse_Interval("CPMG", pulse_num);
+        vector<QuantumOperator> left_hm_list = riffle((QuantumOperator) hami0, (QuantumOperator) hami1, pulse_num);
+        vector<QuantumOperator> right_hm_list = pulse_num % 2 == 0 ?
+            riffle((QuantumOperator) hami1, (QuantumOperator) hami0, pulse_num) : left_hm_list;
+
+        PiecewiseTraceEvolution identity_kernel(left_hm_list, right_hm_list, time_segment, dim);
+        PiecewiseTraceEvolution polarized_kernel(left_hm_list, right_hm_list, time_segment, ds1);
+        PiecewiseFullMatrixMatrixEvolution full_kernel0(left_hm_list, right_hm_list, time_segment, ds0);
+        PiecewiseFullMatrixMatrixEvolution full_kernel1(left_hm_list, right_hm_list, time_segment, ds1);
+        TraceObserver obs0(time_list.n_elem), obs1(time_list.n_elem);
+        full_kernel0.setObserver(&obs0);
+        full_kernel1.setObserver(&obs1);
+
+        QuantumEvolutionAlgorithm* kernel_list[4] = {&identity_kernel, &polarized_kernel, &full_kernel0, &full_kernel1};
+        for(int k=0; k<4; ++k)
+        {
+            kernel_list[k]->setTimeSequence(time_list(0), time_list(time_list.n_elem-1), time_list.n_elem);
+            ClusterCoherenceEvolution dynamics(kernel_list[k]);
+            dynamics.run();
+        }
+
+        vec full0 = obs0.getResult();
+        cout << "pulse_num = " << pulse_num 
+             << "; diff_identity = " << norm(identity_kernel.getTraceList() - full0/full0(0))
+             << "; diff_polarized = " << norm(polarized_kernel.getTraceList() - obs1.getResult()) << endl;
+    }
+}/*}}}*/
+
+void test_batch_coherence()
+{/*{{{*/
+    cout << endl;
+    cout << "Begin BatchPiecewiseCoherence vs. PiecewiseFullMatrixVectorEvolution" <<  endl;
+
+    arma_rng::set_seed(7);
+    vec time_list = linspace<vec>(0.0, 2.0, 21);
+    int pulse_num = 4, batch_size = 5;
+    vector<double> time_segment = Pulse_Interval("CPMG", pulse_num);
+    vector<int> op_index1 = riffle(0, 1, pulse_num), op_index2 = riffle(1, 0, pulse_num);
+    int dim_list[4] = {2, 4, 8, 16};
+    for(int n=0; n<4; ++n)
+    {
+        int dim = dim_list[n];
+        BatchPiecewiseCoherence batch(dim, batch_size, 2);
+        vector<cx_mat> H0_list, H1_list;
+        vector<cx_vec> psi_list;
+        for(int b=0; b<batch_size; ++b)
+        {
+            cx_mat A = randu<cx_mat>(dim, dim) - cx_double(0.5, 0.5), B = randu<cx_mat>(dim, dim) - cx_double(0.5, 0.5);
+            cx_vec psi = randu<cx_vec>(dim) - cx_double(0.5, 0.5);
+            H0_list.push_back( cx_mat(A+A.t()) );
+            H1_list.push_back( cx_mat(B+B.t()) );
+            psi_list.push_back( psi/norm(psi) );
+            batch.setOperator(b, 0, H0_list[b]);
+            batch.setOperator(b, 1, H1_list[b]);
+            batch.setState(b, psi_list[b]);
+        }
+        mat res_batch = batch.run(op_index1, op_index2, time_segment, time_list);
+
+        double diff = 0.0;
+        for(int b=0; b<batch_size; ++b)
+        {
+            DenseOperator H0(H0_list[b]), H1(H1_list[b]);
+            vector<QuantumOperator> hm_list1 = riffle((QuantumOperator) H0, (QuantumOperator) H1, pulse_num);
+            vector<QuantumOperator> hm_list2 = riffle((QuantumOperator) H1, (QuantumOperator) H0, pulse_num);
+            PureState psi(psi_list[b]);
+            PiecewiseFullMatrixVectorEvolution kernel1(hm_list1, time_segment, psi);
+            PiecewiseFullMatrixVectorEvolution kernel2(hm_list2, time_segment, psi);
+            kernel1.setTimeSequence(time_list(0), time_list(time_list.n_elem-1), time_list.n_elem);
+            kernel2.setTimeSequence(time_list(0), time_list(time_list.n_elem-1), time_list.n_elem);
+            ClusterCoherenceEvolution dynamics1(&kernel1);
+            dynamics1.run();
+            vector<cx_vec> state1 = kernel1.getResult();
+            OverlapObserver obs(state1);
+            kernel2.setObserver(&obs);
+            ClusterCoherenceEvolution dynamics2(&kernel2);
+            dynamics2.run();
+            diff = max(diff, norm(res_batch.col(b) - obs.getResult()));
+        }
+        cout << "dim = " << dim << "; diff = " << diff << endl;
+    }
+}/*}}}*/
+
+void test_trotter()
+{/*{{{*/
+    cout << endl;
+    cout << "Begin Trotter S2 and S4 vs. the exact evolution" <<  endl;
+
+    // the Hamiltonian with the tilted field
+    vector<cSPIN> spin_list;
+    Hamiltonian hami0, hami;
+    make_test_hamiltonians(4, hami0, hami, spin_list);
+
+    PureState psi(spin_list);
+    vector<QuantumOperator> hm_list(1, (QuantumOperator) hami);
+    vector<double> time_segment(1, 1.0);
+    double T = 1.0;
+
+    PiecewiseFullMatrixVectorEvolution exact_kernel(hm_list, time_segment, psi);
+    exact_kernel.setTimeSequence(0.0, T, 2);
+    ClusterCoherenceEvolution exact_dynamics(&exact_kernel);
+    exact_dynamics.run();
+    cx_vec exact = exact_kernel.getResult()[1];
+
+    // err ~ N^{-order} for N steps: the order follows from two tolerances
+    double tol_list[2] = {1e-6, 1e-10};
+    int order_list[2] = {2, 4};
+    for(int n=0; n<2; ++n)
+    {
+        double err[2], step[2];
+        for(int q=0; q<2; ++q)
+        {
+            PiecewiseTrotterVectorEvolution kernel(hm_list, time_segment, psi, order_list[n]);
+            kernel.setTolerance(tol_list[q]);
+            kernel.setTimeSequence(0.0, T, 2);
+            ClusterCoherenceEvolution dynamics(&kernel);
+            dynamics.run();
+            err[q] = norm(kernel.getResult()[1] - exact);
+            step[q] = kernel.getStepNum();
+        }
+        cout << "S" << order_list[n] << ": steps = " << step[0] << ", " << step[1] 
+             << "; err = " << err[0] << ", " << err[1] 
+             << "; order = " << log(err[0]/err[1]) / log(step[1]/step[0]) << endl;
+    }
+}/*}}}*/
+
+void test_floquet()
+{/*{{{*/
+    cout << endl;
+    cout << "Begin Floquet vs. PiecewiseFullMatrixVectorEvolution over several periods" <<  endl;
+
+    vector<cSPIN> spin_list;
+    Hamiltonian hami0, hami1;
+    make_test_hamiltonians(4, hami0, hami1, spin_list);
+
+    int pulse_num = 2, period_num = 5;
+    double period = 0.05;
+    vector<double> time_segment = Pulse_Interval("CPMG", pulse_num);
+    vector<QuantumOperator> hm_list = riffle((QuantumOperator) hami0, (QuantumOperator) hami1, pulse_num);
+    PureState psi(spin_list);
+
+    FloquetVectorEvolution floquet_kernel(hm_list, time_segment, period, psi);
+    floquet_kernel.setTimeSequence(0.0, period_num*period, period_num+1);
+    ClusterCoherenceEvolution floquet_dynamics(&floquet_kernel);
+    floquet_dynamics.run();
+    vector<cx_vec> floquet_state = floquet_kernel.getResult();
+
+    // N periods as one piecewise sequence of N copies, the fractions divided by N
+    for(int N=1; N<=period_num; ++N)
+    {
+        vector<QuantumOperator> seq_hm_list;
+        vector<double> seq_time_segment;
+        for(int n=0; n<N; ++n)
+            for(int j=0; j<hm_list.size(); ++j)
+            {
+                seq_hm_list.push_back(hm_list[j]);
+                seq_time_segment.push_back(time_segment[j]/N);
+            }
+        PiecewiseFullMatrixVectorEvolution kernel(seq_hm_list, seq_time_segment, psi);
+        kernel.setTimeSequence(0.0, N*period, 2);
+        ClusterCoherenceEvolution dynamics(&kernel);
+        dynamics.run();
+        cout << "periods = " << N << "; diff = " << norm(floquet_state[N] - kernel.getResult()[1]) << endl;
+    }
+}/*}}}*/
+
+void test_liouville_expand()
+{/*{{{*/
+    cout << endl;
+    cout << "Begin LiouvilleExpand vs. Expand and the commutator superoperator" <<  endl;
+
+    // a spin-1/2 and a spin-1, with a single-spin and a two-spin term
+    arma_rng::set_seed(11);
+    DIM_LIST dim_list;
+    dim_list.push_back(2); dim_list.push_back(3);
+    vector<KronProd> kp_list;
+    for(int t=0; t<2; ++t)
+    {
+        INDICES idx;
+        TERM mat;
+        for(int k=0; k<=t; ++k)
+        {
+            cx_mat A = randu<cx_mat>(dim_list[k], dim_list[k]) - cx_double(0.5, 0.5);
+            idx.push_back(k);
+            mat.push_back( cx_mat(A+A.t()) );
+        }
+        KronProd kp(dim_list);
+        kp.fill(idx, 0.7+t, mat);
+        kp_list.push_back(kp);
+    }
+    SumKronProd skp(kp_list);
+    cx_mat H = skp.full();
+
+    cout << "diff FLAT  = " << norm(LiouvilleExpand(skp, FLAT).full() - Expand(skp, FLAT).full()) << endl;
+    cout << "diff SHARP = " << norm(LiouvilleExpand(skp, SHARP).full() - Expand(skp, SHARP).full()) << endl;
+
+    // the modes of LiouvilleExpand run (col_0, row_0, col_1, row_1); vec(rho) of the whole
+    // space is (col, row) with rho(row, col) at row + D*col
+    size_t D = H.n_rows;
+    uvec perm(D*D);
+    for(size_t c=0; c<D; ++c)
+        for(size_t r=0; r<D; ++r)
+        {
+            size_t c0 = c/dim_list[1], c1 = c%dim_list[1], r0 = r/dim_list[1], r1 = r%dim_list[1];
+            perm(r + D*c) = ((c0*dim_list[0] + r0)*dim_list[1] + c1)*dim_list[1] + r1;
+        }
+    cx_mat Id = eye<cx_mat>(D, D);
+    cx_mat L = LiouvilleExpand(skp, CIRCLEC).full();
+    cx_mat L_global = L.submat(perm, perm);
+    cout << "diff CIRCLEC = " << norm(L_global - ( kron(Id, H) - kron(conj(H), Id) )) << endl;
+}/*}}}*/
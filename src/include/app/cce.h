@@ -1,9 +1,16 @@
 #include "include/oops.h"
 #include "include/app/DefectCenter.h"
+#include "include/quantum/BatchEvolution.h"
+#include "include/quantum/PairEvolution.h"
+#include <map>
 
 extern string INPUT_PATH;
 extern string OUTPUT_PATH;
 
+const int CLUSTER_BATCH_SIZE    = 256; ///< clusters handed to cluster_evolution_batch at once
+const int CLUSTER_BATCH_MAX_DIM = 16;  ///< larger clusters are not batched
+const int TYPICALITY_MIN_SPIN   = 10;  ///< smaller ensemble clusters are traced exactly
+
 ////////////////////////////////////////////////////////////////////////////////
 //{{{  CCE
 class CCE
@@ -37,6 +44,7 @@ protected:
     vec              _magB;
     string           _pulse_name;
     int              _pulse_num;
+    bool             _is_secular;
 
     int              _my_rank;
     int              _worker_num;
@@ -52,6 +60,8 @@ protected:
     mat              _final_result;
     mat              _final_result_each_order;
 
+    static bool      is_spin_half_pair(const vector<cSPIN>& spin_list);
+    void             check_secular_field();
 private:
     virtual void     set_parameters()=0;
     void             prepare_center_spin();
@@ -63,6 +73,7 @@ private:
     void             DataGathering(mat& resMat, int cce_order, int clst_num);
 
     virtual vec      cluster_evolution(int cce_order, int index)=0;
+    virtual mat      cluster_evolution_batch(int cce_order, const vector<int>& index_list);
     //virtual vec      calc_observables(QuantumEvolutionAlgorithm* ker)=0;
     void             post_treatment();
     void             cce_coherence_reduction();
@@ -76,6 +87,9 @@ private:
 
 ////////////////////////////////////////////////////////////////////////////////
 //{{{  EnsembleCCE
+/// The ensemble-averaged coherence Re tr(L rho R) of each cluster. cluster_evolution_batch
+/// traces the small clusters together by BatchPiecewiseCoherence, as SingleSampleCCE does
+/// for its pure-state overlaps.
 class EnsembleCCE:public CCE
 {
 public:
@@ -88,12 +102,15 @@ private:
     void set_parameters();
     void prepare_bath_state();
     vec cluster_evolution(int cce_order, int index);
+    mat cluster_evolution_batch(int cce_order, const vector<int>& index_list);
     Hamiltonian create_spin_hamiltonian(const cSPIN& espin, const PureState& center_spin_stat, const vector<cSPIN>& spin_list);
     Liouvillian create_spin_liouvillian(const Hamiltonian& hami0, const Hamiltonian hami1);
     DensityOperator create_spin_density_state(const vector<cSPIN>& spin_list);
 
     vec _bath_polarization;
-    vec calc_observables(QuantumEvolutionAlgorithm* ker);
+    int _typicality_sample_num;
+    bool   _is_single_precision;
+    double _single_precision_tol;
 };
 //}}}
 ////////////////////////////////////////////////////////////////////////////////
@@ -113,16 +130,17 @@ private:
     void set_parameters();
     void prepare_bath_state();
     vec cluster_evolution(int cce_order, int index);
+    mat cluster_evolution_batch(int cce_order, const vector<int>& index_list);
     Hamiltonian create_spin_hamiltonian(const cSPIN& espin, const PureState& center_spin_stat, const vector<cSPIN>& spin_list, const cClusterIndex& clstIndex);
     Liouvillian create_spin_liouvillian(const Hamiltonian& hami0, const Hamiltonian hami1);
     PureState create_cluster_state(const cClusterIndex& clstIndex);
 
     void cache_dipole_field();
-    vec calc_observables(QuantumEvolutionAlgorithm* ker1, QuantumEvolutionAlgorithm* ker2);
 
     int _bath_state_seed;
     vector< vector<vec> > _dipole_field_data;
     vector<PureState>     _bath_state_list;
+    mat                   _bath_spin_vectors;
 
 };
 //}}}
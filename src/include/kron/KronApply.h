@@ -0,0 +1,222 @@
+#ifndef KRONAPPLY_H
+#define KRONAPPLY_H
+
+#include <vector>
+#include <complex>
+#include <armadillo>
+#include "include/kron/KronProd.h"
+#include "include/kron/KronOperatorPlan.h"
+
+using namespace std;
+using namespace arma;
+
+/// \addtogroup KronProd
+/// @{
+
+/// \defgroup KronApply KronApply
+/// @{
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ Mode kernels
+/// y[i, p, j] (+)= alpha * sum_q A(p,q) * x[i, q, j],
+/// for i < m, p,q < s, j < n, i.e. the action of I_m (x) A (x) I_n.
+/// A is column-major and given by its real and imaginary parts,
+/// x and y are complex vectors stored as interleaved (re, im) pairs of T (double or float).
+/// With S>0 the local dimension is fixed at compile time and the q/p loops are unrolled;
+/// S=0 is the generic kernel with the runtime dimension s.
+template<int S, class T>
+void kron_mode_kernel(size_t m, size_t s_rt, size_t n, const T* Ar, const T* Ai,
+                      const T* x, T* y, T alpha, bool accumulate)
+{
+    const size_t s = S>0 ? S : s_rt;
+    const size_t block = 256;
+    const size_t nblk = (n + block - 1)/block;
+    const long   nwork = m*nblk;
+
+    #pragma omp parallel for schedule(static) if(nwork > 1 && m*s*n > 4096)
+    for(long w=0; w<nwork; ++w)
+    {
+        const size_t i  = w / nblk;
+        const size_t j0 = (w % nblk) * block;
+        const size_t j1 = j0+block < n ? j0+block : n;
+        const T* xi = x + 2*i*s*n;
+        T*       yi = y + 2*i*s*n;
+        for(size_t p=0; p<s; ++p)
+        {
+            T* yp = yi + 2*p*n;
+            if(!accumulate)
+                for(size_t j=2*j0; j<2*j1; ++j) yp[j] = 0.0;
+            for(size_t q=0; q<s; ++q)
+            {
+                const T ar = alpha*Ar[p+s*q];
+                const T ai = alpha*Ai[p+s*q];
+                if(ar == 0.0 && ai == 0.0) continue;
+                const T* xq = xi + 2*q*n;
+                #pragma omp simd
+                for(size_t j=j0; j<j1; ++j)
+                {
+                    const T xr = xq[2*j], xm = xq[2*j+1];
+                    yp[2*j]   += ar*xr - ai*xm;
+                    yp[2*j+1] += ar*xm + ai*xr;
+                }
+            }
+        }
+    }
+}
+
+void kron_mode_apply(size_t m, size_t s, size_t n, const double* Ar, const double* Ai,
+                     const cx_double* x, cx_double* y, double alpha, bool accumulate);
+void kron_mode_apply(size_t m, size_t s, size_t n, const float* Ar, const float* Ai,
+                     const cx_float* x, cx_float* y, float alpha, bool accumulate);
+
+/// x[a, p, b, q, c] <- sum_{p'q'} G(p*s2+q, p'*s2+q') x[a, p', b, q', c], in place,
+/// for a < m, b < mid, c < n, i.e. a dense gate G acting on two spins of dimensions s1 and s2
+/// (a single-spin gate is the case s2 = mid = 1). G is column-major and s1*s2 <= KRON_GATE_MAX_DIM.
+const size_t KRON_GATE_MAX_DIM = 256;
+void kron_gate_apply(size_t m, size_t s1, size_t mid, size_t s2, size_t n, const cx_double* G, cx_double* x);
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ KronApply
+/// This class applies a SumKronProd to a vector without forming the full matrix.
+/// It runs over a KronOperatorPlan; each factor of a term is applied by kron_mode_apply,
+/// which is specialized for the local dimensions 2, 3, 4 and 9.
+/// No BLAS or MKL routine is used.
+///
+/// When it is built from a plan, the plan is not copied and must outlive the KronApply object;
+/// when it is built from a SumKronProd, it compiles and keeps its own plan.
+/// apply() uses internal buffers, so one object should not be shared by several threads.
+///
+/// apply_block() applies H to nb vectors at once. The block is interleaved, X[r*nb+b] being the
+/// row r of the vector b (i.e. the nb x dim column-major matrix X^T); the factor I_m (x) A (x) I_n
+/// then acts on the block as I_m (x) A (x) I_{n*nb}, so each factor is streamed once per block
+/// and the innermost loop is at least nb long.
+///
+/// The cx_float overloads run the same products in single precision, with the float copies of
+/// the factors kept by the plan; they move half the bytes of the double ones.
+class KronApply
+{
+public:
+    KronApply();
+    KronApply(const SumKronProd& skp);
+    KronApply(const KronOperatorPlan& plan);
+    ~KronApply();
+
+    void   apply(const cx_double* x, cx_double* y) const {apply_block(x, y, 1);}; ///< y = H * x
+    void   apply_block(const cx_double* X, cx_double* Y, size_t nb) const;       ///< Y = H * X, interleaved
+    void   operator () (const cx_double* x, cx_double* y) const {apply(x, y);};
+    void   operator () (const cx_double* X, cx_double* Y, size_t nb) const {apply_block(X, Y, nb);};
+    void   apply(const cx_float* x, cx_float* y) const {apply_block(x, y, 1);};
+    void   apply_block(const cx_float* X, cx_float* Y, size_t nb) const;
+    void   operator () (const cx_float* x, cx_float* y) const {apply(x, y);};
+    void   operator () (const cx_float* X, cx_float* Y, size_t nb) const {apply_block(X, Y, nb);};
+    cx_vec operator * (const cx_vec& x) const;
+    size_t getDim() const {return getPlan().getDim();};
+    const KronOperatorPlan& getPlan() const {return _is_own_plan ? _own_plan : *_plan;};
+protected:
+private:
+    bool                    _is_own_plan;
+    KronOperatorPlan        _own_plan;
+    const KronOperatorPlan* _plan;
+
+    mutable cx_vec _buf1;
+    mutable cx_vec _buf2;
+    mutable cx_fvec _fbuf1;
+    mutable cx_fvec _fbuf2;
+
+    template<class T> void apply_terms(const complex<T>* X, complex<T>* Y, size_t nb,
+            const T* mat_re, const T* mat_im, Col< complex<T> >& buf1, Col< complex<T> >& buf2) const;
+};
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ KronSingleSpinExp
+/// exp(-i t H0) for an operator H0 made of single-spin terms only (e.g. the Zeeman terms),
+/// which factorizes into one s x s propagator per spin:
+///
+///   exp(-i t H0) = exp(-i t c0) (x)_k exp(-i t h_k),
+///
+/// c0 being the sum of the identity terms and h_k the sum of the terms acting on spin k.
+/// Each h_k is diagonalized once in the constructor; apply() builds the factors for the time t
+/// and applies them one spin after the other by kron_mode_apply, without forming the full matrix.
+/// X and Y are interleaved blocks as in KronApply::apply_block, and must not overlap.
+class KronSingleSpinExp
+{
+public:
+    KronSingleSpinExp();
+    KronSingleSpinExp(const KronOperatorPlan& plan);
+    ~KronSingleSpinExp();
+
+    void   apply(double t, const cx_double* x, cx_double* y) const {apply_block(t, x, y, 1);}; ///< y = exp(-i t H0) x
+    void   apply_block(double t, const cx_double* X, cx_double* Y, size_t nb) const;
+    size_t getDim() const {return _nDim;};
+protected:
+private:
+    size_t         _nDim;
+    double         _shift;
+    vector<size_t> _spin_dim;
+    vector<size_t> _stride_m;
+    vector<size_t> _stride_n;
+    vector<vec>    _eigval_list;
+    vector<cx_mat> _eigvec_list;
+
+    mutable cx_vec _buf1;
+    mutable cx_vec _buf2;
+};
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ KronSubspaceApply
+/// The nonzero elements of the column c of the operator of a plan, in ascending order of the row.
+/// Each factor only moves the digit of its own spin, so a column costs O(terms) and not O(dim);
+/// the terms are summed before the zeros are dropped (e.g. the double flips of Ix Ix + Iy Iy cancel).
+void kron_plan_column(const KronOperatorPlan& plan, size_t c, vector< pair<size_t, cx_double> >& col);
+
+/// H(sub, sub), the operator of a plan restricted to the basis states sub (ascending), in CSR form,
+/// built column by column by kron_plan_column. When H leaves the subspace invariant (e.g. a block of
+/// total Sz of a secular Hamiltonian), a vector of the subspace is evolved by this n x n matrix alone,
+/// n = sub.n_elem; isInvariant() is false if some element of H(:, sub) falls outside the subspace.
+/// apply_block() uses the interleaved layout of KronApply::apply_block, in double or single precision.
+class KronSubspaceApply
+{
+public:
+    KronSubspaceApply();
+    KronSubspaceApply(const KronOperatorPlan& plan, const uvec& sub);
+    ~KronSubspaceApply();
+
+    void   apply(const cx_double* x, cx_double* y) const {apply_block(x, y, 1);}; ///< y = H(sub, sub) * x
+    void   apply_block(const cx_double* X, cx_double* Y, size_t nb) const;
+    void   operator () (const cx_double* x, cx_double* y) const {apply(x, y);};
+    void   operator () (const cx_double* X, cx_double* Y, size_t nb) const {apply_block(X, Y, nb);};
+    void   apply(const cx_float* x, cx_float* y) const {apply_block(x, y, 1);};
+    void   apply_block(const cx_float* X, cx_float* Y, size_t nb) const;
+    void   operator () (const cx_float* x, cx_float* y) const {apply(x, y);};
+    void   operator () (const cx_float* X, cx_float* Y, size_t nb) const {apply_block(X, Y, nb);};
+    size_t getDim() const {return _nDim;};
+    bool   isInvariant() const {return _is_invariant;};
+protected:
+private:
+    size_t            _nDim;
+    bool              _is_invariant;
+    vector<size_t>    _row_ptr;
+    vector<size_t>    _col_idx;
+    vector<cx_double> _val;
+    vector<cx_float>  _val_f;
+
+    template<class T> void apply_rows(const complex<T>* X, complex<T>* Y, size_t nb, const vector< complex<T> >& val) const;
+};
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+/// @}
+/// @}
+#endif
@@ -0,0 +1,95 @@
+#ifndef KRONOPERATORPLAN_H
+#define KRONOPERATORPLAN_H
+
+#include <vector>
+#include <complex>
+#include <armadillo>
+#include "include/kron/KronProd.h"
+
+using namespace std;
+using namespace arma;
+
+/// \addtogroup KronProd
+/// @{
+
+/// \defgroup KronOperatorPlan KronOperatorPlan
+/// @{
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ KronOperatorPlan
+/// This class is the compiled form of a SumKronProd, used by the matrix-free evolutions.
+/// All the terms are flattened into SoA arrays once, in the layout of main_mkl_/main_cache_:
+///
+///   term k has coefficient coeff_list[k] and nBody_list[k] factors;
+///   the factors of term k are [pos_offset[k], pos_offset[k+1]);
+///   factor f acts on spin pos_list[f] of dimension dim_list[f], and its column-major
+///   matrix is matC[mat_offset[f] ... mat_offset[f+1]).
+///
+/// The stride tables nspin_m_lst/nspin_n_lst give, for each spin, the product of the
+/// dimensions before/after it, so that factor f acts as I_m (x) A (x) I_n.
+/// A plan is never modified after it is built, so its content hash is computed once
+/// in the constructor; two plans are equal when they hold the same terms in the same order.
+class KronOperatorPlan
+{
+public:
+    KronOperatorPlan();
+    KronOperatorPlan(const SumKronProd& skp);
+    ~KronOperatorPlan();
+
+    size_t getDim() const {return _nDim;};
+    size_t getSpinNum() const {return _nSpin;};
+    size_t getTermNum() const {return _nTerm;};
+    size_t getTotalBody() const {return _total_nbody;};
+    size_t getTotalMatSize() const {return _total_dim;};
+    size_t getHash() const {return _hash;};
+
+    const vector<double>&    getCoeffList() const {return _coeff_list;};
+    const vector<size_t>&    getBodyNumList() const {return _nBody_list;};
+    const vector<size_t>&    getPosOffset() const {return _pos_offset;};
+    const vector<size_t>&    getPosList() const {return _pos_list;};
+    const vector<size_t>&    getFactorDimList() const {return _dim_list;};
+    const vector<size_t>&    getMatOffset() const {return _mat_offset;};
+    const vector<cx_double>& getMatC() const {return _matC;};
+    const vector<double>&    getMatRe() const {return _mat_re;};
+    const vector<double>&    getMatIm() const {return _mat_im;};
+    const vector<float>&     getMatReF() const {return _mat_re_f;}; ///< single-precision copies
+    const vector<float>&     getMatImF() const {return _mat_im_f;};
+    const vector<size_t>&    getSpinDimList() const {return _spin_dim;};
+    const vector<size_t>&    getStrideM() const {return _nspin_m_lst;};
+    const vector<size_t>&    getStrideN() const {return _nspin_n_lst;};
+    void getSpectralBounds(double& emin, double& emax) const;
+
+    friend ostream&  operator << (ostream& outs, const KronOperatorPlan& plan);
+    friend bool operator == (const KronOperatorPlan& plan1, const KronOperatorPlan& plan2);
+protected:
+private:
+    size_t _nDim;
+    size_t _nSpin;
+    size_t _nTerm;
+    size_t _total_nbody;
+    size_t _total_dim;
+    size_t _hash;
+
+    vector<double>    _coeff_list;
+    vector<size_t>    _nBody_list;
+    vector<size_t>    _pos_offset;
+    vector<size_t>    _pos_list;
+    vector<size_t>    _dim_list;
+    vector<size_t>    _mat_offset;
+    vector<cx_double> _matC;
+    vector<double>    _mat_re;
+    vector<double>    _mat_im;
+    vector<float>     _mat_re_f;
+    vector<float>     _mat_im_f;
+    vector<size_t>    _spin_dim;
+    vector<size_t>    _nspin_m_lst;
+    vector<size_t>    _nspin_n_lst;
+
+    void make_hash();
+};
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+/// @}
+/// @}
+#endif
@@ -36,15 +36,15 @@ public:
     KronProd(DIM_LIST dim_list);
     ~KronProd();
 
-    cx_mat      full();
+    cx_mat      full() const;
     cx_vec      vecterize();
     void        fill(INDICES idx, MULTIPLIER coeff, TERM mat);
     KronProd&   scale(double factor) { _coeff *= factor; return *this;};
-    DIM_LIST    getDimList(){return _dim_list;};
+    const DIM_LIST& getDimList() const {return _dim_list;};
     size_t         getDim() const {return _dim;};
     MULTIPLIER  getCoeff() const {return _coeff;};
-    INDICES     getIndices() const {return _spin_index;};
-    TERM        getTermMat() const {return _mat;};
+    const INDICES& getIndices() const {return _spin_index;};
+    const TERM&    getTermMat() const {return _mat;};
     size_t         getKronNum() const {return _kron_num;};
     size_t         getMatNum() const {return _mat.size();};
 
@@ -73,10 +73,10 @@ public:
     SumKronProd(const vector<KronProd>& kp_lst);
     ~SumKronProd();
 
-    cx_mat full();
+    cx_mat full() const;
     cx_vec vecterize();
-    vector<KronProd> getKronProdList(){return _kron_prod_list;};
-    DIM_LIST getDimList(){return _dim_list;};
+    const vector<KronProd>& getKronProdList() const {return _kron_prod_list;};
+    const DIM_LIST& getDimList() const {return _dim_list;};
     size_t      getDim() const {return _dim;};
     size_t      getKronProdSize() const {return _kron_prod_list.size();};
 
@@ -90,6 +90,11 @@ public:
     vector<size_t>     getMatNumList() const;
     
     friend SumKronProd Expand(const SumKronProd& skp, MatExpanFunc * exppan_func);
+    /// Same operator on vec(rho) as Expand(skp, FLAT/SHARP/CIRCLEC), but each spin of dim d
+    /// is split into its column and row modes (d, d): FLAT places the factors on the row
+    /// modes (H rho), SHARP their transposes on the column modes (rho H), and CIRCLEC both,
+    /// H rho - rho H. No d^2-dimensional local matrix is built.
+    friend SumKronProd LiouvilleExpand(const SumKronProd& skp, MatExpanFunc * exppan_func);
     friend SumKronProd& operator + (SumKronProd& sum, const SumKronProd skp);
     friend ostream&  operator << (ostream& outs, SumKronProd& skp);
 protected:
@@ -0,0 +1,190 @@
+#ifndef CHEBYSHEVEXPV_H
+#define CHEBYSHEVEXPV_H
+
+#include <cmath>
+#include <vector>
+#include <iostream>
+#include <armadillo>
+#include "include/math/KrylovExpv.h"
+
+using namespace std;
+using namespace arma;
+
+/// \addtogroup KrylovExpv
+/// @{
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ ChebyshevExpv
+/// w(t_i) = exp(-i H t_i) v for a Hermitian H whose spectrum lies in [emin, emax],
+/// by the Chebyshev expansion of one step. With a = (emax-emin)/2, b = (emax+emin)/2
+/// and Hs = (H - b)/a,
+///
+///   exp(-i H dt) = exp(-i b dt) sum_k (2-delta_k0) (-i)^k J_k(a dt) T_k(Hs),
+///
+/// truncated after the last |J_k| above the tolerance (about a*dt + O((a*dt)^{1/3}) terms).
+/// The coefficients depend only on dt: on a uniform grid they are computed once, and each
+/// time point costs the same fixed number of matvecs, T_{k+1} = 2 Hs T_k - T_{k-1}, with
+/// no orthogonalization and no small exponential. A non-uniform interval gets its own coefficients.
+///
+/// MatVec is any functor with operator()(const cx_double* x, cx_double* y) computing y = H x.
+template<class MatVec>
+class ChebyshevExpv
+{
+public:
+    ChebyshevExpv(const MatVec& A, size_t dim, double emin, double emax) : _A(A), _dim(dim)
+    {
+        _center = 0.5*(emax+emin);
+        _radius = emax > emin ? 0.5*(emax-emin) : 1.0;
+        _tol = 1e-12;
+    };
+    ~ChebyshevExpv() {};
+
+    void setTolerance(double tol) {_tol = tol;};
+    const KrylovStats& getStats() const {return _stats;};
+
+    void run(const cx_vec& v, const vec& time_list, cx_mat& W)
+    {
+        size_t nTime = time_list.n_elem;
+        W.set_size(_dim, nTime);
+        _stats = KrylovStats();
+        if(nTime == 0) return;
+
+        // the first point from t = 0, then one step per interval
+        cx_vec c;
+        if(time_list(0) == 0.0)
+            W.col(0) = v;
+        else
+        {
+            coefficients(time_list(0), c);
+            step(c, v.memptr(), W.colptr(0));
+        }
+
+        double dt = nTime > 1 ? time_list(1)-time_list(0) : 0.0;
+        if(nTime > 1) coefficients(dt, c);
+        for(size_t i=1; i<nTime; ++i)
+        {
+            double dt_i = time_list(i)-time_list(i-1);
+            if( fabs(dt_i-dt) > 1e-12*fabs(dt) )
+            {
+                dt = dt_i;
+                coefficients(dt, c);
+            }
+            step(c, W.colptr(i-1), W.colptr(i));
+        }
+    };
+
+    /// J_0(x) ... J_kmax(x) for x >= 0, by Miller's backward recurrence,
+    /// normalized with J_0 + 2 sum_k J_2k = 1.
+    static void bessel_j(double x, int kmax, vec& J)
+    {
+        J.zeros(kmax+1);
+        if(x == 0.0)
+        {
+            J(0) = 1.0;
+            return;
+        }
+        int m = kmax > (int)x ? kmax : (int)x;
+        int n = 2*( (m + 15 + (int)sqrt(40.0*m)) / 2 );
+        double j_next = 0.0, j = 1e-30, sum = 0.0;
+        for(int k=n; k>0; --k)
+        {
+            double j_prev = 2.0*k/x*j - j_next;
+            j_next = j; j = j_prev;
+            if(k-1 <= kmax) J(k-1) = j;
+            if((k-1) % 2 == 0) sum += (k-1 == 0 ? 1.0 : 2.0)*j;
+            if(fabs(j) > 1e250)
+            {
+                j *= 1e-250; j_next *= 1e-250; sum *= 1e-250;
+                J *= 1e-250;
+            }
+        }
+        J /= sum;
+    };
+protected:
+private:
+    const MatVec& _A;
+    size_t        _dim;
+    double        _center;
+    double        _radius;
+    double        _tol;
+    KrylovStats   _stats;
+    double        _step;     ///< the step of the current coefficients
+    double        _step_err; ///< and their truncation error, 2 sum_{k>=K} |J_k|
+
+    cx_vec _p0, _p1, _p2;
+
+    void coefficients(double t, cx_vec& c)
+    {
+    /// c_k = exp(-i b t) (2-delta_k0) (-i)^k J_k(a t), using J_k(-x) = (-1)^k J_k(x).
+        double x = _radius*fabs(t);
+        vec J;
+        bessel_j(x, (int)(1.2*x) + 40, J);
+        size_t K = J.n_elem;
+        while(K > 1 && fabs(J(K-1)) < 0.5*_tol) --K;
+
+        c.set_size(K);
+        cx_double phase = exp( cx_double(0.0, -_center*t) );
+        cx_double mi_k = 1.0;
+        for(size_t k=0; k<K; ++k)
+        {
+            double sign = (t < 0.0 && k % 2 == 1) ? -1.0 : 1.0;
+            c(k) = (k == 0 ? 1.0 : 2.0) * sign*J(k) * mi_k * phase;
+            mi_k *= cx_double(0.0, -1.0);
+        }
+        double tail = 0.0;
+        for(size_t k=K; k<J.n_elem; ++k) tail += 2.0*fabs(J(k));
+        _step_err = tail;
+        _step = t;
+    };
+
+    void step(const cx_vec& c, const cx_double* v, cx_double* w)
+    {
+    /// w = sum_k c_k T_k(Hs) v; v and w must not overlap.
+        size_t K = c.n_elem;
+        if(_p0.n_elem != _dim)
+        {
+            _p0.set_size(_dim); _p1.set_size(_dim); _p2.set_size(_dim);
+        }
+        cx_double* p0 = _p0.memptr();
+        cx_double* p1 = _p1.memptr();
+        cx_double* p2 = _p2.memptr();
+        const double s = 1.0/_radius;
+
+        for(size_t r=0; r<_dim; ++r)
+        {
+            p0[r] = v[r];
+            w[r] = c(0)*v[r];
+        }
+        if(K > 1)
+        {
+            _A(p0, p1);
+            for(size_t r=0; r<_dim; ++r)
+            {
+                p1[r] = s*(p1[r] - _center*p0[r]);
+                w[r] += c(1)*p1[r];
+            }
+        }
+        for(size_t k=2; k<K; ++k)
+        {
+            _A(p1, p2);
+            for(size_t r=0; r<_dim; ++r)
+            {
+                p2[r] = 2.0*s*(p2[r] - _center*p1[r]) - p0[r];
+                w[r] += c(k)*p2[r];
+            }
+            cx_double* tmp = p0; p0 = p1; p1 = p2; p2 = tmp;
+        }
+
+        _stats.nMatVec += K > 0 ? K-1 : 0;
+        _stats.nStep += 1;
+        _stats.err_total += _step_err;
+        double h = fabs(_step);
+        _stats.step_min = _stats.nStep == 1 ? h : min(_stats.step_min, h);
+        _stats.step_max = max(_stats.step_max, h);
+    };
+};
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+/// @}
+#endif
@@ -0,0 +1,135 @@
+#ifndef FIXEDDIMKERNEL_H
+#define FIXEDDIMKERNEL_H
+
+#include <cmath>
+#include <complex>
+
+using namespace std;
+
+/// \defgroup FixedDimKernel FixedDimKernel
+/// @{
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ Fixed-dimension kernels
+/// Dense kernels for the small cluster dimensions (2, 3, 4, 6, 8, 9 in practice).
+/// The dimension D is a template parameter, all the loops have constant trip counts and
+/// all the temporaries live on the stack, so neither LAPACK dispatch nor allocation is involved.
+/// Matrices are column-major D x D arrays, as cx_mat::memptr().
+
+/// C = A B; C must not overlap A or B.
+template<int D>
+inline void fixed_matmul(const complex<double>* A, const complex<double>* B, complex<double>* C)
+{
+    for(int c=0; c<D; ++c)
+    {
+        for(int r=0; r<D; ++r) C[r+c*D] = 0.0;
+        for(int k=0; k<D; ++k)
+        {
+            const complex<double> b = B[k+c*D];
+            for(int r=0; r<D; ++r)
+                C[r+c*D] += A[r+k*D]*b;
+        }
+    }
+}
+
+/// y = A x; y must not overlap x.
+template<int D>
+inline void fixed_matvec(const complex<double>* A, const complex<double>* x, complex<double>* y)
+{
+    for(int r=0; r<D; ++r) y[r] = 0.0;
+    for(int k=0; k<D; ++k)
+        for(int r=0; r<D; ++r)
+            y[r] += A[r+k*D]*x[k];
+}
+
+/// <x|y>
+template<int D>
+inline complex<double> fixed_cdot(const complex<double>* x, const complex<double>* y)
+{
+    complex<double> s = 0.0;
+    for(int k=0; k<D; ++k)
+        s += conj(x[k])*y[k];
+    return s;
+}
+
+/// <x|y> for any dimension, unrolled for the fixed ones.
+inline complex<double> fixed_overlap(size_t dim, const complex<double>* x, const complex<double>* y)
+{
+    switch(dim)
+    {
+        case 2: return fixed_cdot<2>(x, y);
+        case 3: return fixed_cdot<3>(x, y);
+        case 4: return fixed_cdot<4>(x, y);
+        case 6: return fixed_cdot<6>(x, y);
+        case 8: return fixed_cdot<8>(x, y);
+        case 9: return fixed_cdot<9>(x, y);
+        default:
+        {
+            complex<double> s = 0.0;
+            for(size_t k=0; k<dim; ++k)
+                s += conj(x[k])*y[k];
+            return s;
+        }
+    }
+}
+
+/// U = exp(A), Taylor series up to the 14th order after scaling the 1-norm of A below 1/2,
+/// followed by squaring.
+template<int D>
+inline void fixed_expm(const complex<double>* A, complex<double>* U)
+{
+    double nrm = 0.0;
+    for(int c=0; c<D; ++c)
+    {
+        double col = 0.0;
+        for(int r=0; r<D; ++r) col += abs(A[r+c*D]);
+        nrm = nrm > col ? nrm : col;
+    }
+    int s = nrm > 0.5 ? (int) ceil( log(nrm/0.5)/log(2.0) ) : 0;
+    double scale = pow(0.5, s);
+
+    complex<double> As[D*D], T[D*D], S[D*D];
+    for(int q=0; q<D*D; ++q)
+    {
+        As[q] = scale*A[q];
+        T[q] = U[q] = 0.0;
+    }
+    for(int r=0; r<D; ++r) T[r+r*D] = U[r+r*D] = 1.0;
+
+    for(int k=1; k<=14; ++k)
+    {
+        fixed_matmul<D>(T, As, S);
+        const double f = 1.0/k;
+        for(int q=0; q<D*D; ++q)
+        {
+            T[q] = f*S[q];
+            U[q] += T[q];
+        }
+    }
+    for(int k=0; k<s; ++k)
+    {
+        fixed_matmul<D>(U, U, S);
+        for(int q=0; q<D*D; ++q) U[q] = S[q];
+    }
+}
+
+/// y = V diag(exp(-i E tau)) V^+ x, the propagation in the eigenbasis of a Hermitian operator.
+template<int D>
+inline void fixed_eig_propagate(const complex<double>* V, const double* E, double tau,
+                                const complex<double>* x, complex<double>* y)
+{
+    complex<double> c[D];
+    for(int k=0; k<D; ++k)
+    {
+        complex<double> s = 0.0;
+        for(int r=0; r<D; ++r)
+            s += conj(V[r+k*D])*x[r];
+        c[k] = s * complex<double>( cos(E[k]*tau), -sin(E[k]*tau) );
+    }
+    fixed_matvec<D>(V, c, y);
+}
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+/// @}
+#endif
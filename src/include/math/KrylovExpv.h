@@ -0,0 +1,843 @@
+#ifndef KRYLOVEXPV_H
+#define KRYLOVEXPV_H
+
+#include <cmath>
+#include <vector>
+#include <iostream>
+#include <armadillo>
+
+using namespace std;
+using namespace arma;
+
+/// \defgroup KrylovExpv KrylovExpv
+/// @{
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ KrylovWorkspace, KrylovStats
+/// The Krylov basis and buffers of KrylovExpv. They only grow, and KrylovExpv works on
+/// views of the sizes it needs, so a workspace kept across calls (see KrylovExpv::setWorkspace)
+/// is allocated once for the largest (dim, m) it has seen.
+struct KrylovWorkspace
+{
+    cx_vec V;   ///< Krylov basis, viewed as dim x (m+1)
+    cx_vec H;   ///< projected matrix (Arnoldi), viewed as (m+2) x (m+2)
+    vec    T;   ///< projected matrix (Lanczos), viewed as m x m
+    cx_vec p;   ///< matvec result, viewed as dim
+
+    void reserve(size_t dim, size_t m)
+    {
+        if(V.n_elem < dim*(m+1)) V.set_size(dim*(m+1));
+        if(H.n_elem < (m+2)*(m+2)) H.set_size((m+2)*(m+2));
+        if(T.n_elem < m*m) T.set_size(m*m);
+        if(p.n_elem < dim) p.set_size(dim);
+    };
+};
+
+/// The block basis and buffers of BlockKrylovExpv, in the precision eT; grow-only as KrylovWorkspace.
+template<class eT>
+struct BlockKrylovWorkspace
+{
+    Col< complex<eT> > basis; ///< viewed as nb x dim*(m+1)
+    Col< complex<eT> > p;     ///< viewed as nb x dim
+    Col< complex<eT> > w;     ///< viewed as nb x dim
+
+    void reserve(size_t dim, size_t m, size_t nb)
+    {
+        if(basis.n_elem < nb*dim*(m+1)) basis.set_size(nb*dim*(m+1));
+        if(p.n_elem < nb*dim) p.set_size(nb*dim);
+        if(w.n_elem < nb*dim) w.set_size(nb*dim);
+    };
+};
+
+/// Statistics of a KrylovExpv run, with the same meaning as the iwsp/wsp outputs of Expokit.
+struct KrylovStats
+{
+    size_t nMatVec;     ///< number of matrix-vector products
+    size_t nStep;       ///< number of accepted steps
+    size_t nReject;     ///< number of rejected step sizes
+    size_t nExpm;       ///< number of small exponentials
+    double step_min;    ///< smallest accepted step
+    double step_max;    ///< largest accepted step
+    double err_total;   ///< sum of the local error estimates, an upper bound of the global error
+    double hump;        ///< max |w(t)|/|v|, a measure of the conditioning
+
+    KrylovStats() : nMatVec(0), nStep(0), nReject(0), nExpm(0), step_min(0.0), step_max(0.0), err_total(0.0), hump(0.0) {};
+};
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ KrylovExpv
+/// This class computes w(t) = exp(prefactor * t * A) v for a list of times,
+/// where A is only known through a matrix-vector product.
+/// MatVec is any class with a method "void operator()(const cx_double* x, cx_double* y) const"
+/// which computes y = A * x, e.g. KronApply, DenseMatVec or CSRMatVec; the same driver
+/// serves every operator format.
+///
+/// The algorithm is the one of ZGEXPV in Expokit: an Arnoldi basis of dimension m is
+/// built at each step, the small exponential is computed by expmat, and the step size
+/// is controlled by the local error estimate. The times are visited in increasing order
+/// and the result at each time is continued from the previous one.
+///
+/// With setHermitian(true), A must be Hermitian (prefactor is arbitrary, usually -i) and
+/// the basis is built by the Lanczos three-term recurrence as in ZHEXPV, i.e. O(mn) instead
+/// of O(m^2 n) for the orthogonalization. The projected matrix is real symmetric tridiagonal;
+/// it is diagonalized once per step and reused by all the rejected step sizes.
+///
+/// The basis lives in a KrylovWorkspace, owned by the object unless setWorkspace() is called,
+/// and getStats() reports the cost and accuracy of the last run.
+template<class MatVec>
+class KrylovExpv
+{
+public:
+    KrylovExpv(const MatVec& A, size_t dim, cx_double prefactor)
+        : _op(A), _dim(dim), _prefactor(prefactor), _m(30), _tol(1e-12), _itrace(0), _is_hermitian(false), _wsp(NULL) {};
+    ~KrylovExpv() {};
+
+    void   setKrylovDim(size_t m) {_m = m;};
+    void   setTolerance(double tol) {_tol = tol;};
+    void   setTrace(int itrace) {_itrace = itrace;};
+    void   setHermitian(bool is_hermitian) {_is_hermitian = is_hermitian;};
+    void   setWorkspace(KrylovWorkspace& wsp) {_wsp = &wsp;};
+    size_t getMatVecNum() const {return _stats.nMatVec;};
+    size_t getStepNum() const {return _stats.nStep;};
+    const KrylovStats& getStats() const {return _stats;};
+
+    cx_mat run(const cx_vec& v, const vec& time_list);
+    void   run(const cx_vec& v, const vec& time_list, cx_mat& res);
+protected:
+private:
+    const MatVec& _op;
+    size_t    _dim;
+    cx_double _prefactor;
+    size_t    _m;
+    double    _tol;
+    int       _itrace;
+    bool      _is_hermitian;
+
+    KrylovWorkspace  _own_workspace;
+    KrylovWorkspace* _wsp;
+    KrylovStats      _stats;
+
+    KrylovWorkspace& workspace() {return _wsp ? *_wsp : _own_workspace;};
+    void   matvec(const cx_double* x, cx_double* y) { _op(x, y); _stats.nMatVec++; };
+    void   accept_step(double t_step, double err_loc);
+    double estimate_norm();
+    void   advance(cx_vec& w, double t_span, double& t_new, double anorm);
+    void   advance_lanczos(cx_vec& w, double t_span, double& t_new, double anorm);
+    static void phi_functions(cx_double z, cx_double& phi1, cx_double& phi2);
+    static double round_step(double t);
+    static void   local_error(double p1, double p2, size_t m, double& err_loc, double& xm);
+    static double next_step(double t_step, double err_loc, double xm, double tol);
+    static void   update_step(double t_step, double err_loc, double xm, double tol, bool is_clipped, double& t_new);
+
+    template<class BlockMatVec, class eT> friend class BlockKrylovExpv;
+};
+
+template<class MatVec>
+cx_mat KrylovExpv<MatVec>::run(const cx_vec& v, const vec& time_list)
+{
+    cx_mat res;
+    run(v, time_list, res);
+    return res;
+}
+
+template<class MatVec>
+void KrylovExpv<MatVec>::run(const cx_vec& v, const vec& time_list, cx_mat& res)
+{
+/// The result is written into res, whose memory is reused when it already has the right size.
+    res.set_size(_dim, time_list.n_elem);
+    _stats = KrylovStats();
+    if(_dim == 0) return;
+    if(_m > _dim) _m = _dim;
+    workspace().reserve(_dim, _m);
+
+    double anorm = estimate_norm();
+    double beta = norm(v);
+    double t_new = 0.0;
+    if(anorm > 0.0 && beta > 0.0)
+    {
+        double mp1 = _m + 1.0;
+        double fact = pow(mp1/exp(1.0), mp1) * sqrt(2.0*datum::pi*mp1);
+        t_new = (1.0/anorm) * pow( (fact*_tol)/(4.0*beta*anorm), 1.0/_m );
+        t_new = round_step(t_new);
+    }
+
+    cx_vec w = v;
+    double t_now = 0.0;
+    for(int k=0; k<time_list.n_elem; ++k)
+    {
+        double t_span = time_list(k) - t_now;
+        if(t_span > 0.0 && anorm > 0.0 && beta > 0.0)
+        {
+            if(_is_hermitian)
+                advance_lanczos(w, t_span, t_new, anorm);
+            else
+                advance(w, t_span, t_new, anorm);
+        }
+        t_now = time_list(k);
+        res.col(k) = w;
+        if(beta > 0.0)
+            _stats.hump = max(_stats.hump, norm(w)/beta);
+    }
+}
+
+template<class MatVec>
+void KrylovExpv<MatVec>::accept_step(double t_step, double err_loc)
+{
+    _stats.nStep++;
+    _stats.step_min = (_stats.nStep == 1) ? t_step : min(_stats.step_min, t_step);
+    _stats.step_max = max(_stats.step_max, t_step);
+    _stats.err_total += err_loc;
+}
+
+template<class MatVec>
+double KrylovExpv<MatVec>::estimate_norm()
+{
+/// A few power iterations give the size of |prefactor*A|,
+/// which is only used for the first step size.
+/// The start vector is fixed (not random) so that the global random state is not touched.
+/// The first two columns of the Krylov basis are used as buffers.
+    cx_double* x = workspace().V.memptr();
+    cx_double* y = workspace().V.memptr() + _dim;
+    double nrm = 0.0;
+    for(size_t j=0; j<_dim; ++j)
+    {
+        x[j] = cx_double( sin(j+1.0), cos(3.0*j+1.0) );
+        nrm += norm(x[j]);
+    }
+    nrm = sqrt(nrm);
+    for(int it=0; it<10; ++it)
+    {
+        for(size_t j=0; j<_dim; ++j) x[j] /= nrm;
+        matvec(x, y);
+        nrm = 0.0;
+        for(size_t j=0; j<_dim; ++j) nrm += norm(y[j]);
+        nrm = sqrt(nrm);
+        if(nrm == 0.0) break;
+        swap(x, y);
+    }
+    return abs(_prefactor)*nrm;
+}
+
+template<class MatVec>
+void KrylovExpv<MatVec>::advance(cx_vec& w, double t_span, double& t_new, double anorm)
+{
+    const double delta = 1.2, btol = 1e-7;
+    const int    mxrej = 10;
+    const size_t m = _m;
+
+    KrylovWorkspace& wsp = workspace();
+    cx_mat V(wsp.V.memptr(), _dim, m+1, false, true);
+    cx_mat H(wsp.H.memptr(), m+2, m+2, false, true);
+    cx_vec p(wsp.p.memptr(), _dim, false, true);
+
+    double t_now = 0.0;
+    double beta = norm(w);
+    while(t_now < t_span)
+    {
+        double t_step = t_new > 0.0 ? min(t_span - t_now, t_new) : t_span - t_now;
+        bool   is_clipped = (t_step < t_new);
+
+        // Arnoldi process with modified Gram-Schmidt
+        V.col(0) = w/beta;
+        H.zeros();
+        size_t mb = m;
+        int    k1 = 2;
+        for(size_t j=0; j<m; ++j)
+        {
+            matvec(V.colptr(j), p.memptr());
+            p *= _prefactor;
+            for(size_t i=0; i<=j; ++i)
+            {
+                cx_double hij = cdot(V.col(i), p);
+                H(i, j) = hij;
+                p -= hij*V.col(i);
+            }
+            double s = norm(p);
+            if(s < btol)
+            {   // happy breakdown: the Krylov subspace is invariant
+                k1 = 0;  mb = j+1;
+                t_step = t_span - t_now;
+                break;
+            }
+            H(j+1, j) = s;
+            V.col(j+1) = p/s;
+        }
+        double avnorm = 0.0;
+        if(k1 != 0)
+        {
+            H(m+1, m) = 1.0;
+            matvec(V.colptr(m), p.memptr());
+            avnorm = abs(_prefactor)*norm(p);
+        }
+
+        // exponential of the small matrix, rejecting the steps with a large error
+        cx_mat F;
+        double err_loc = btol, xm = 1.0/m;
+        for(int ireject=0; ; ++ireject)
+        {
+            size_t mx = mb + k1;
+            F = expmat( t_step * H.submat(0, 0, mx-1, mx-1) );
+            _stats.nExpm++;
+            if(k1 == 0)
+                break;
+
+            double p1 = abs( F(m, 0) ) * beta;
+            double p2 = abs( F(m+1, 0) ) * beta * avnorm;
+            local_error(p1, p2, m, err_loc, xm);
+
+            if(err_loc <= delta*t_step*_tol || ireject >= mxrej)
+            {
+                if(ireject >= mxrej && _itrace)
+                    cout << "KrylovExpv: the requested tolerance is too high." << endl;
+                break;
+            }
+            t_step = next_step(t_step, err_loc, xm, _tol);
+            is_clipped = false;
+            _stats.nReject++;
+        }
+
+        size_t mx = mb + (k1 > 1 ? k1-1 : 0);
+        cx_vec coef = beta * F.submat(0, 0, mx-1, 0);
+        w = V.cols(0, mx-1) * coef;
+        beta = norm(w);
+
+        t_now += t_step;
+        accept_step(t_step, err_loc);
+        if(k1 != 0)
+            update_step(t_step, err_loc, xm, _tol, is_clipped, t_new);
+        if(_itrace)
+            cout << "KrylovExpv: step " << _stats.nStep << ", t = " << t_now << ", err_loc = " << err_loc << endl;
+    }
+}
+
+template<class MatVec>
+void KrylovExpv<MatVec>::advance_lanczos(cx_vec& w, double t_span, double& t_new, double anorm)
+{
+/// Same step control as advance(); the error estimate needs the entries (m, 0) and (m+1, 0)
+/// of the exponential of the augmented matrix, which are s_m e_m^T phi_k(tT) e_1 t^k (k=1,2),
+/// and are evaluated in the eigenbasis of T.
+    const double delta = 1.2, btol = 1e-7;
+    const int    mxrej = 10;
+    const size_t m = _m;
+
+    KrylovWorkspace& wsp = workspace();
+    cx_mat V(wsp.V.memptr(), _dim, m+1, false, true);
+    mat    T(wsp.T.memptr(), m, m, false, true);
+    cx_vec p(wsp.p.memptr(), _dim, false, true);
+
+    double t_now = 0.0;
+    double beta = norm(w);
+    while(t_now < t_span)
+    {
+        double t_step = t_new > 0.0 ? min(t_span - t_now, t_new) : t_span - t_now;
+        bool   is_clipped = (t_step < t_new);
+
+        // Lanczos process: A V_m = V_m T_m + s_m v_{m+1} e_m^T
+        V.col(0) = w/beta;
+        T.zeros();
+        double s = 0.0, s_m = 0.0;
+        size_t mb = m;
+        int    k1 = 2;
+        for(size_t j=0; j<m; ++j)
+        {
+            matvec(V.colptr(j), p.memptr());
+            if(j > 0)
+                p -= s*V.col(j-1);
+            double a = real( cdot(V.col(j), p) );
+            p -= a*V.col(j);
+            T(j, j) = a;
+            s = norm(p);
+            if(s < btol)
+            {   // happy breakdown: the Krylov subspace is invariant
+                k1 = 0;  mb = j+1;
+                t_step = t_span - t_now;
+                break;
+            }
+            V.col(j+1) = p/s;
+            if(j+1 < m)
+                T(j+1, j) = T(j, j+1) = s;
+            else
+                s_m = s;
+        }
+        double avnorm = 0.0;
+        if(k1 != 0)
+        {
+            matvec(V.colptr(m), p.memptr());
+            avnorm = abs(_prefactor)*norm(p);
+        }
+
+        vec    lambda;
+        mat    Q;
+        eig_sym( lambda, Q, T.submat(0, 0, mb-1, mb-1) );
+
+        // exponential of the small matrix, rejecting the steps with a large error
+        cx_vec    F0(mb);
+        cx_double Fm(0.0, 0.0);
+        double err_loc = btol, xm = 1.0/m;
+        for(int ireject=0; ; ++ireject)
+        {
+            cx_double e1(0.0, 0.0), e2(0.0, 0.0);
+            cx_vec    y(mb);
+            _stats.nExpm++;
+            for(size_t k=0; k<mb; ++k)
+            {
+                cx_double z = t_step*_prefactor*lambda(k), phi1, phi2;
+                y(k) = exp(z) * Q(0, k);
+                if(k1 != 0)
+                {
+                    phi_functions(z, phi1, phi2);
+                    e1 += Q(mb-1, k) * phi1 * Q(0, k);
+                    e2 += Q(mb-1, k) * phi2 * Q(0, k);
+                }
+            }
+            F0 = cx_mat(Q) * y;
+            if(k1 == 0)
+                break;
+
+            Fm = t_step * s_m * _prefactor * e1;
+            double p1 = abs( Fm ) * beta;
+            double p2 = abs( t_step*t_step * s_m * _prefactor * e2 ) * beta * avnorm;
+            local_error(p1, p2, m, err_loc, xm);
+
+            if(err_loc <= delta*t_step*_tol || ireject >= mxrej)
+            {
+                if(ireject >= mxrej && _itrace)
+                    cout << "KrylovExpv: the requested tolerance is too high." << endl;
+                break;
+            }
+            t_step = next_step(t_step, err_loc, xm, _tol);
+            is_clipped = false;
+            _stats.nReject++;
+        }
+
+        w = V.cols(0, mb-1) * (beta*F0);
+        if(k1 != 0)
+            w += (beta*Fm) * V.col(m);
+        beta = norm(w);
+
+        t_now += t_step;
+        accept_step(t_step, err_loc);
+        if(k1 != 0)
+            update_step(t_step, err_loc, xm, _tol, is_clipped, t_new);
+        if(_itrace)
+            cout << "KrylovExpv: step " << _stats.nStep << ", t = " << t_now << ", err_loc = " << err_loc << endl;
+    }
+}
+
+template<class MatVec>
+void KrylovExpv<MatVec>::phi_functions(cx_double z, cx_double& phi1, cx_double& phi2)
+{
+/// phi1(z) = (e^z-1)/z and phi2(z) = (e^z-1-z)/z^2, by their Taylor series near 0.
+    if(abs(z) < 1e-3)
+    {
+        phi1 = 1.0 + z*(1.0/2.0 + z*(1.0/6.0 + z*(1.0/24.0 + z/120.0)));
+        phi2 = 1.0/2.0 + z*(1.0/6.0 + z*(1.0/24.0 + z*(1.0/120.0 + z/720.0)));
+    }
+    else
+    {
+        cx_double ez = exp(z);
+        phi1 = (ez - 1.0)/z;
+        phi2 = (ez - 1.0 - z)/(z*z);
+    }
+}
+
+template<class MatVec>
+double KrylovExpv<MatVec>::round_step(double t)
+{
+/// Keep 2 significant digits of the step size, as Expokit does.
+    if(t <= 0.0) return 0.0;  // log10 would give NaN
+    double s = pow(10.0, floor(log10(t))-1.0);
+    return ceil(t/s)*s;
+}
+
+template<class MatVec>
+void KrylovExpv<MatVec>::local_error(double p1, double p2, size_t m, double& err_loc, double& xm)
+{
+/// The local error of a step from p1 and p2, the norms of the two correction terms, and the
+/// exponent xm of the step size it scales with, as in Expokit.
+    if(p1 > 10.0*p2)
+    {   err_loc = p2; xm = 1.0/m; }
+    else if(p1 > p2)
+    {   err_loc = (p1*p2)/(p1-p2); xm = 1.0/m; }
+    else
+    {   err_loc = p1; xm = 1.0/(m-1); }
+}
+
+template<class MatVec>
+double KrylovExpv<MatVec>::next_step(double t_step, double err_loc, double xm, double tol)
+{
+/// The step size for which the local error would be tol per unit time, with a safety factor;
+/// used both to retry a rejected step and to propose the next one.
+    const double gamma = 0.9;
+    return round_step( gamma * t_step * pow(t_step*tol/max(err_loc, 1e-300), xm) );
+}
+
+template<class MatVec>
+void KrylovExpv<MatVec>::update_step(double t_step, double err_loc, double xm, double tol, bool is_clipped, double& t_new)
+{
+/// t_new after an accepted step. A step clipped at the end of the span says nothing about the
+/// next step size, so it may only make t_new larger.
+    double t_next = next_step(t_step, err_loc, xm, tol);
+    t_new = (is_clipped && t_next < t_new) ? t_new : t_next;
+}
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ BlockKrylovExpv
+/// W = exp(prefactor * t * A) V for all the columns of V at once, A being Hermitian.
+/// BlockMatVec is any class with a method
+/// "void operator()(const cx_double* X, cx_double* Y, size_t nb) const"
+/// which computes the nb products Y = A * X of an interleaved block (X[r*nb+b] is the row r
+/// of the column b), e.g. KronApply; the operator data is then streamed once per block
+/// instead of once per vector, and the innermost loops run over the nb columns.
+///
+/// Every column has its own Lanczos recurrence and error estimate, as in
+/// KrylovExpv::advance_lanczos; the step size is shared and limited by the worst column.
+/// A column whose Krylov subspace breaks down is exact from then on and stops limiting the step.
+///
+/// eT is the precision of the basis and of the block products: with eT = float the block is
+/// stored as cx_float and BlockMatVec must also take cx_float blocks (as KronApply does), which
+/// halves the memory traffic of the matvecs and of the recurrence. The inner products, the
+/// projected problems and the step control stay in double; the tolerance should then not be
+/// set below about 1e-6.
+///
+/// The basis lives in a BlockKrylovWorkspace, owned by the object unless setWorkspace() is called;
+/// an engine which runs many blocks in a row (e.g. the segments of PiecewiseTypicalityEvolution)
+/// keeps one workspace for all of them.
+template<class BlockMatVec, class eT = double>
+class BlockKrylovExpv
+{
+public:
+    BlockKrylovExpv(const BlockMatVec& A, size_t dim, cx_double prefactor)
+        : _op(A), _dim(dim), _prefactor(prefactor), _m(30), _tol(1e-12), _wsp(NULL) {};
+    ~BlockKrylovExpv() {};
+
+    void   setKrylovDim(size_t m) {_m = m;};
+    void   setTolerance(double tol) {_tol = tol;};
+    void   setWorkspace(BlockKrylovWorkspace<eT>& wsp) {_wsp = &wsp;};
+    const KrylovStats& getStats() const {return _stats;};
+
+    void   run(const cx_mat& V, double t, cx_mat& W);
+protected:
+private:
+    typedef KrylovExpv<BlockMatVec> Single;
+    typedef complex<eT>             elem_type;
+
+    const BlockMatVec& _op;
+    size_t    _dim;
+    cx_double _prefactor;
+    size_t    _m;
+    double    _tol;
+    KrylovStats _stats;
+
+    BlockKrylovWorkspace<eT>  _own_workspace;
+    BlockKrylovWorkspace<eT>* _wsp;
+
+    BlockKrylovWorkspace<eT>& workspace() {return _wsp ? *_wsp : _own_workspace;};
+    void matvec(const elem_type* X, elem_type* Y, size_t nb) { _op(X, Y, nb); _stats.nMatVec += nb; };
+};
+
+template<class BlockMatVec, class eT>
+void BlockKrylovExpv<BlockMatVec, eT>::run(const cx_mat& V, double t, cx_mat& W)
+{
+/// The result is written into W (dim x nb), whose memory is reused when it already has the right size.
+    const double delta = 1.2, btol = 1e-7;
+    const int    mxrej = 10;
+    const size_t nb = V.n_cols;
+
+    W.set_size(_dim, nb);
+    _stats = KrylovStats();
+    if(_dim == 0 || nb == 0) return;
+    const size_t m = _m < _dim ? _m : _dim;
+    BlockKrylovWorkspace<eT>& wsp = workspace();
+    wsp.reserve(_dim, m, nb);
+    // the block j of the basis is the columns [j*dim, (j+1)*dim); prod is the block matvec result
+    Mat<elem_type> basis(wsp.basis.memptr(), nb, _dim*(m+1), false, true);
+    Mat<elem_type> prod(wsp.p.memptr(), nb, _dim, false, true);
+    Mat<elem_type> block(wsp.w.memptr(), nb, _dim, false, true);
+    block = conv_to< Mat<elem_type> >::from( V.st() );
+
+    vec beta(nb), s(nb), s_m(nb), avnorm(nb), a(nb), nrm2(nb);
+    vector<mat>    T(nb), Q(nb);
+    vector<vec>    lambda(nb);
+    vector<size_t> mb(nb);
+    vector<int>    k1(nb);
+    cx_mat F0(m, nb);
+    cx_vec Fm(nb);
+
+    double t_now = 0.0, t_new = 0.0;
+    while(t_now < t)
+    {
+        // Lanczos processes: A V_m = V_m T_m + s_m v_{m+1} e_m^T, for each column
+        nrm2.zeros();
+        const elem_type* w = block.memptr();
+        for(size_t r=0; r<_dim; ++r)
+            for(size_t b=0; b<nb; ++b)
+                nrm2(b) += norm( w[r*nb+b] );
+        beta = sqrt(nrm2);
+        if(beta.max() == 0.0) break;
+
+        elem_type* V0 = basis.memptr();
+        for(size_t r=0; r<_dim; ++r)
+            for(size_t b=0; b<nb; ++b)
+                V0[r*nb+b] = beta(b) > 0.0 ? w[r*nb+b]/(eT)beta(b) : elem_type(0.0, 0.0);
+        for(size_t b=0; b<nb; ++b)
+        {
+            T[b].zeros(m, m);
+            mb[b] = beta(b) > 0.0 ? m : 1;
+            k1[b] = beta(b) > 0.0 ? 2 : 0;
+        }
+        s.zeros(); s_m.zeros();
+
+        for(size_t j=0; j<m; ++j)
+        {
+            const elem_type* Vj = basis.colptr(j*_dim);
+            elem_type*       P  = prod.memptr();
+            matvec(Vj, P, nb);
+            if(j > 0)
+            {
+                const elem_type* Vp = basis.colptr((j-1)*_dim);
+                for(size_t r=0; r<_dim; ++r)
+                    for(size_t b=0; b<nb; ++b)
+                        P[r*nb+b] -= (eT)s(b)*Vp[r*nb+b];
+            }
+            a.zeros();
+            for(size_t r=0; r<_dim; ++r)
+                for(size_t b=0; b<nb; ++b)
+                    a(b) += real( conj(Vj[r*nb+b]) * P[r*nb+b] );
+            nrm2.zeros();
+            for(size_t r=0; r<_dim; ++r)
+                for(size_t b=0; b<nb; ++b)
+                {
+                    P[r*nb+b] -= (eT)a(b)*Vj[r*nb+b];
+                    nrm2(b) += norm( P[r*nb+b] );
+                }
+
+            vec inv_s = zeros<vec>(nb);
+            for(size_t b=0; b<nb; ++b)
+            {
+                if(k1[b] == 0) continue;
+                T[b](j, j) = a(b);
+                s(b) = sqrt( nrm2(b) );
+                if(s(b) < btol)
+                {   // happy breakdown: the Krylov subspace of this column is invariant
+                    k1[b] = 0;  mb[b] = j+1;
+                    continue;
+                }
+                inv_s(b) = 1.0/s(b);
+                if(j+1 < m)
+                    T[b](j+1, j) = T[b](j, j+1) = s(b);
+                else
+                    s_m(b) = s(b);
+            }
+            elem_type* Vn = basis.colptr((j+1)*_dim);
+            for(size_t r=0; r<_dim; ++r)
+                for(size_t b=0; b<nb; ++b)
+                    Vn[r*nb+b] = (eT)inv_s(b)*P[r*nb+b];
+        }
+
+        bool is_active = false;
+        for(size_t b=0; b<nb; ++b)
+            is_active = is_active || k1[b] != 0;
+        avnorm.zeros();
+        if(is_active)
+        {
+            matvec(basis.colptr(m*_dim), prod.memptr(), nb);
+            const elem_type* P = prod.memptr();
+            for(size_t r=0; r<_dim; ++r)
+                for(size_t b=0; b<nb; ++b)
+                    avnorm(b) += norm( P[r*nb+b] );
+            avnorm = abs(_prefactor)*sqrt(avnorm);
+        }
+
+        double anorm = 0.0;
+        for(size_t b=0; b<nb; ++b)
+        {
+            eig_sym( lambda[b], Q[b], T[b].submat(0, 0, mb[b]-1, mb[b]-1) );
+            anorm = max( anorm, abs(_prefactor)*max(abs(lambda[b])) );
+        }
+        if(t_new == 0.0)
+        {   // the first step size, from the spectrum of the projected matrices as in KrylovExpv::run
+            double mp1 = m + 1.0;
+            double fact = pow(mp1/exp(1.0), mp1) * sqrt(2.0*datum::pi*mp1);
+            t_new = anorm > 0.0 ? Single::round_step( (1.0/anorm) * pow( (fact*_tol)/(4.0*beta.max()*anorm), 1.0/m ) ) : t;
+        }
+        double t_step = is_active && t_new > 0.0 ? min(t - t_now, t_new) : t - t_now;
+        bool   is_clipped = (t_step < t_new);
+
+        // exponentials of the small matrices, rejecting the steps with a large error in any column
+        double err_loc = 0.0, xm = 1.0/m;
+        for(int ireject=0; ; ++ireject)
+        {
+            err_loc = is_active ? 0.0 : btol; xm = 1.0/m;
+            for(size_t b=0; b<nb; ++b)
+            {
+                cx_double e1(0.0, 0.0), e2(0.0, 0.0);
+                cx_vec    y(mb[b]);
+                for(size_t k=0; k<mb[b]; ++k)
+                {
+                    cx_double z = t_step*_prefactor*lambda[b](k), phi1, phi2;
+                    y(k) = exp(z) * Q[b](0, k);
+                    if(k1[b] != 0)
+                    {
+                        Single::phi_functions(z, phi1, phi2);
+                        e1 += Q[b](mb[b]-1, k) * phi1 * Q[b](0, k);
+                        e2 += Q[b](mb[b]-1, k) * phi2 * Q[b](0, k);
+                    }
+                }
+                F0.col(b).zeros();
+                F0.submat(0, b, mb[b]-1, b) = cx_mat(Q[b]) * y;
+                Fm(b) = 0.0;
+                if(k1[b] == 0) continue;
+
+                Fm(b) = t_step * s_m(b) * _prefactor * e1;
+                double p1 = abs( Fm(b) ) * beta(b);
+                double p2 = abs( t_step*t_step * s_m(b) * _prefactor * e2 ) * beta(b) * avnorm(b);
+                double err_b, xm_b;
+                Single::local_error(p1, p2, m, err_b, xm_b);
+                if(err_b > err_loc)
+                {   err_loc = err_b; xm = xm_b; }
+            }
+            _stats.nExpm += nb;
+
+            if(!is_active || err_loc <= delta*t_step*_tol || ireject >= mxrej)
+                break;
+            t_step = Single::next_step(t_step, err_loc, xm, _tol);
+            is_clipped = false;
+            _stats.nReject++;
+        }
+
+        // w = beta (V_m F0 + Fm v_{m+1}), column by column
+        elem_type* wn = block.memptr();
+        for(size_t r=0; r<_dim; ++r)
+            for(size_t b=0; b<nb; ++b)
+                wn[r*nb+b] = 0.0;
+        for(size_t j=0; j<=m; ++j)
+        {
+            const elem_type* Vj = basis.colptr(j*_dim);
+            Col<elem_type> c(nb);
+            for(size_t b=0; b<nb; ++b)
+                c(b) = elem_type( j < mb[b] ? beta(b)*F0(j, b) : ( j == m && k1[b] != 0 ? beta(b)*Fm(b) : cx_double(0.0, 0.0) ) );
+            for(size_t r=0; r<_dim; ++r)
+                for(size_t b=0; b<nb; ++b)
+                    wn[r*nb+b] += c(b)*Vj[r*nb+b];
+        }
+
+        t_now += t_step;
+        _stats.nStep++;
+        _stats.step_min = (_stats.nStep == 1) ? t_step : min(_stats.step_min, t_step);
+        _stats.step_max = max(_stats.step_max, t_step);
+        _stats.err_total += err_loc;
+        if(is_active)
+            Single::update_step(t_step, err_loc, xm, _tol, is_clipped, t_new);
+    }
+    W = conv_to<cx_mat>::from( block.st() );
+}
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ DenseMatVec, SparseMatVec, CSRMatVec
+/// y = scale * A * x for an explicit dense or sparse matrix, to be used as the MatVec of KrylovExpv.
+/// SparseMatVec goes through armadillo's CSC product; CSRMatVec keeps its own row-major copy,
+/// whose rows are independent and are split over the OpenMP threads.
+class DenseMatVec
+{
+public:
+    DenseMatVec(const cx_mat& A, cx_double scale = 1.0) : _A(A), _scale(scale) {};
+    void operator () (const cx_double* x, cx_double* y) const
+    {
+        const cx_vec xv(const_cast<cx_double*>(x), _A.n_cols, false, true);
+        cx_vec yv(y, _A.n_rows, false, true);
+        yv = _scale * (_A * xv);
+    };
+private:
+    const cx_mat& _A;
+    cx_double     _scale;
+};
+
+class SparseMatVec
+{
+public:
+    SparseMatVec(const sp_cx_mat& A, cx_double scale = 1.0) : _A(A), _scale(scale) {};
+    void operator () (const cx_double* x, cx_double* y) const
+    {
+        const cx_vec xv(const_cast<cx_double*>(x), _A.n_cols, false, true);
+        cx_vec yv(y, _A.n_rows, false, true);
+        yv = _scale * (_A * xv);
+    };
+private:
+    const sp_cx_mat& _A;
+    cx_double        _scale;
+};
+
+class CSRMatVec
+{
+public:
+    CSRMatVec(const sp_cx_mat& A, cx_double scale = 1.0) : _nRow(A.n_rows), _scale(scale)
+    {
+        // the columns of A^T, in storage order, are the rows of A
+        sp_cx_mat At = A.st();
+        _row_ptr.assign(_nRow+1, 0);
+        _col_idx.reserve(At.n_nonzero);
+        _val.reserve(At.n_nonzero);
+        for(sp_cx_mat::const_iterator it = At.begin(); it != At.end(); ++it)
+        {
+            _row_ptr[it.col()+1]++;
+            _col_idx.push_back( it.row() );
+            _val.push_back( _scale * (*it) );
+        }
+        for(size_t r=0; r<_nRow; ++r)
+            _row_ptr[r+1] += _row_ptr[r];
+    };
+    void operator () (const cx_double* x, cx_double* y) const
+    {
+        #pragma omp parallel for schedule(static)
+        for(long r=0; r<(long)_nRow; ++r)
+        {
+            cx_double sum(0.0, 0.0);
+            for(size_t k=_row_ptr[r]; k<_row_ptr[r+1]; ++k)
+                sum += _val[k] * x[ _col_idx[k] ];
+            y[r] = sum;
+        }
+    };
+private:
+    size_t            _nRow;
+    cx_double         _scale;
+    vector<size_t>    _row_ptr;
+    vector<size_t>    _col_idx;
+    vector<cx_double> _val;
+};
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ expv
+/// Shorthand for a single KrylovExpv run: the columns of the result are exp(prefactor*t*A) v
+/// for t in time_list.
+template<class MatVec>
+cx_mat expv(const MatVec& A, size_t dim, cx_double prefactor, const cx_vec& v, const vec& time_list,
+            bool is_hermitian = false, size_t m = 30, double tol = 1e-12)
+{
+    KrylovExpv<MatVec> expv_run(A, dim, prefactor);
+    expv_run.setHermitian(is_hermitian);
+    expv_run.setKrylovDim(m);
+    expv_run.setTolerance(tol);
+    return expv_run.run(v, time_list);
+}
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+/// @}
+#endif
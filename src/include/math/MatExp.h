@@ -8,21 +8,38 @@
 #include "include/kron/KronProd.h"
 #include <numeric>      // std::partial_sum
 #include "include/math/krylov_expv.h"
+#include "include/math/KrylovExpv.h"
+#include "include/math/ChebyshevExpv.h"
+#include "include/kron/KronApply.h"
+#include "include/kron/KronOperatorPlan.h"
+#include "include/math/WorkspaceArena.h"
 
 using namespace arma;
 
 ////////////////////////////////////////////////////////////////////////////////
 //{{{  MatExp
+/// run(res) writes the exponential into res, whose memory is reused when it has the right size;
+/// the Pade workspace comes from the WorkspaceArena of the calling thread.
+///
+/// ScalingSquaring is the scaling and squaring algorithm of Al-Mohy and Higham (2009): the Pade
+/// degree m in {3, 5, 7, 9, 13} and the number of squarings s are chosen from the 1-norms of the
+/// powers of the matrix, d_k = ||A^k||_1^{1/k}, and from the backward error bound of |A|^{2m+1}.
+/// A Hermitian matrix takes the fast path V diag(exp(prefactor*E)) V^+ instead.
+/// The powers H^k (and the eigen decomposition) belong to the object, so exponentials of the same
+/// matrix at several durations, run(prefactor, res), compute them only once.
 class MatExp
 {
 public:
-    enum MatExpMethod {ArmadilloExpMat, PadeApproximation};
+    enum MatExpMethod {ArmadilloExpMat, PadeApproximation, ScalingSquaring};
 
     MatExp(){};
     MatExp(const cx_mat& m, cx_double prefactor, MatExpMethod method); 
+    MatExp(const cx_mat& m, MatExpMethod method); 
     ~MatExp(){};
 
     void   run();
+    void   run(cx_mat& res);
+    void   run(cx_double prefactor, cx_mat& res) {_prefactor = prefactor; run(res);};
     cx_mat getResultMatrix() const {return _resMatrix;};
 protected:
 private:
@@ -32,8 +49,17 @@ private:
 
     cx_mat       _resMatrix;
 
-    cx_mat armadillo_exp_mat() {return expmat(_prefactor*_matrix);};
-    cx_mat pade_exp_mat();
+    bool           _is_hermitian;
+    vec            _eigval;
+    cx_mat         _eigvec;
+    double         _norm1;
+    vector<cx_mat> _power_list;     ///< H^2, H^4, H^6, H^8, as far as they are needed
+    vector<double> _abs_power_norm; ///< log2 || (|H|/||H||_1)^q ||_1, by q; NaN if not computed
+
+    void   pade_exp_mat(cx_mat& res);
+    void   scaling_squaring_exp_mat(cx_mat& res);
+    const cx_mat& power(int k);
+    int    ell(double scale, int m);
 };
 //}}}
 ////////////////////////////////////////////////////////////////////////////////
@@ -42,32 +68,51 @@ private:
 
 ////////////////////////////////////////////////////////////////////////////////
 //{{{  MatExpVector
+/// With enable_native(), Explicit and ExplicitSparse run on the C++ KrylovExpv driver
+/// (DenseMatVec/CSRMatVec) instead of the Fortran routines, like InexplicitNative does
+/// with KronApply; getStats() then reports the statistics of the run.
+/// With enable_hermitian(), the operator is assumed Hermitian and these native paths use
+/// Lanczos (as ZHEXPV); the Fortran Inexplicit/InexplicitGPU routines always use Arnoldi.
+/// run(res) writes the result into res instead of the internal result (getResult() is then
+/// not updated), and all the scratch memory comes from the WorkspaceArena of the thread,
+/// so repeated calls of the same size do not allocate.
+/// InexplicitChebyshev expands exp(-i H dt) in Chebyshev polynomials (ChebyshevExpv), H being
+/// Hermitian and bounded by KronOperatorPlan::getSpectralBounds(); on a uniform time list
+/// every time point costs the same number of KronApply products.
 class MatExpVector
 {
 public:
-    enum MatExpVectorMethod {Explicit, ExplicitSparse, Inexplicit, InexplicitGPU};
+    enum MatExpVectorMethod {Explicit, ExplicitSparse, Inexplicit, InexplicitGPU, InexplicitNative, InexplicitChebyshev};
 
-    MatExpVector() {};
+    MatExpVector() {_result = NULL;};
     MatExpVector(const SumKronProd& skp, const cx_vec& v, const vec& time_list, MatExpVectorMethod method);
     MatExpVector(const cx_mat& m, const cx_vec& v, const cx_double prefactor, const vec& time_list);
     MatExpVector(const sp_cx_mat& m, const cx_vec& v, const cx_double prefactor, const vec& time_list);
     ~MatExpVector() {};
 
     cx_mat run();
-    cx_mat runExplicit();
-    cx_mat runExplicitSparse();
-    cx_mat runInexplicit();
-    cx_mat runInexplicitGPU();
+    void   run(cx_mat& res);
+    const cx_mat& runExplicit();
+    const cx_mat& runExplicitSparse();
+    const cx_mat& runInexplicit();
+    const cx_mat& runInexplicitGPU();
+    const cx_mat& runInexplicitNative();
+    const cx_mat& runInexplicitChebyshev();
     cx_mat getResult() const {return _resVectorList;}; 
 
     void enable_step_print() {_itrace = 1;}
     void enable_skp_print() {_is_print_skp = true;}
     void disable_step_print() {_itrace = 0;}
     void disable_skp_print() {_is_print_skp = false;}
+    void enable_hermitian() {_is_hermitian = true;}
+    void disable_hermitian() {_is_hermitian = false;}
+    void enable_native() {_is_native = true;}
+    void disable_native() {_is_native = false;}
+    const KrylovStats& getStats() const {return _stats;}
 protected:
 private:
     MatExpVectorMethod _method;
-    SumKronProd _skp;
+    KronOperatorPlan   _plan;
     cx_mat      _matrix;
     sp_cx_mat   _sp_matrix;
     cx_vec      _vector;
@@ -77,6 +122,7 @@ private:
     size_t         _dim; 
     
     cx_mat  _resVectorList;
+    cx_mat* _result;
 
     size_t _klim;
     size_t _krylov_m;
@@ -84,6 +130,15 @@ private:
     size_t _itrace;
 
     bool _is_print_skp;
+    bool _is_hermitian;
+    bool _is_native;
+    KrylovStats _stats;
+
+    const KronOperatorPlan& getPlan() const {return _plan;};
+    cx_mat& result() {return _result ? *_result : _resVectorList;};
+    template<class MatVec> const cx_mat& run_native(const MatVec& op);
+    void print_parameters(const complex<double>* w_seq, size_t w_seq_len) const;
+    void get_krylov_workspace(complex<double>*& wsp, int& lwsp, int*& iwsp, int& liwsp) const;
 };
 //}}}
 ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,48 @@
+#ifndef WORKSPACEARENA_H
+#define WORKSPACEARENA_H
+
+#include <vector>
+#include <complex>
+#include <armadillo>
+#include "include/math/KrylovExpv.h"
+
+using namespace std;
+using namespace arma;
+
+/// \defgroup WorkspaceArena WorkspaceArena
+/// @{
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ WorkspaceArena
+/// Scratch memory of the exponential routines (Pade, Expokit, KrylovExpv), one arena per thread.
+/// A buffer of a given slot only grows, so after the first cluster of a given size
+/// the calls do not go through the allocator any more.
+/// The content of a buffer is only valid until the next request of the same slot
+/// on the same thread; the caller must not keep the pointer.
+class WorkspaceArena
+{
+public:
+    enum Slot {PadeMatrix, PadeWork, KrylovWork, SparseValue, SparseRow, SparseCol, SlotNum};
+
+    static WorkspaceArena& local();
+
+    cx_double* getComplex(Slot slot, size_t n);
+    int*       getInt(Slot slot, size_t n);
+    KrylovWorkspace& getKrylovWorkspace() {return _krylov_wsp;};
+    size_t     getAllocationNum() const {return _nAlloc;};
+protected:
+private:
+    WorkspaceArena();
+    ~WorkspaceArena();
+    static void release_all();
+
+    vector<cx_double> _cx_buf[SlotNum];
+    vector<int>       _int_buf[SlotNum];
+    KrylovWorkspace   _krylov_wsp;
+    size_t            _nAlloc;
+};
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+/// @}
+#endif
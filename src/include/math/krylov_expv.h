@@ -8,6 +8,12 @@ int krylov_zgexpv(const int n, const double _Complex *a, const double _Complex *
 // interface to zgexpv in Expokit, sparse coo a;
 int krylov_zcooexpv(const int n, const int nz, const int *ia, const int *ja, const double _Complex *a, const double _Complex *v, const int tn, const double *ta, double _Complex *w_seq, const int klim, const int m, const double tol,  const int itrace);
 
+// the same, with the workspace given by the caller:
+// lwsp >= n*(m+2) + 5*(m+2)*(m+2) + 7, liwsp >= m+2;
+int krylov_zgexpv_wsp(const int n, const double _Complex *a, const double _Complex *v, const int tn, const double *ta, double _Complex *w_seq, const int klim, const int m, const double tol,  const int itrace, double _Complex *wsp, const int lwsp, int *iwsp, const int liwsp);
+
+int krylov_zcooexpv_wsp(const int n, const int nz, const int *ia, const int *ja, const double _Complex *a, const double _Complex *v, const int tn, const double *ta, double _Complex *w_seq, const int klim, const int m, const double tol,  const int itrace, double _Complex *wsp, const int lwsp, int *iwsp, const int liwsp);
+
 //#ifdef __cplusplus
 //}
 //#endif
@@ -2,6 +2,7 @@
 #define MISC_H
 #include <armadillo>
 #include "include/spin/Spin.h"
+#include "include/spin/SpinStore.h"
 #include <cassert>
 
 using namespace arma;
@@ -18,6 +19,25 @@ vec zeeman(const cSPIN& spin, const vec& magB);
 
 vec dipole_field(const cSPIN& spin, const cSPIN& source_spin, const cx_vec& source_state_vect);
 
+vec dipole_tensor(double rx, double ry, double rz, double gamma1, double gamma2);
+
+double spin_distance(const cSpinStore& store, size_t i, size_t j);
+
+vec dipole(const cSpinStore& store, size_t i, size_t j);
+
+vec dipole(const cSPIN& spin, const cSpinStore& store, size_t j);
+
+vec dipole_field(const cSpinStore& store, size_t i, size_t source, const vec& source_spin_vect);
+
+vec zeeman(const cSpinStore& store, size_t i, const vec& magB);
+
+void dipole_tensor_batch(size_t npair, const double* rx, const double* ry, const double* rz, const double* gg,
+                         double* dxx, double* dxy, double* dxz, double* dyy, double* dyz, double* dzz);
+
+mat dipole(const cSpinStore& store, const vector<size_t>& pair_index);
+
+mat dipole_field(const cSpinStore& store, const uvec& target, const mat& source_spin_vec, const vec& weight);
+
 vector<double> Pulse_Timing(string pulsename, int n);
 
 vector<double> Pulse_Interval(string pulsename, int n);
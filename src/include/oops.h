@@ -30,9 +30,11 @@
 #include "include/misc/misc.h"
 #include "include/misc/xmlreader.h"
 
+#include "include/quantum/BatchEvolution.h"
 #include "include/quantum/HilbertSpaceOperator.h"
 #include "include/quantum/LiouvilleSpaceOperator.h"
 #include "include/quantum/MixedState.h"
+#include "include/quantum/PairEvolution.h"
 #include "include/quantum/PureState.h"
 #include "include/quantum/QuantumEvolution.h"
 #include "include/quantum/QuantumEvolutionAlgorithm.h"
@@ -0,0 +1,69 @@
+#ifndef BATCHEVOLUTION_H
+#define BATCHEVOLUTION_H
+
+#include <vector>
+#include <complex>
+#include <armadillo>
+
+using namespace std;
+using namespace arma;
+
+/// \addtogroup Quantum
+/// @{
+
+/// \defgroup BatchEvolution BatchEvolution
+/// @{
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ BatchPiecewiseCoherence
+/// The coherence Re <psi_1(t)|psi_2(t)> of many small systems of the same dimension at once,
+/// e.g. all the CCE clusters of order 1-3.
+/// Each item b has op_num Hamiltonians and an initial state psi_b. The two branches are
+/// piecewise-constant sequences as in PiecewiseFullMatrixVectorEvolution: segment j of branch
+/// k evolves under operator op_index_k[j] during time_segment[j]*t.
+///
+/// The data are stored in SoA layout with the item index innermost, i.e. the element (r, c)
+/// of the matrix of item b is at [(r*dim + c)*nBatch + b], split into real and imaginary parts.
+/// Every matrix operation is then a loop over the batch which is vectorized,
+/// and the exponentials are computed by a Taylor series with scaling and squaring.
+///
+/// runTrace() is the ensemble counterpart: Re tr(L rho_b R) of PiecewiseTraceEvolution, with
+/// L = L_0 L_1 ... and R = R_0 R_1 ... the products of exp(-i H tau) and exp(i H tau) over
+/// the segments of the two sequences, for the density matrices given by setDensity().
+class BatchPiecewiseCoherence
+{
+public:
+    BatchPiecewiseCoherence();
+    BatchPiecewiseCoherence(size_t dim, size_t batch_size, size_t op_num);
+    ~BatchPiecewiseCoherence();
+
+    size_t getDim() const {return _dim;};
+    size_t getBatchSize() const {return _nBatch;};
+
+    void setOperator(size_t item, size_t op, const cx_mat& H);
+    void setState(size_t item, const cx_vec& psi);
+    void setDensity(size_t item, const cx_mat& rho);
+
+    mat  run(const vector<int>& op_index1, const vector<int>& op_index2, const vector<double>& time_segment, const vec& time_list);
+    mat  runTrace(const vector<int>& left_index, const vector<int>& right_index, const vector<double>& time_segment, const vec& time_list);
+protected:
+private:
+    size_t _dim;
+    size_t _nBatch;
+    size_t _nOp;
+
+    vector<double> _H_re, _H_im;      // [op][r][c][b]
+    vector<double> _psi_re, _psi_im;  // [r][b]
+    vector<double> _rho_re, _rho_im;  // [r][c][b]
+
+    void expm(const double* Hr, const double* Hi, double tau, double* Ur, double* Ui) const;
+    void matmul(const double* Ar, const double* Ai, const double* Br, const double* Bi, double* Cr, double* Ci) const;
+    void matvec(const double* Ar, const double* Ai, const double* xr, const double* xi, double* yr, double* yi) const;
+    void key_propagators(const vector< pair<int, double> >& key_list, double dt, vector<double>& U_re, vector<double>& U_im) const;
+};
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+/// @}
+/// @}
+#endif
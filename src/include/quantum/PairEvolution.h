@@ -0,0 +1,68 @@
+#ifndef PAIREVOLUTION_H
+#define PAIREVOLUTION_H
+
+#include <vector>
+#include <complex>
+#include <armadillo>
+
+using namespace std;
+using namespace arma;
+
+/// \addtogroup Quantum
+/// @{
+
+/// \defgroup PairEvolution PairEvolution
+/// @{
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ SpinPairCoherence
+/// The closed-form coherence of a pair of spin-1/2 (dimension 4), the most numerous CCE-2 clusters.
+/// Each Hamiltonian is split into the blocks of basis states coupled by its nonzero elements.
+/// A secular pair Hamiltonian has the blocks |uu>, {|ud>, |du>} and |dd>: the middle one is the
+/// pseudo-spin h = c0 + n.sigma, whose propagator is
+///
+///   exp(-i h tau) = exp(-i c0 tau) [ cos(|n| tau) - i sin(|n| tau) n.sigma/|n| ],
+///
+/// and the 1 x 1 blocks are phases. A larger block (e.g. the whole 4 x 4 of a non-secular pair)
+/// is diagonalized once. No matrix exponential is computed, and every time point is exact.
+///
+/// The sequences are those of the piecewise engines: segment j of a branch evolves under the
+/// operator op_index[j] during time_segment[j]*t, with t = i*dt on the grid time_list.
+class SpinPairCoherence
+{
+public:
+    SpinPairCoherence();
+    SpinPairCoherence(const vector<cx_mat>& hm_list);
+    ~SpinPairCoherence();
+
+    cx_mat propagator(int op, double tau) const; ///< exp(-i H_op tau)
+
+    /// Re tr(L rho R) as PiecewiseTraceEvolution, L = prod_j exp(-i H_{left_index[j]} tau_j) and
+    /// R = prod_j exp(i H_{right_index[j]} tau_j) in the order of j; rho = I/4 for an unpolarized bath.
+    vec getTraceList(const vector<int>& left_index, const vector<int>& right_index,
+                     const vector<double>& time_segment, const vec& time_list, const cx_mat& rho) const;
+    /// Re <psi_1(t)|psi_2(t)> as the two PiecewiseEigenVectorEvolution kernels of SingleSampleCCE,
+    /// the segment 0 acting first.
+    vec getOverlapList(const vector<int>& op_index1, const vector<int>& op_index2,
+                       const vector<double>& time_segment, const vec& time_list, const cx_vec& psi) const;
+protected:
+private:
+    struct PairBlock
+    {
+        uvec      index; ///< the basis states of the block
+        double    c0;    ///< 1 x 1 and 2 x 2 blocks: h = c0 + n.sigma,
+        double    nz;    ///< with n.sigma = [nz, b; conj(b), -nz]
+        cx_double b;
+        vec       E;     ///< larger blocks: h = V diag(E) V^+
+        cx_mat    V;
+    };
+
+    size_t _dim;
+    vector< vector<PairBlock> > _block_list;
+};
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+/// @}
+/// @}
+#endif
@@ -6,13 +6,117 @@
 #include "include/quantum/MixedState.h"
 #include "include/quantum/PureState.h"
 #include "include/math/MatExp.h"
+#include "include/math/FixedDimKernel.h"
+#include "include/kron/KronApply.h"
+#include "include/math/KrylovExpv.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ EvolutionObserver
+/// The states produced by QuantumEvolutionAlgorithm::perform are handed to an observer,
+/// one time point at a time (i = 0 is the initial state). An observer that reduces each
+/// state to its observables at once keeps the state history from being materialized.
+class EvolutionObserver
+{
+public:
+    EvolutionObserver() {};
+    virtual ~EvolutionObserver() {};
+
+    virtual void observe(int i, const cx_vec& state) {};
+    virtual void observe(int i, const cx_mat& state) {};
+};
+
+/// The default observer: the states are appended to the result lists of the algorithm.
+class StateListObserver:public EvolutionObserver
+{
+public:
+    StateListObserver(vector<cx_vec>& vector_list, vector<cx_mat>& state_mat_list):_vector_list(vector_list), _state_mat_list(state_mat_list) {};
+    ~StateListObserver() {};
+
+    void observe(int i, const cx_vec& state) {_vector_list.push_back(state);};
+    void observe(int i, const cx_mat& state) {_state_mat_list.push_back(state);};
+private:
+    vector<cx_vec>& _vector_list;
+    vector<cx_mat>& _state_mat_list;
+};
+
+/// res(i) = Re tr(rho_i)
+class TraceObserver:public EvolutionObserver
+{
+public:
+    TraceObserver(int nTime) {_result = zeros<vec>(nTime);};
+    ~TraceObserver() {};
+
+    vec  getResult() const {return _result;};
+    void observe(int i, const cx_mat& state) {_result(i) = real( trace(state) );};
+private:
+    vec _result;
+};
+
+/// res(i) = Re <ref_i|psi_i>, the reference states being given.
+class OverlapObserver:public EvolutionObserver
+{
+public:
+    OverlapObserver(const vector<cx_vec>& ref_list):_ref_list(ref_list) {_result = zeros<vec>(ref_list.size());};
+    ~OverlapObserver() {};
+
+    vec  getResult() const {return _result;};
+    void observe(int i, const cx_vec& state) {_result(i) = real( fixed_overlap(state.n_elem, _ref_list[i].memptr(), state.memptr()) );};
+private:
+    const vector<cx_vec>& _ref_list;
+    vec _result;
+};
+
+/// The states evolved in a subspace (the basis states sub of the full space)
+/// are embedded back into the full space before they are passed on.
+class SubspaceObserver:public EvolutionObserver
+{
+public:
+    SubspaceObserver(EvolutionObserver& obs, const uvec& sub, size_t dim):_obs(obs), _sub(sub) {_state = zeros<cx_vec>(dim);};
+    ~SubspaceObserver() {};
+
+    void observe(int i, const cx_vec& state) {_state.elem(_sub) = state; _obs.observe(i, _state);};
+private:
+    EvolutionObserver& _obs;
+    const uvec& _sub;
+    cx_vec _state;
+};
+
+/// The states evolved in the interaction picture of H0 are taken back to the lab frame,
+/// exp(-i H0 t_i) psi_i with t_i = i*t_unit, before they are passed on.
+class FrameObserver:public EvolutionObserver
+{
+public:
+    FrameObserver(EvolutionObserver& obs, const KronSingleSpinExp& frame, double t_unit):_obs(obs), _frame(frame), _t_unit(t_unit) {_state = zeros<cx_vec>(frame.getDim());};
+    ~FrameObserver() {};
+
+    void observe(int i, const cx_vec& state) {_frame.apply(i*_t_unit, state.memptr(), _state.memptr()); _obs.observe(i, _state);};
+private:
+    EvolutionObserver& _obs;
+    const KronSingleSpinExp& _frame;
+    double _t_unit;
+    cx_vec _state;
+};
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
 
 ////////////////////////////////////////////////////////////////////////////////
 //{{{ QuantumEvolutionAlgorithm
+/// By default, perform() stores the state of every time point (getResult()/getResultMat());
+/// after setObserver(), the states are passed to the observer instead and nothing is stored.
+/// With setSubspaceMode(true), the vector engines which support it evolve the initial state
+/// only in the subspace it can reach, e.g. its blocks of total Sz under a secular Hamiltonian,
+/// and the trace engines split the trace over the invariant subspaces of the segments.
+/// After setInteractionPicture(h0), the operators given to the engine are the remainders H - h0,
+/// which must commute with the single-spin operator h0 (e.g. the secular couplings and the Zeeman
+/// terms); the vector engines propagate in the frame of h0 and go back to the lab frame at each
+/// time point. h0 is the same for all the segments, so that a point at i*dt is rotated by exp(-i h0 i*dt)
+/// for a sequence of unit length.
 class QuantumEvolutionAlgorithm
 {
 public:
-    QuantumEvolutionAlgorithm() {};
+    QuantumEvolutionAlgorithm() {_observer = NULL; _is_subspace = false; _is_interaction_picture = false;};
     QuantumEvolutionAlgorithm(QuantumOperator& op, QuantumState& st);
     ~QuantumEvolutionAlgorithm() {};
 
@@ -24,6 +128,9 @@ public:
     vector<cx_mat> getResultMat() const {return _state_mat_list;};
     cx_vec getInitalState() const {return _init_state.getVector();}; 
     size_t getMatrixDim() const {return _init_state.getDimension();}
+    void   setObserver(EvolutionObserver* observer) {_observer = observer;};
+    void   setSubspaceMode(bool is_subspace) {_is_subspace = is_subspace;};
+    void   setInteractionPicture(const QuantumOperator& h0) {_frame = KronSingleSpinExp(h0.getPlan()); _is_interaction_picture = true;};
 
     virtual void perform()=0;
 protected:
@@ -35,6 +142,17 @@ protected:
     cx_mat         _matrix;
     vector<cx_vec> _vector_list;
     vector<cx_mat> _state_mat_list;
+    EvolutionObserver* _observer;
+    bool           _is_subspace;
+    bool           _is_interaction_picture;
+    KronSingleSpinExp _frame;
+
+    static uvec occupied_subspace(const vector<cx_mat>& op_list, const cx_vec& x);
+    static uvec occupied_subspace(const vector<KronOperatorPlan>& plan_list, const cx_vec& x);
+    static vector<uvec> occupied_blocks(const vector<cx_mat>& op_list, size_t dim);
+    static vector<uvec> occupied_blocks(const vector<KronOperatorPlan>& plan_list, size_t dim);
+    static void index_operators(const vector<QuantumOperator>& op_list, vector<QuantumOperator>& distinct_list, vector<int>& op_index);
+    static void index_segments(const vector<int>& op_index, const vector<double>& time_segment, vector< pair<int, double> >& key_list, vector<int>& key_index);
 private:
 };
 //}}}
@@ -62,6 +180,8 @@ private:
 
 ////////////////////////////////////////////////////////////////////////////////
 //{{{ PiecewiseFullMatrixVectorEvolution
+/// Only the distinct operators of op_list are kept (e.g. the two Hamiltonians of a riffle),
+/// and one propagator is computed for each distinct (operator, segment length) pair.
 class PiecewiseFullMatrixVectorEvolution:public QuantumEvolutionAlgorithm
 {
 public:
@@ -73,6 +193,7 @@ public:
 protected:
 private:
     vector<QuantumOperator> _op_list;
+    vector<int>    _op_index;
     vector<double> _time_segment;
 };
 //}}}
@@ -81,8 +202,79 @@ private:
 
 
 
+////////////////////////////////////////////////////////////////////////////////
+//{{{ PiecewiseEigenVectorEvolution
+/// The same piecewise-constant evolution as PiecewiseFullMatrixVectorEvolution,
+/// but each Hamiltonian H = V diag(E) V^+ is diagonalized once by eig_sym,
+/// and the state at every time point is built as V diag(exp(-i E tau)) V^+ x.
+/// The cost per time point is O(nSeg d^2) instead of O(nSeg d^3),
+/// and no propagator is accumulated over the time steps.
+/// In subspace mode, the Hamiltonians are restricted to the subspace occupied by the
+/// initial state before they are diagonalized.
+class PiecewiseEigenVectorEvolution:public QuantumEvolutionAlgorithm
+{
+public:
+    PiecewiseEigenVectorEvolution() {};
+    PiecewiseEigenVectorEvolution(const vector<QuantumOperator>& op_list, const vector<double>& time_segment, const QuantumState& st);
+    ~PiecewiseEigenVectorEvolution() {};
+
+    void perform();
+protected:
+private:
+    vector<QuantumOperator> _op_list;
+    vector<int>    _op_index;
+    vector<double> _time_segment;
+};
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ FloquetVectorEvolution
+/// Evolution under a periodic piecewise-constant sequence, e.g. a CPMG cycle repeated many times.
+/// One period of length "period" is made of the segments op_list[j] during time_segment[j]*period
+/// (the fractions from Pulse_Interval sum up to 1).
+/// The one-period propagator U_F = Q diag(lambda) Q^+ is built and diagonalized once by its complex
+/// Schur form (U_F being unitary, Q is unitary even for degenerate lambda), so that the state at
+/// t = N*period + tau is U(tau) Q diag(lambda^N) Q^+ x, where U(tau) is the partial period applied
+/// segment by segment in the eigenbasis of each Hamiltonian.
+/// Unlike the other piecewise engines, the time list is the absolute time, and each point costs O(nSeg d^2).
+class FloquetVectorEvolution:public QuantumEvolutionAlgorithm
+{
+public:
+    FloquetVectorEvolution() {};
+    FloquetVectorEvolution(const vector<QuantumOperator>& op_list, const vector<double>& time_segment, double period, const QuantumState& st);
+    ~FloquetVectorEvolution() {};
+
+    cx_vec getFloquetEigenvalues() const {return _floquet_eigval;};
+    vec    getQuasiEnergies() const;
+
+    void perform();
+protected:
+private:
+    vector<QuantumOperator> _op_list;
+    vector<int>    _op_index;
+    vector<double> _time_segment;
+    double         _period;
+
+    vector<vec>    _eigval_list;
+    vector<cx_mat> _eigvec_list;
+    cx_vec         _floquet_eigval;
+    cx_mat         _floquet_eigvec;
+
+    void   make_floquet_operator();
+    cx_vec partial_period(const cx_vec& x, double tau);
+};
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
+
 ////////////////////////////////////////////////////////////////////////////////
 //{{{  PiecewiseFullMatrixMatrixEvolution
+/// As in PiecewiseFullMatrixVectorEvolution, the left and right propagators are
+/// computed once for each distinct (operator, segment length) pair.
 class PiecewiseFullMatrixMatrixEvolution:public QuantumEvolutionAlgorithm
 {
 public:
@@ -98,9 +290,171 @@ private:
     DensityOperator _density_matrix;
     vector<QuantumOperator> _left_op_list;
     vector<QuantumOperator> _right_op_list;
+    vector<int>    _left_op_index;
+    vector<int>    _right_op_index;
     vector<double> _time_segment;
 };
 
 //}}}
 ////////////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{  PiecewiseTraceEvolution
+/// Re tr(L rho R) for the sequences of PiecewiseFullMatrixMatrixEvolution, where
+/// L = L_0 L_1 ... L_{n-1} and R = R_0 R_1 ... R_{n-1} are the products of the segment propagators,
+/// without forming rho(t) = L rho R:
+///
+///   rho = I/d:  tr(L R)/d = sum_ab L_ab R_ba;
+///   otherwise:  sum_a L(a,:) rho R(:,a), rho being applied by KronApply in its Kronecker form.
+///
+/// A time step still costs O(d^3): each distinct segment propagator is advanced by one product,
+/// and L and R are dense products of them. What is saved are the two products per segment of
+/// PiecewiseFullMatrixMatrixEvolution, since L and R are never applied to rho; the trace itself is
+/// O(d^2). A segment sequence made of a head, r repetitions of a pattern and a tail (e.g. the
+/// echoes of CPMG between the two half intervals) is multiplied as head * pattern^r * tail,
+/// with O(log r) products for the power.
+/// With setSubspaceMode(true), the trace is summed over the invariant subspaces of the segments
+/// (e.g. the blocks of total Sz of a secular Hamiltonian) as long as rho does not mix them.
+class PiecewiseTraceEvolution:public QuantumEvolutionAlgorithm
+{
+public:
+    PiecewiseTraceEvolution() {};
+    PiecewiseTraceEvolution(
+            const vector<QuantumOperator>& left_op_list, 
+            const vector<QuantumOperator>& right_op_list, const vector<double>& time_segment, const DensityOperator& ds);
+    PiecewiseTraceEvolution(
+            const vector<QuantumOperator>& left_op_list, 
+            const vector<QuantumOperator>& right_op_list, const vector<double>& time_segment, size_t dim);
+    ~PiecewiseTraceEvolution() {};
+
+    vec  getTraceList() const {return _trace_list;};
+    void perform();
+protected:
+private:
+    bool             _is_identity;
+    KronOperatorPlan _rho_plan;
+    vector<QuantumOperator> _left_op_list;
+    vector<QuantumOperator> _right_op_list;
+    vector<int>    _left_op_index;
+    vector<int>    _right_op_index;
+    vector<double> _time_segment;
+    vec            _trace_list;
+};
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{  PiecewiseTypicalityEvolution
+/// The same Re tr(L rho R) as PiecewiseTraceEvolution, estimated by quantum typicality for the
+/// clusters whose d x d propagators are out of reach. For random-phase vectors phi (|phi_n| = 1),
+/// E[ <phi| rho R L |phi> ] = tr(rho R L), and
+///
+///   <phi| rho R L |phi> = < R^+ rho phi | L phi >,
+///
+/// where both L phi and R^+ rho phi are forward evolutions exp(-i H tau) of a vector, computed
+/// segment by segment by the matrix-free Krylov path (KronApply + Lanczos), all the samples
+/// being propagated together as one block by BlockKrylovExpv.
+/// getTraceList() is the mean over sample_num vectors and getErrorList() its standard error;
+/// the relative error decreases as 1/sqrt(sample_num * d).
+/// For a single-spin h0 common to both sides and commuting with all the segments, L = exp(-i h0 t) L'
+/// and R = R' exp(i h0 t), so tr(rho R L) = tr(rho R' L'): the segments can be given without h0
+/// (e.g. the Zeeman terms of a secular Hamiltonian), which keeps the Krylov steps long.
+/// With setSubspaceMode(true), each invariant subspace of the segments is sampled on its own,
+/// with the operators restricted to it (KronSubspaceApply), as long as rho does not mix them.
+///
+/// With setSinglePrecision(true), the samples are propagated as cx_float blocks (the matvec-bound
+/// part runs at half the memory traffic). As a residual check, the first sample at the last time
+/// point, where the rounding errors have accumulated most, is then recomputed in double; if the two
+/// differ by more than the tolerance, the whole cluster is rerun in double with the same samples,
+/// and isRerunInDouble() reports it.
+class PiecewiseTypicalityEvolution:public QuantumEvolutionAlgorithm
+{
+public:
+    PiecewiseTypicalityEvolution() {};
+    PiecewiseTypicalityEvolution(
+            const vector<QuantumOperator>& left_op_list, 
+            const vector<QuantumOperator>& right_op_list, const vector<double>& time_segment, const DensityOperator& ds,
+            int sample_num, unsigned int seed);
+    PiecewiseTypicalityEvolution(
+            const vector<QuantumOperator>& left_op_list, 
+            const vector<QuantumOperator>& right_op_list, const vector<double>& time_segment, size_t dim,
+            int sample_num, unsigned int seed);
+    ~PiecewiseTypicalityEvolution() {};
+
+    vec  getTraceList() const {return _trace_list;};
+    vec  getErrorList() const {return _error_list;};
+    void setSinglePrecision(bool is_single_precision, double residual_tol = 1e-5)
+    { _is_single_precision = is_single_precision; _residual_tol = residual_tol; };
+    bool isRerunInDouble() const {return _is_rerun;};
+    void perform();
+protected:
+private:
+    bool             _is_identity;
+    bool             _is_single_precision;
+    bool             _is_rerun;
+    double           _residual_tol;
+    KronOperatorPlan _rho_plan;
+    size_t           _dim;
+    int              _sample_num;
+    unsigned long long _rng;
+    vector<QuantumOperator> _left_op_list;
+    vector<QuantumOperator> _right_op_list;
+    vector<int>    _left_op_index;
+    vector<int>    _right_op_index;
+    vector<double> _time_segment;
+    vec            _trace_list;
+    vec            _error_list;
+
+    cx_vec random_phase_state(size_t dim);
+};
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{  PiecewiseTrotterVectorEvolution
+/// The piecewise-constant evolution of PiecewiseFullMatrixVectorEvolution by a Trotter-Suzuki
+/// split-operator propagator, for operators made of one- and two-spin terms (as the cluster
+/// Hamiltonians are). The terms are grouped into local gate Hamiltonians h_1 ... h_G, one per
+/// spin or spin pair, each diagonalized once. A step of length tau is
+///
+///   order 2:  S2(tau) = e^{-i h_1 tau/2} ... e^{-i h_{G-1} tau/2} e^{-i h_G tau} e^{-i h_{G-1} tau/2} ... e^{-i h_1 tau/2},
+///   order 4:  S4(tau) = S2(p tau)^2 S2((1-4p) tau) S2(p tau)^2,  p = 1/(4-4^{1/3}),
+///
+/// and every gate is applied in place to the state tensor by kron_gate_apply; no global matrix is formed.
+/// The step of each operator follows from the commutator estimate of the error per unit time,
+///
+///   err(tau) ~ tau^order * beta * Lambda^{order-1} / 12,
+///
+/// with beta = sum_{i<j} ||[h_i, h_j]||_F over the gates sharing a spin and Lambda = max_i ||h_i||_2;
+/// a segment of length T is divided into ceil(T/tau_max) equal steps, and the gates of these steps
+/// are built once per time point for each distinct (operator, segment length).
+/// An operator with a term on three or more spins has no gate form; its segments are propagated
+/// by KrylovExpv on the Kronecker form instead.
+class PiecewiseTrotterVectorEvolution:public QuantumEvolutionAlgorithm
+{
+public:
+    PiecewiseTrotterVectorEvolution() {};
+    PiecewiseTrotterVectorEvolution(const vector<QuantumOperator>& op_list, const vector<double>& time_segment, const QuantumState& st, int order = 2);
+    ~PiecewiseTrotterVectorEvolution() {};
+
+    void   setTolerance(double tol) {_tol = tol;};
+    size_t getStepNum() const {return _step_num;}; ///< the total number of Trotter steps of the last perform()
+    void   perform();
+protected:
+private:
+    vector<QuantumOperator> _op_list;
+    vector<int>    _op_index;
+    vector<double> _time_segment;
+    int            _order;
+    double         _tol;
+    size_t         _step_num;
+};
+//}}}
+////////////////////////////////////////////////////////////////////////////////
 #endif
@@ -7,6 +7,7 @@
 #include <armadillo>
 #include "include/easylogging++.h"
 #include "include/kron/KronProd.h"
+#include "include/kron/KronOperatorPlan.h"
 
 using namespace std;
 extern string DEBUG_PATH;
@@ -19,18 +20,35 @@ extern string DEBUG_PATH;
 
 ////////////////////////////////////////////////////////////////////////////////
 //{{{ QuantumOperator
+/// The matrix-free evolutions run over a KronOperatorPlan of the operator.
+/// The plan is compiled at the first call of getPlan() and kept until _kron_form changes,
+/// so every exponential of the same operator (and of its copies made afterwards) reuses it.
+/// Derived classes which assign _kron_form must call invalidate_plan().
+/// isSame() compares two operators through the hash of their plans, which lets the
+/// evolution engines recognize the copies made by riffle().
+/// The lazy compilation writes the mutable plan, so getPlan() is not thread-safe on an operator
+/// which is not compiled yet: call compile() before sharing it between threads. The evolution
+/// engines compile their operators in the constructor (index_operators), so that perform() and
+/// the parallel KronApply products only read the plans.
 class QuantumOperator
 {
 public:
-    QuantumOperator() {};
+    QuantumOperator() {_is_plan_ready = false;};
     ~QuantumOperator() {};
 
-    cx_mat       getMatrix() {return _kron_form.full();};
+    cx_mat       getMatrix() const {return _kron_form.full();};
     SumKronProd  getKronProdForm() const  {return _kron_form;};
+    const SumKronProd& getKronProdFormRef() const {return _kron_form;};
     DIM_LIST     getDimList() const {return _dim_list;};
     int          getDimension() const {return _dimension;};
     void         saveMatrix(string filename);
-    QuantumOperator& scale(double factor) {_kron_form.scale(factor); return *this;};
+    QuantumOperator& scale(double factor) {_kron_form.scale(factor); invalidate_plan(); return *this;};
+
+    const KronOperatorPlan& getPlan() const;
+    void         compile() const {getPlan();};
+    bool         isCompiled() const {return _is_plan_ready;};
+    size_t       getHash() const {return getPlan().getHash();};
+    bool         isSame(const QuantumOperator& op) const {return getPlan() == op.getPlan();};
 
     friend QuantumOperator operator + (const QuantumOperator& op1, const QuantumOperator& op2);
     friend QuantumOperator operator - (const QuantumOperator& op1, const QuantumOperator& op2);
@@ -38,7 +56,11 @@ protected:
     int         _dimension;
     DIM_LIST    _dim_list;
     SumKronProd _kron_form;
+
+    void invalidate_plan() {_is_plan_ready = false; _plan = KronOperatorPlan();};
 private:
+    mutable bool             _is_plan_ready;
+    mutable KronOperatorPlan _plan;
 };
 //}}}
 ////////////////////////////////////////////////////////////////////////////////
@@ -5,6 +5,7 @@
 #include <armadillo>
 #include "include/spin/Spin.h"
 #include "include/spin/SpinSource.h"
+#include "include/spin/SpinStore.h"
 //#include "include/spin/SpinClusterAlgorithm.h"
 #include "include/spin/SpinClusterIndex.h"
 
@@ -22,6 +23,7 @@ using namespace arma;
 //{{{ cSpinCollection
 /// This class generates a collection of spins (spin_list) from a given cSpinSource.
 /// This class also computes distances between spins, and connection matrix with a given threshlod distance.
+/// The spins are also kept in a cSpinStore, which the hot paths index into without copying cSPIN objects.
 ///
 class cSpinCollection
 {
@@ -36,8 +38,9 @@ public:
 
     //@{
     size_t           getSpinNum() const {return _spin_list.size();};
-    vector<cSPIN> getSpinList() const {return _spin_list;};
+    const vector<cSPIN>& getSpinList() const {return _spin_list;};
     vector<cSPIN> getSpinList(const cClusterIndex& clst) const;
+    const cSpinStore& getSpinStore() const {return _spin_store;};
     mat getCoordinateMat() const;
     mat& getDistanceMatrix() {return dist_mat;};
     sp_mat getConnectionMatrix (double threshold) const;
@@ -45,6 +48,7 @@ public:
 private:
     cSpinSource* _source;
     vector<cSPIN> _spin_list;
+    cSpinStore    _spin_store;
 
     mat dist_mat;
 };
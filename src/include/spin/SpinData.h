@@ -34,7 +34,7 @@ class cSPINDATA
 {
 public:
     cSPINDATA();
-    SpinProperty getData(string name) {return data[name]; };
+    SpinProperty getData(const string& name) const;
 private:
     map<string, SpinProperty> data;
 
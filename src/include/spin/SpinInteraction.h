@@ -30,12 +30,14 @@ public:
     ~cSpinInteraction();
 
     void make();
+    void make_secular();
     SumKronProd& getSumKronProd(){return _sum_kron_prod;};
     DIM_LIST getDimList() {return _dim_list;};
+    const cSpinStore& getSpinStore() const {return _spin_store;};
 
     friend ostream&  operator << (ostream& outs, cSpinInteraction& spin_interaction);
 protected:
-    vector<cSPIN> _spin_list;
+    cSpinStore             _spin_store;
     cSpinInteractionDomain _domain;
     cSpinInteractionForm   _form;
     cSpinInteractionCoeff  _coeff;
@@ -54,7 +56,7 @@ class SpinDipolarInteraction:public cSpinInteraction
 {
 public:
     SpinDipolarInteraction();
-    SpinDipolarInteraction(const vector<cSPIN>& spin_list);
+    SpinDipolarInteraction(const vector<cSPIN>& spin_list, bool is_secular = false);
     ~SpinDipolarInteraction();
 protected:
 private:
@@ -89,6 +91,7 @@ public:
     DipolarField(const vector<cSPIN>& spin_list, const cSPIN& center_spin, const PureState& state);
     DipolarField(const vector<cSPIN>& spin_list, const vector<cSPIN>& source_list, const vector<PureState>& state_list);
     DipolarField(const vector<cSPIN>& spin_list, const vector<cSPIN>& source_list, const vector<PureState>& state_list, const uvec& exclude_idx);
+    DipolarField(const vector<cSPIN>& spin_list, const cSpinStore& bath, const uvec& clst_idx, const mat& source_spin_vec);
     ~DipolarField();
 protected:
 private:
@@ -5,6 +5,7 @@
 #include <armadillo>
 #include "include/easylogging++.h"
 #include "include/spin/Spin.h"
+#include "include/spin/SpinStore.h"
 #include "include/spin/SpinInteractionDefine.h"
 #include "include/quantum/PureState.h"
 
@@ -21,22 +22,29 @@ using namespace arma;
 /// @{
 ////////////////////////////////////////////////////////////////////////////////
 //{{{ cSpinInteractionDomain
+/// A domain only keeps the indices of the spins involved in each interaction term.
+/// The indices are stored twice: as an INDEX_LIST, which is used to fill KronProd,
+/// and as a flat array of length get_nBody()*getLength(), which the coefficient 
+/// kernels run over.
 class cSpinInteractionDomain
 {
 public:
      cSpinInteractionDomain();
     ~cSpinInteractionDomain();
 
-    INDEX_LIST getIndexList() const {return _index_list;};
-    vector< vector<cSPIN> > getSpinAggregate() const {return _spin_aggregate;};
+    const INDEX_LIST& getIndexList() const {return _index_list;};
+    const INDICES&    getIndexArray() const {return _index_array;};
+    size_t getIndex(size_t q, int body) const {return _index_array[q*_nbody+body];};
     size_t getLength() const {return _index_list.size();};
     int get_nBody() const {return _nbody;};
 
     friend ostream&  operator << (ostream& outs, const cSpinInteractionDomain& dm);
 protected:
+    void append(const INDICES& idx);
+
     int _nbody;
-    vector< vector<cSPIN> > _spin_aggregate;
     INDEX_LIST _index_list;
+    INDICES    _index_array;
 };
 //}}}
 //----------------------------------------------------------------------------//
@@ -44,7 +52,7 @@ protected:
 class SpinPair:public cSpinInteractionDomain
 {
 public:
-    SpinPair(const vector<cSPIN>& spin_list);
+    SpinPair(size_t nspin);
     ~SpinPair();
 };
 //}}}
@@ -53,8 +61,8 @@ public:
 class SingleSpin:public cSpinInteractionDomain
 {
 public:
-    SingleSpin(const vector<cSPIN>& spin_list);
-    SingleSpin(const vector<cSPIN>& spin_list, const vector<int>& pick_up_spins);
+    SingleSpin(size_t nspin);
+    SingleSpin(const vector<int>& pick_up_spins);
     ~SingleSpin();
 };
 //}}}
@@ -71,7 +79,7 @@ public:
      cSpinInteractionForm();
     ~cSpinInteractionForm();
 
-    MAT_LIST getMatList(){return _mat_list;};
+    const MAT_LIST& getMatList() const {return _mat_list;};
     size_t getLength(){return _mat_list.size();};
     int get_nTerm(){return _nterm;};
 
@@ -86,7 +94,7 @@ protected:
 class TwoSpinInteractionForm:public cSpinInteractionForm
 {
 public:
-    TwoSpinInteractionForm(const cSpinInteractionDomain& domain);
+    TwoSpinInteractionForm(const cSpinInteractionDomain& domain, const cSpinStore& spin_store);
     ~TwoSpinInteractionForm();
 };
 //}}}
@@ -95,7 +103,7 @@ public:
 class SingleSpinInteractionForm:public cSpinInteractionForm
 {
 public:
-    SingleSpinInteractionForm(const cSpinInteractionDomain& domain);
+    SingleSpinInteractionForm(const cSpinInteractionDomain& domain, const cSpinStore& spin_store);
     ~SingleSpinInteractionForm();
 };
 //}}}
@@ -113,9 +121,10 @@ public:
      cSpinInteractionCoeff();
     ~cSpinInteractionCoeff();
 
-    COEFF_LIST getCoeffList(){return _coeff_list;};
+    const COEFF_LIST& getCoeffList() const {return _coeff_list;};
     size_t getLength(){return _coeff_list.size();};
     int get_nCoeff(){return _nCoeff;};
+    void truncate_secular(const cSpinInteractionDomain& domain, const cSpinStore& spin_store);
 
     friend ostream&  operator << (ostream& outs, cSpinInteractionCoeff& coef);
 protected:
@@ -128,7 +137,7 @@ protected:
 class DipolarInteractionCoeff:public cSpinInteractionCoeff
 {
 public:
-    DipolarInteractionCoeff(const cSpinInteractionDomain& domain);
+    DipolarInteractionCoeff(const cSpinInteractionDomain& domain, const cSpinStore& spin_store, bool is_secular = false);
     ~DipolarInteractionCoeff();
 };
 //}}}
@@ -137,7 +146,7 @@ public:
 class ZeemanInteractionCoeff:public cSpinInteractionCoeff
 {
 public:
-    ZeemanInteractionCoeff(const cSpinInteractionDomain& domain, const vec& magB);
+    ZeemanInteractionCoeff(const cSpinInteractionDomain& domain, const cSpinStore& spin_store, const vec& magB);
     ~ZeemanInteractionCoeff();
 };
 //}}}
@@ -147,9 +156,10 @@ public:
 class DipolarFieldInteractionCoeff:public cSpinInteractionCoeff
 {
 public:
-    DipolarFieldInteractionCoeff(const cSpinInteractionDomain& domain, const cSPIN& center_spin, const PureState& state);
-    DipolarFieldInteractionCoeff(const cSpinInteractionDomain& domain, const vector<cSPIN>& spin_list, const vector<PureState>& state_list);
-    DipolarFieldInteractionCoeff(const cSpinInteractionDomain& domain, const vector<cSPIN>& spin_list, const vector<PureState>& state_list, const vec& pre_factor_list);
+    DipolarFieldInteractionCoeff(const cSpinInteractionDomain& domain, const cSpinStore& spin_store, const cSPIN& center_spin, const PureState& state);
+    DipolarFieldInteractionCoeff(const cSpinInteractionDomain& domain, const cSpinStore& spin_store, const vector<cSPIN>& spin_list, const vector<PureState>& state_list);
+    DipolarFieldInteractionCoeff(const cSpinInteractionDomain& domain, const cSpinStore& spin_store, const vector<cSPIN>& spin_list, const vector<PureState>& state_list, const vec& pre_factor_list);
+    DipolarFieldInteractionCoeff(const cSpinInteractionDomain& domain, const cSpinStore& bath, const uvec& clst_idx, const mat& source_spin_vec);
     ~DipolarFieldInteractionCoeff();
 protected:
 private:
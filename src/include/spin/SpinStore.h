@@ -0,0 +1,85 @@
+#ifndef SPINSTORE_H
+#define SPINSTORE_H
+
+#include <vector>
+#include <string>
+#include <armadillo>
+#include "include/spin/Spin.h"
+
+using namespace std;
+using namespace arma;
+
+/// \addtogroup SpinList
+/// @{
+
+/// \defgroup SpinStore SpinStore
+/// @{
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ cSpinStore
+/// This class keeps a list of spins in the struct-of-arrays form.
+/// The coordinates are stored in contiguous x/y/z arrays, and the isotope of each spin
+/// is interned into an integer id, which indexes the gamma/multiplicity tables.
+/// Spins are addressed by their position in the store, no cSPIN object is copied.
+///
+class cSpinStore
+{
+public:
+    cSpinStore();
+    cSpinStore(const vector<cSPIN>& spin_list);
+    ~cSpinStore();
+
+    //@{
+    void          append(const cSPIN& spin);
+    void          reserve(size_t n);
+    //@}
+
+    //@{
+    size_t        getSpinNum() const {return _isotope_id.size();};
+    size_t        getIsotopeNum() const {return _isotope_name.size();};
+    const vector<double>& getX() const {return _x;};
+    const vector<double>& getY() const {return _y;};
+    const vector<double>& getZ() const {return _z;};
+    const vector<int>&    getIsotopeId() const {return _isotope_id;};
+    const vector<double>& getGammaTable() const {return _gamma_table;};
+    const vector<int>&    getMultiplicityTable() const {return _multiplicity_table;};
+    //@}
+
+    //@{
+    double        get_x(size_t i) const {return _x[i];};
+    double        get_y(size_t i) const {return _y[i];};
+    double        get_z(size_t i) const {return _z[i];};
+    int           get_isotope_id(size_t i) const {return _isotope_id[i];};
+    const string& get_isotope(size_t i) const {return _isotope_name[ _isotope_id[i] ];};
+    int           get_multiplicity(size_t i) const {return _multiplicity_table[ _isotope_id[i] ];};
+    int           get_dimension(size_t i) const {return _multiplicity_table[ _isotope_id[i] ];};
+    double        get_gamma(size_t i) const {return _gamma_table[ _isotope_id[i] ];};
+    double        get_omegaQ(size_t i) const {return _omegaQ_table[ _isotope_id[i] ];};
+    double        get_eta(size_t i) const {return _eta_table[ _isotope_id[i] ];};
+    vec           get_coordinate(size_t i) const;
+    //@}
+
+    //@{
+    cSPIN         getSpin(size_t i) const;
+    vector<cSPIN> getSpinList(const uvec& idx) const;
+    //@}
+private:
+    int intern(const cSPIN& spin);
+
+    vector<double> _x;
+    vector<double> _y;
+    vector<double> _z;
+    vector<int>    _isotope_id;
+
+    vector<string> _isotope_name;
+    vector<int>    _multiplicity_table;
+    vector<double> _gamma_table;
+    vector<double> _omegaQ_table;
+    vector<double> _eta_table;
+};
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+/// @}
+/// @}
+#endif
@@ -142,15 +142,45 @@ void CCE::run_each_clusters()
         size_t clst_num = _my_clusters.getClusterNum(cce_order);
         
         mat resMat(_nTime, clst_num, fill::ones);
-        for(int i = 0; i < clst_num; ++i)
+        for(int i = 0; i < clst_num; i += CLUSTER_BATCH_SIZE)
         {
             cout << "my_rank = " << _my_rank << ": " << i << "/" << clst_num << endl;
-            resMat.col(i) = cluster_evolution(cce_order, i);
+            vector<int> index_list;
+            for(int j = i; j < clst_num && j < i + CLUSTER_BATCH_SIZE; ++j)
+                index_list.push_back(j);
+            resMat.cols(i, index_list.back()) = cluster_evolution_batch(cce_order, index_list);
         }
         
         DataGathering(resMat, cce_order, clst_num);
     }
 }
+mat CCE::cluster_evolution_batch(int cce_order, const vector<int>& index_list)
+{
+/// The clusters are evolved one by one unless a derived class does better.
+    mat res(_nTime, index_list.size());
+    for(int i = 0; i < index_list.size(); ++i)
+        res.col(i) = cluster_evolution(cce_order, index_list[i]);
+    return res;
+}
+
+bool CCE::is_spin_half_pair(const vector<cSPIN>& spin_list)
+{
+/// The clusters solved in closed form by SpinPairCoherence.
+    return spin_list.size() == 2 && spin_list[0].get_dimension() == 2 && spin_list[1].get_dimension() == 2;
+}
+
+void CCE::check_secular_field()
+{
+/// The secular truncation keeps the terms commuting with the Sz of each species, z being the
+/// quantization axis; with a transverse field the truncated Hamiltonian (which also drops the
+/// Zeeman terms in EnsembleCCE) would be wrong, so the full one is used instead.
+    if( _is_secular && (_magB(0) != 0.0 || _magB(1) != 0.0) )
+    {
+        LOG(ERROR) << "my_rank = " << _my_rank << ": " << "CCE:secular needs the magnetic field along z, the full bath Hamiltonian is used";
+        _is_secular = false;
+    }
+}
+
 void CCE::DataGathering(mat& resMat, int cce_order, int clst_num)
 {/*{{{*/
 
@@ -293,9 +323,28 @@ void EnsembleCCE::set_parameters()
     _pulse_name            = _cfg.getStringParameter("Condition",  "pulse_name");
     _pulse_num             = _cfg.getIntParameter   ("Condition",  "pulse_number");
 
+    // optional: 1 to keep only the secular (Sz of each species conserving) part of the bath Hamiltonian,
+    // valid when the magnetic field along z is strong; ignored when the field has an x or y component
+    PARA_MAP para = _cfg.getParameters();
+    _is_secular = para.count( make_pair(string("CCE"), string("secular")) ) ?
+                  _cfg.getIntParameter("CCE", "secular") != 0 : false;
+
+    // optional: the number of random-phase vectors for the clusters of TYPICALITY_MIN_SPIN spins or more,
+    // 0 (or absent) for the exact trace
+    _typicality_sample_num = para.count( make_pair(string("CCE"), string("typicality_sample_number")) ) ?
+                             _cfg.getIntParameter("CCE", "typicality_sample_number") : 0;
+
+    // optional: 1 to propagate the typicality samples in single precision; a cluster whose residual
+    // check exceeds single_precision_tol (default 1e-5) is rerun in double
+    _is_single_precision = para.count( make_pair(string("CCE"), string("single_precision")) ) ?
+                           _cfg.getIntParameter("CCE", "single_precision") != 0 : false;
+    _single_precision_tol = para.count( make_pair(string("CCE"), string("single_precision_tol")) ) ?
+                            _cfg.getDoubleParameter("CCE", "single_precision_tol") : 1e-5;
+
     _magB << _cfg.getDoubleParameter("Condition",  "magnetic_fieldX")
            << _cfg.getDoubleParameter("Condition",  "magnetic_fieldY")
            << _cfg.getDoubleParameter("Condition",  "magnetic_fieldZ");
+    check_secular_field();
 
     _bath_spin_filename = INPUT_PATH + input_filename;
     _result_filename    = OUTPUT_PATH + output_filename;
@@ -315,6 +364,21 @@ vec EnsembleCCE::cluster_evolution(int cce_order, int index)
     
     Hamiltonian hami0 = create_spin_hamiltonian(_center_spin, _state_pair.first, spin_list);
     Hamiltonian hami1 = create_spin_hamiltonian(_center_spin, _state_pair.second, spin_list);
+
+    // spin-1/2 pairs: closed form, with the same sequences as below
+    if( is_spin_half_pair(spin_list) )
+    {
+        vector<cx_mat> hm_list;
+        hm_list.push_back( hami0.getMatrix() );
+        hm_list.push_back( hami1.getMatrix() );
+        SpinPairCoherence pair(hm_list);
+        vector<int> left_index = riffle(0, 1, _pulse_num);
+        vector<int> right_index = _pulse_num % 2 == 0 ? riffle(1, 0, _pulse_num) : riffle(0, 1, _pulse_num);
+        cx_mat rho = norm(_bath_polarization) == 0.0 ? cx_mat( eye<cx_mat>(4, 4)/4.0 ) : create_spin_density_state(spin_list).getMatrix();
+        return pair.getTraceList(left_index, right_index, Pulse_Interval(_pulse_name, _pulse_num), _time_list, rho);
+    }
+
+    hami0.compile(); hami1.compile();
     
     vector<QuantumOperator> left_hm_list = riffle((QuantumOperator) hami0, (QuantumOperator) hami1, _pulse_num);
     vector<QuantumOperator> right_hm_list;
@@ -325,28 +389,113 @@ vec EnsembleCCE::cluster_evolution(int cce_order, int index)
 
     vector<double> time_segment = Pulse_Interval(_pulse_name, _pulse_num);
 
-    DensityOperator ds = create_spin_density_state(spin_list);
+    // only Re tr(L rho R) is needed: rho(t) itself is never formed
+    bool is_identity = norm(_bath_polarization) == 0.0;
+    if( _typicality_sample_num > 0 && spin_list.size() >= TYPICALITY_MIN_SPIN )
+    {
+        unsigned int seed = 1000003*cce_order + index;
+        PiecewiseTypicalityEvolution* kernel;
+        if( is_identity )
+            kernel = new PiecewiseTypicalityEvolution(left_hm_list, right_hm_list, time_segment, left_hm_list[0].getDimension(), _typicality_sample_num, seed);
+        else
+            kernel = new PiecewiseTypicalityEvolution(left_hm_list, right_hm_list, time_segment, create_spin_density_state(spin_list), _typicality_sample_num, seed);
+        kernel->setTimeSequence( _t0, _t1, _nTime);
+        kernel->setSinglePrecision(_is_single_precision, _single_precision_tol);
+        kernel->setSubspaceMode(_is_secular);
+
+        ClusterCoherenceEvolution dynamics(kernel);
+        dynamics.run();
+
+        vec res = kernel->getTraceList();
+        LOG(DEBUG) << "my_rank = " << _my_rank << ": " << "cluster " << index << " typicality error = " << max( kernel->getErrorList() );
+        if( kernel->isRerunInDouble() )
+            LOG(INFO) << "my_rank = " << _my_rank << ": " << "cluster " << index << " rerun in double precision";
+        delete kernel;
+        return res;
+    }
 
-    PiecewiseFullMatrixMatrixEvolution kernel(left_hm_list, right_hm_list, time_segment, ds);
-    kernel.setTimeSequence( _t0, _t1, _nTime);
+    PiecewiseTraceEvolution* kernel;
+    if( is_identity )
+        kernel = new PiecewiseTraceEvolution(left_hm_list, right_hm_list, time_segment, left_hm_list[0].getDimension());
+    else
+    {
+        DensityOperator ds = create_spin_density_state(spin_list);
+        kernel = new PiecewiseTraceEvolution(left_hm_list, right_hm_list, time_segment, ds);
+    }
+    kernel->setTimeSequence( _t0, _t1, _nTime);
+    kernel->setSubspaceMode(_is_secular);
 
-    ClusterCoherenceEvolution dynamics(&kernel);
+    ClusterCoherenceEvolution dynamics(kernel);
     dynamics.run();
     
-    return calc_observables(&kernel);
+    vec res = kernel->getTraceList();
+    delete kernel;
+    return res;
 }
 
+mat EnsembleCCE::cluster_evolution_batch(int cce_order, const vector<int>& index_list)
+{/*{{{*/
+/// The small clusters (up to CLUSTER_BATCH_MAX_DIM) are grouped by dimension and traced
+/// together by BatchPiecewiseCoherence::runTrace; the larger ones, and the spin-1/2 pairs which
+/// have a closed form, go through cluster_evolution.
+    mat res(_nTime, index_list.size());
+    vector<int> left_index = riffle(0, 1, _pulse_num);
+    vector<int> right_index = _pulse_num % 2 == 0 ? riffle(1, 0, _pulse_num) : riffle(0, 1, _pulse_num);
+    vector<double> time_segment = Pulse_Interval(_pulse_name, _pulse_num);
+
+    vector<cx_mat> hm0_list(index_list.size()), hm1_list(index_list.size()), rho_list(index_list.size());
+    map<int, vector<int> > dim_group;
+    for(int i = 0; i < index_list.size(); ++i)
+    {
+        vector<cSPIN> spin_list = _my_clusters.getCluster(cce_order, index_list[i]);
+        int dim = 1;
+        for(int k = 0; k < spin_list.size(); ++k)
+            dim *= spin_list[k].get_dimension();
+        if(dim > CLUSTER_BATCH_MAX_DIM || is_spin_half_pair(spin_list))
+        {
+            res.col(i) = cluster_evolution(cce_order, index_list[i]);
+            continue;
+        }
+        hm0_list[i] = create_spin_hamiltonian(_center_spin, _state_pair.first, spin_list).getMatrix();
+        hm1_list[i] = create_spin_hamiltonian(_center_spin, _state_pair.second, spin_list).getMatrix();
+        rho_list[i] = norm(_bath_polarization) == 0.0 ? cx_mat( eye<cx_mat>(dim, dim)/(double) dim ) : create_spin_density_state(spin_list).getMatrix();
+        dim_group[dim].push_back(i);
+    }
+
+    for(map<int, vector<int> >::iterator it = dim_group.begin(); it != dim_group.end(); ++it)
+    {
+        const vector<int>& pos = it->second;
+        BatchPiecewiseCoherence batch(it->first, pos.size(), 2);
+        for(int b = 0; b < pos.size(); ++b)
+        {
+            batch.setOperator(b, 0, hm0_list[ pos[b] ]);
+            batch.setOperator(b, 1, hm1_list[ pos[b] ]);
+            batch.setDensity(b, rho_list[ pos[b] ]);
+        }
+        mat batch_res = batch.runTrace(left_index, right_index, time_segment, _time_list);
+        for(int b = 0; b < pos.size(); ++b)
+            res.col( pos[b] ) = batch_res.col(b);
+    }
+    return res;
+}/*}}}*/
+
 Hamiltonian EnsembleCCE::create_spin_hamiltonian(const cSPIN& espin, const PureState& center_spin_state, const vector<cSPIN>& spin_list)
 {
-    SpinDipolarInteraction dip(spin_list);
+    SpinDipolarInteraction dip(spin_list, _is_secular);
 
     SpinZeemanInteraction zee(spin_list, _magB);
 
     DipolarField hf_field(spin_list, espin, center_spin_state);
 
+    if(_is_secular)
+        hf_field.make_secular();
+
     Hamiltonian hami(spin_list);
     hami.addInteraction(dip);
-    hami.addInteraction(zee);
+    // the secular Zeeman terms commute with the rest and are the same in hami0 and hami1,
+    // so they cancel in tr(rho R L) and are left out
+    if(!_is_secular)
+        hami.addInteraction(zee);
     hami.addInteraction(hf_field);
     hami.make();
     return hami;
@@ -371,14 +520,6 @@ DensityOperator EnsembleCCE::create_spin_density_state(const vector<cSPIN>& spin
     return ds;
 }
 
-vec EnsembleCCE::calc_observables(QuantumEvolutionAlgorithm* kernel)
-{
-    vector<cx_mat>  state = kernel->getResultMat();
-    vec res = ones<vec>(_nTime);
-    for(int i=0; i<_nTime; ++i)
-        res(i) = real( trace(state[i]) );
-    return res;
-}
 //}}}
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -405,9 +546,16 @@ void SingleSampleCCE::set_parameters()
     _pulse_name            = _cfg.getStringParameter("Condition",  "pulse_name");
     _pulse_num             = _cfg.getIntParameter   ("Condition",  "pulse_number");
 
+    // optional: 1 to keep only the secular (Sz of each species conserving) part of the bath Hamiltonian,
+    // valid when the magnetic field along z is strong; ignored when the field has an x or y component
+    PARA_MAP para = _cfg.getParameters();
+    _is_secular = para.count( make_pair(string("CCE"), string("secular")) ) ?
+                  _cfg.getIntParameter("CCE", "secular") != 0 : false;
+
     _magB << _cfg.getDoubleParameter("Condition",  "magnetic_fieldX")
            << _cfg.getDoubleParameter("Condition",  "magnetic_fieldY")
            << _cfg.getDoubleParameter("Condition",  "magnetic_fieldZ");
+    check_secular_field();
 
     _bath_spin_filename = INPUT_PATH + input_filename;
     _result_filename    = OUTPUT_PATH + output_filename;
@@ -417,13 +565,15 @@ void SingleSampleCCE::set_parameters()
 
 void SingleSampleCCE::prepare_bath_state()
 {/*{{{*/
-    vector<cSPIN> sl = _bath_spins.getSpinList();
+    const vector<cSPIN>& sl = _bath_spins.getSpinList();
     srand(_bath_state_seed);
+    _bath_spin_vectors = zeros<mat>(3, sl.size());
     for(int i=0; i<sl.size(); ++i)
     {
         PureState psi_i(sl[i]);
         psi_i.setComponent( rand()%2, 1.0);
         _bath_state_list.push_back(psi_i);
+        _bath_spin_vectors.col(i) = sl[i].get_spin_vector( psi_i.getVector() );
     }
 
     //cache_dipole_field();
@@ -437,38 +587,118 @@ vec SingleSampleCCE::cluster_evolution(int cce_order, int index)
     Hamiltonian hami0 = create_spin_hamiltonian(_center_spin, _state_pair.first, spin_list, clstIndex);
     Hamiltonian hami1 = create_spin_hamiltonian(_center_spin, _state_pair.second, spin_list, clstIndex);
 
+    // spin-1/2 pairs: closed form; in the secular case the Zeeman frame common to both branches
+    // cancels in the overlap, so the Hamiltonians without the Zeeman terms are used as they are
+    if( is_spin_half_pair(spin_list) )
+    {
+        vector<cx_mat> hm_list;
+        hm_list.push_back( hami0.getMatrix() );
+        hm_list.push_back( hami1.getMatrix() );
+        SpinPairCoherence pair(hm_list);
+        return pair.getOverlapList(riffle(0, 1, _pulse_num), riffle(1, 0, _pulse_num),
+                Pulse_Interval(_pulse_name, _pulse_num), _time_list, create_cluster_state(clstIndex).getVector());
+    }
+
+    hami0.compile(); hami1.compile();
+
     vector<QuantumOperator> hm_list1 = riffle((QuantumOperator) hami0, (QuantumOperator) hami1, _pulse_num);
     vector<QuantumOperator> hm_list2 = riffle((QuantumOperator) hami1, (QuantumOperator) hami0, _pulse_num);
     vector<double> time_segment = Pulse_Interval(_pulse_name, _pulse_num);
 
     PureState psi = create_cluster_state(clstIndex);
 
-    PiecewiseFullMatrixVectorEvolution kernel1(hm_list1, time_segment, psi);
-    PiecewiseFullMatrixVectorEvolution kernel2(hm_list2, time_segment, psi);
+    PiecewiseEigenVectorEvolution kernel1(hm_list1, time_segment, psi);
+    PiecewiseEigenVectorEvolution kernel2(hm_list2, time_segment, psi);
     kernel1.setTimeSequence( _t0, _t1, _nTime);
     kernel2.setTimeSequence( _t0, _t1, _nTime);
+    // in the secular case the Hamiltonians come without the Zeeman terms: their frame is common
+    // to both branches and cancels in the overlap
+    kernel1.setSubspaceMode(_is_secular);
+    kernel2.setSubspaceMode(_is_secular);
 
     ClusterCoherenceEvolution dynamics1(&kernel1);
-    ClusterCoherenceEvolution dynamics2(&kernel2);
     dynamics1.run();
+
+    // the states of kernel2 are reduced against those of kernel1 as they are produced
+    vector<cx_vec> state1 = kernel1.getResult();
+    OverlapObserver obs(state1);
+    kernel2.setObserver(&obs);
+    ClusterCoherenceEvolution dynamics2(&kernel2);
     dynamics2.run();
 
-    return calc_observables(&kernel1, &kernel2);
+    return obs.getResult();
+}/*}}}*/
+
+mat SingleSampleCCE::cluster_evolution_batch(int cce_order, const vector<int>& index_list)
+{/*{{{*/
+/// The small clusters (up to CLUSTER_BATCH_MAX_DIM) are grouped by dimension and evolved
+/// together by BatchPiecewiseCoherence; the larger ones, and the spin-1/2 pairs which have
+/// a closed form, go through cluster_evolution.
+    mat res(_nTime, index_list.size());
+    vector<int> op_index1 = riffle(0, 1, _pulse_num);
+    vector<int> op_index2 = riffle(1, 0, _pulse_num);
+    vector<double> time_segment = Pulse_Interval(_pulse_name, _pulse_num);
+
+    vector<cx_mat> hm0_list(index_list.size()), hm1_list(index_list.size());
+    vector<cx_vec> psi_list(index_list.size());
+    map<int, vector<int> > dim_group;
+    for(int i = 0; i < index_list.size(); ++i)
+    {
+        cClusterIndex clstIndex = _my_clusters.getClusterIndex(cce_order, index_list[i]);
+        vector<cSPIN> spin_list = _my_clusters.getCluster(cce_order, index_list[i]);
+        int dim = 1;
+        for(int k = 0; k < spin_list.size(); ++k)
+            dim *= spin_list[k].get_dimension();
+        if(dim > CLUSTER_BATCH_MAX_DIM || is_spin_half_pair(spin_list))
+        {
+            res.col(i) = cluster_evolution(cce_order, index_list[i]);
+            continue;
+        }
+        hm0_list[i] = create_spin_hamiltonian(_center_spin, _state_pair.first, spin_list, clstIndex).getMatrix();
+        hm1_list[i] = create_spin_hamiltonian(_center_spin, _state_pair.second, spin_list, clstIndex).getMatrix();
+        psi_list[i] = create_cluster_state(clstIndex).getVector();
+        dim_group[dim].push_back(i);
+    }
+
+    for(map<int, vector<int> >::iterator it = dim_group.begin(); it != dim_group.end(); ++it)
+    {
+        const vector<int>& pos = it->second;
+        BatchPiecewiseCoherence batch(it->first, pos.size(), 2);
+        for(int b = 0; b < pos.size(); ++b)
+        {
+            batch.setOperator(b, 0, hm0_list[ pos[b] ]);
+            batch.setOperator(b, 1, hm1_list[ pos[b] ]);
+            batch.setState(b, psi_list[ pos[b] ]);
+        }
+        mat batch_res = batch.run(op_index1, op_index2, time_segment, _time_list);
+        for(int b = 0; b < pos.size(); ++b)
+            res.col( pos[b] ) = batch_res.col(b);
+    }
+    return res;
 }/*}}}*/
 
 Hamiltonian SingleSampleCCE::create_spin_hamiltonian(const cSPIN& espin, const PureState& center_spin_state, const vector<cSPIN>& spin_list, const cClusterIndex& clstIndex )
 {/*{{{*/
-    SpinDipolarInteraction dip(spin_list);
+    SpinDipolarInteraction dip(spin_list, _is_secular);
 
     SpinZeemanInteraction zee(spin_list, _magB);
 
     DipolarField hf_field(spin_list, espin, center_spin_state);
 
-    DipolarField bath_field(spin_list, _bath_spins.getSpinList(), _bath_state_list, clstIndex.getIndex() );
+    DipolarField bath_field(spin_list, _bath_spins.getSpinStore(), clstIndex.getIndex(), _bath_spin_vectors);
+
+    if(_is_secular)
+    {
+        hf_field.make_secular();
+        bath_field.make_secular();
+    }
 
     Hamiltonian hami(spin_list);
     hami.addInteraction(dip);
-    hami.addInteraction(zee);
+    // the secular Zeeman terms commute with the rest: they are left out here and
+    // the kernels work in their interaction picture (see cluster_evolution)
+    if(!_is_secular)
+        hami.addInteraction(zee);
     hami.addInteraction(hf_field);
     hami.addInteraction(bath_field);
     hami.make();
@@ -509,14 +739,5 @@ void SingleSampleCCE::cache_dipole_field()
     }
 }/*}}}*/
 
-vec SingleSampleCCE::calc_observables(QuantumEvolutionAlgorithm* kernel1, QuantumEvolutionAlgorithm* kernel2)
-{/*{{{*/
-    vector<cx_vec>  state1 = kernel1->getResult();
-    vector<cx_vec>  state2 = kernel2->getResult();
-    cx_vec res = ones<cx_vec>(_nTime);
-    for(int i=0; i<_nTime; ++i)
-        res(i) =  cdot(state1[i], state2[i]);
-    return real(res);
-}/*}}}*/
 //}}}
 ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,396 @@
+#include <assert.h>
+#include <algorithm>
+#include "include/kron/KronApply.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ Mode kernels
+template<class T>
+static void kron_mode_dispatch(size_t m, size_t s, size_t n, const T* Ar, const T* Ai,
+                               const complex<T>* x, complex<T>* y, T alpha, bool accumulate)
+{
+    const T* xd = reinterpret_cast<const T*>(x);
+    T*       yd = reinterpret_cast<T*>(y);
+    switch (s) {
+        case 2:
+            kron_mode_kernel<2>(m, s, n, Ar, Ai, xd, yd, alpha, accumulate);
+            break;
+        case 3:
+            kron_mode_kernel<3>(m, s, n, Ar, Ai, xd, yd, alpha, accumulate);
+            break;
+        case 4:
+            kron_mode_kernel<4>(m, s, n, Ar, Ai, xd, yd, alpha, accumulate);
+            break;
+        case 9:
+            kron_mode_kernel<9>(m, s, n, Ar, Ai, xd, yd, alpha, accumulate);
+            break;
+        default:
+            kron_mode_kernel<0>(m, s, n, Ar, Ai, xd, yd, alpha, accumulate);
+    }
+}
+
+void kron_mode_apply(size_t m, size_t s, size_t n, const double* Ar, const double* Ai,
+                     const cx_double* x, cx_double* y, double alpha, bool accumulate)
+{
+    kron_mode_dispatch(m, s, n, Ar, Ai, x, y, alpha, accumulate);
+}
+
+void kron_mode_apply(size_t m, size_t s, size_t n, const float* Ar, const float* Ai,
+                     const cx_float* x, cx_float* y, float alpha, bool accumulate)
+{
+    kron_mode_dispatch(m, s, n, Ar, Ai, x, y, alpha, accumulate);
+}
+
+void kron_gate_apply(size_t m, size_t s1, size_t mid, size_t s2, size_t n, const cx_double* G, cx_double* x)
+{
+/// The s1*s2 amplitudes of each (a, b, c) are gathered with the strides mid*s2*n and n,
+/// multiplied by G, and scattered back.
+    const size_t g  = s1*s2;
+    const size_t ps = mid*s2*n;
+    const long nwork = m*mid*n;
+    assert(g <= KRON_GATE_MAX_DIM);
+
+    #pragma omp parallel for schedule(static) if(nwork > 1 && nwork*g > 4096)
+    for(long w=0; w<nwork; ++w)
+    {
+        const size_t c = w % n;
+        const size_t b = (w / n) % mid;
+        const size_t a = w / (n*mid);
+        cx_double* xw = x + ((a*s1*mid + b)*s2)*n + c;
+        cx_double v[KRON_GATE_MAX_DIM];
+        for(size_t p=0; p<s1; ++p)
+            for(size_t q=0; q<s2; ++q)
+                v[p*s2+q] = xw[p*ps + q*n];
+        for(size_t p=0; p<s1; ++p)
+            for(size_t q=0; q<s2; ++q)
+            {
+                const size_t r = p*s2+q;
+                cx_double sum = 0.0;
+                for(size_t u=0; u<g; ++u)
+                    sum += G[r + g*u]*v[u];
+                xw[p*ps + q*n] = sum;
+            }
+    }
+}
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ KronApply
+KronApply::KronApply()
+{ //LOG(INFO) << "Default constructor: KronApply";
+    _is_own_plan = true; _plan = NULL;
+}
+
+KronApply::KronApply(const SumKronProd& skp)
+{
+    _is_own_plan = true; _plan = NULL;
+    _own_plan = KronOperatorPlan(skp);
+}
+
+KronApply::KronApply(const KronOperatorPlan& plan)
+{
+    _is_own_plan = false; _plan = &plan;
+}
+
+KronApply::~KronApply()
+{ //LOG(INFO) << "Default destructor: KronApply";
+}
+
+void KronApply::apply_block(const cx_double* X, cx_double* Y, size_t nb) const
+{
+    const KronOperatorPlan& plan = getPlan();
+    const double* mat_re = plan.getMatRe().empty() ? NULL : &plan.getMatRe()[0];
+    const double* mat_im = plan.getMatIm().empty() ? NULL : &plan.getMatIm()[0];
+    apply_terms(X, Y, nb, mat_re, mat_im, _buf1, _buf2);
+}
+
+void KronApply::apply_block(const cx_float* X, cx_float* Y, size_t nb) const
+{
+    const KronOperatorPlan& plan = getPlan();
+    const float* mat_re = plan.getMatReF().empty() ? NULL : &plan.getMatReF()[0];
+    const float* mat_im = plan.getMatImF().empty() ? NULL : &plan.getMatImF()[0];
+    apply_terms(X, Y, nb, mat_re, mat_im, _fbuf1, _fbuf2);
+}
+
+template<class T>
+void KronApply::apply_terms(const complex<T>* x, complex<T>* y, size_t nb,
+        const T* mat_re, const T* mat_im, Col< complex<T> >& buf1, Col< complex<T> >& buf2) const
+{
+/// Each term c * A_1 (x) A_2 (x) ... is applied factor by factor,
+/// ping-ponging between two buffers; the last factor is accumulated into y.
+    const KronOperatorPlan& plan = getPlan();
+    const size_t len = plan.getDim()*nb;
+    const vector<double>& coeff      = plan.getCoeffList();
+    const vector<size_t>& pos_offset = plan.getPosOffset();
+    const vector<size_t>& pos_list   = plan.getPosList();
+    const vector<size_t>& dim_list   = plan.getFactorDimList();
+    const vector<size_t>& mat_offset = plan.getMatOffset();
+    const vector<size_t>& nspin_m    = plan.getStrideM();
+    const vector<size_t>& nspin_n    = plan.getStrideN();
+
+    if(buf1.n_elem < len)
+    {
+        buf1.set_size(len);
+        buf2.set_size(len);
+    }
+    for(size_t j=0; j<len; ++j) y[j] = 0.0;
+
+    for(int t=0; t<plan.getTermNum(); ++t)
+    {
+        size_t f0 = pos_offset[t], f1 = pos_offset[t+1];
+        const T c = coeff[t];
+        if(f0 == f1)
+        {
+            for(size_t j=0; j<len; ++j) y[j] += c*x[j];
+            continue;
+        }
+
+        const complex<T>* src = x;
+        complex<T>* bufs[2] = {buf1.memptr(), buf2.memptr()};
+        int b = 0;
+        for(size_t f=f0; f<f1; ++f)
+        {
+            size_t k = pos_list[f];
+            const T* Ar = mat_re + mat_offset[f];
+            const T* Ai = mat_im + mat_offset[f];
+            if(f == f1-1)
+                kron_mode_apply(nspin_m[k], dim_list[f], nspin_n[k]*nb, Ar, Ai, src, y, c, true);
+            else
+            {
+                kron_mode_apply(nspin_m[k], dim_list[f], nspin_n[k]*nb, Ar, Ai, src, bufs[b], (T)1.0, false);
+                src = bufs[b]; b = 1-b;
+            }
+        }
+    }
+}
+
+cx_vec KronApply::operator * (const cx_vec& x) const
+{
+    cx_vec y( getDim() );
+    apply(x.memptr(), y.memptr());
+    return y;
+}
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ KronSingleSpinExp
+KronSingleSpinExp::KronSingleSpinExp()
+{ //LOG(INFO) << "Default constructor: KronSingleSpinExp";
+    _nDim = 0; _shift = 0.0;
+}
+
+KronSingleSpinExp::KronSingleSpinExp(const KronOperatorPlan& plan)
+{
+    const vector<double>& coeff      = plan.getCoeffList();
+    const vector<size_t>& pos_offset = plan.getPosOffset();
+    const vector<size_t>& pos_list   = plan.getPosList();
+    const vector<size_t>& mat_offset = plan.getMatOffset();
+    const vector<cx_double>& matC    = plan.getMatC();
+    const vector<size_t>& spin_dim   = plan.getSpinDimList();
+
+    _nDim = plan.getDim(); _shift = 0.0;
+    vector<cx_mat> h_list(spin_dim.size());
+    for(int t=0; t<plan.getTermNum(); ++t)
+    {
+        size_t f = pos_offset[t];
+        if(pos_offset[t+1] == f)
+        {
+            _shift += coeff[t];
+            continue;
+        }
+        assert(pos_offset[t+1] == f+1); // only single-spin terms have a factorized exponential
+        size_t k = pos_list[f], s = spin_dim[k];
+        if(h_list[k].is_empty())
+            h_list[k] = zeros<cx_mat>(s, s);
+        for(size_t q=0; q<s*s; ++q)
+            h_list[k](q) += coeff[t]*matC[ mat_offset[f]+q ];
+    }
+
+    for(size_t k=0; k<spin_dim.size(); ++k)
+        if(!h_list[k].is_empty())
+        {
+            vec E; cx_mat V;
+            eig_sym(E, V, h_list[k]);
+            _spin_dim.push_back( spin_dim[k] );
+            _stride_m.push_back( plan.getStrideM()[k] );
+            _stride_n.push_back( plan.getStrideN()[k] );
+            _eigval_list.push_back(E);
+            _eigvec_list.push_back(V);
+        }
+}
+
+KronSingleSpinExp::~KronSingleSpinExp()
+{ //LOG(INFO) << "Default destructor: KronSingleSpinExp";
+}
+
+void KronSingleSpinExp::apply_block(double t, const cx_double* X, cx_double* Y, size_t nb) const
+{
+    const size_t len = _nDim*nb;
+    const cx_double phase = exp( cx_double(0.0, -t*_shift) );
+    if(_spin_dim.empty())
+    {
+        for(size_t j=0; j<len; ++j) Y[j] = phase*X[j];
+        return;
+    }
+    if(_buf1.n_elem < len)
+    {
+        _buf1.set_size(len);
+        _buf2.set_size(len);
+    }
+
+    const cx_double* src = X;
+    cx_double* bufs[2] = {_buf1.memptr(), _buf2.memptr()};
+    int b = 0;
+    for(size_t f=0; f<_spin_dim.size(); ++f)
+    {
+        const cx_mat& V = _eigvec_list[f];
+        cx_mat U = V * diagmat( exp( cx_double(0.0, -t)*conv_to<cx_vec>::from(_eigval_list[f]) ) ) * V.t();
+        mat Ar = real(U), Ai = imag(U);
+        bool is_last = f+1 == _spin_dim.size();
+        cx_double* dst = is_last ? Y : bufs[b];
+        kron_mode_apply(_stride_m[f], _spin_dim[f], _stride_n[f]*nb, Ar.memptr(), Ai.memptr(), src, dst, 1.0, false);
+        src = dst; b = 1-b;
+    }
+    for(size_t j=0; j<len; ++j) Y[j] *= phase;
+}
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ KronSubspaceApply
+static bool row_less(const pair<size_t, cx_double>& a, const pair<size_t, cx_double>& b)
+{
+    return a.first < b.first;
+}
+
+void kron_plan_column(const KronOperatorPlan& plan, size_t c, vector< pair<size_t, cx_double> >& col)
+{
+    const vector<double>&    coeff      = plan.getCoeffList();
+    const vector<size_t>&    pos_offset = plan.getPosOffset();
+    const vector<size_t>&    pos_list   = plan.getPosList();
+    const vector<size_t>&    mat_offset = plan.getMatOffset();
+    const vector<cx_double>& matC       = plan.getMatC();
+    const vector<size_t>&    spin_dim   = plan.getSpinDimList();
+    const vector<size_t>&    nspin_n    = plan.getStrideN();
+
+    col.clear();
+    vector< pair<size_t, cx_double> > entry, next;
+    for(size_t t=0; t<plan.getTermNum(); ++t)
+    {
+        entry.assign( 1, make_pair(c, cx_double(coeff[t], 0.0)) );
+        for(size_t f=pos_offset[t]; f<pos_offset[t+1] && !entry.empty(); ++f)
+        {
+            const size_t k = pos_list[f], s = spin_dim[k], n = nspin_n[k];
+            next.clear();
+            for(size_t e=0; e<entry.size(); ++e)
+            {
+                const size_t r = entry[e].first, j = (r / n) % s;
+                const cx_double* A = &matC[ mat_offset[f] + s*j ];
+                for(size_t i=0; i<s; ++i)
+                    if(A[i] != 0.0)
+                        next.push_back( make_pair(r - j*n + i*n, entry[e].second*A[i]) );
+            }
+            entry.swap(next);
+        }
+        col.insert(col.end(), entry.begin(), entry.end());
+    }
+
+    stable_sort(col.begin(), col.end(), row_less);
+    size_t nnz = 0;
+    for(size_t e=0; e<col.size(); )
+    {
+        size_t r = col[e].first;
+        cx_double v = 0.0;
+        for(; e<col.size() && col[e].first == r; ++e) v += col[e].second;
+        if(v != 0.0) col[nnz++] = make_pair(r, v);
+    }
+    col.resize(nnz);
+}
+
+KronSubspaceApply::KronSubspaceApply()
+{
+    _nDim = 0; _is_invariant = true;
+}
+
+KronSubspaceApply::KronSubspaceApply(const KronOperatorPlan& plan, const uvec& sub)
+{
+/// The elements are collected column by column and then placed row by row.
+    _nDim = sub.n_elem;
+    _is_invariant = true;
+    vector<long> loc(plan.getDim(), -1);
+    for(size_t q=0; q<_nDim; ++q) loc[ sub(q) ] = q;
+
+    vector<size_t>    row_list, col_list;
+    vector<cx_double> val_list;
+    vector< pair<size_t, cx_double> > col;
+    _row_ptr.assign(_nDim+1, 0);
+    for(size_t q=0; q<_nDim; ++q)
+    {
+        kron_plan_column(plan, sub(q), col);
+        for(size_t e=0; e<col.size(); ++e)
+        {
+            long r = loc[ col[e].first ];
+            if(r < 0)
+            {
+                _is_invariant = false;
+                continue;
+            }
+            row_list.push_back(r); col_list.push_back(q); val_list.push_back(col[e].second);
+            _row_ptr[r+1]++;
+        }
+    }
+    for(size_t r=0; r<_nDim; ++r)
+        _row_ptr[r+1] += _row_ptr[r];
+
+    _col_idx.resize( val_list.size() );
+    _val.resize( val_list.size() );
+    _val_f.resize( val_list.size() );
+    vector<size_t> pos(_row_ptr.begin(), _row_ptr.end()-1);
+    for(size_t e=0; e<val_list.size(); ++e)
+    {
+        size_t p = pos[ row_list[e] ]++;
+        _col_idx[p] = col_list[e];
+        _val[p]     = val_list[e];
+        _val_f[p]   = cx_float(val_list[e]);
+    }
+}
+
+KronSubspaceApply::~KronSubspaceApply()
+{
+}
+
+void KronSubspaceApply::apply_block(const cx_double* X, cx_double* Y, size_t nb) const
+{
+    apply_rows(X, Y, nb, _val);
+}
+
+void KronSubspaceApply::apply_block(const cx_float* X, cx_float* Y, size_t nb) const
+{
+    apply_rows(X, Y, nb, _val_f);
+}
+
+template<class T>
+void KronSubspaceApply::apply_rows(const complex<T>* X, complex<T>* Y, size_t nb, const vector< complex<T> >& val) const
+{
+    #pragma omp parallel for schedule(static) if(_nDim*nb > 4096)
+    for(long r=0; r<(long)_nDim; ++r)
+    {
+        complex<T>* y = Y + r*nb;
+        for(size_t b=0; b<nb; ++b) y[b] = complex<T>(0);
+        for(size_t k=_row_ptr[r]; k<_row_ptr[r+1]; ++k)
+        {
+            const complex<T>  v = val[k];
+            const complex<T>* x = X + _col_idx[k]*nb;
+            for(size_t b=0; b<nb; ++b) y[b] += v*x[b];
+        }
+    }
+}
+//}}}
+////////////////////////////////////////////////////////////////////////////////
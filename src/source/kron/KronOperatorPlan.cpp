@@ -0,0 +1,163 @@
+#include "include/kron/KronOperatorPlan.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ KronOperatorPlan
+KronOperatorPlan::KronOperatorPlan()
+{ //LOG(INFO) << "Default constructor: KronOperatorPlan";
+    _nDim = 0; _nSpin = 0; _nTerm = 0; _total_nbody = 0; _total_dim = 0;
+    make_hash();
+}
+
+KronOperatorPlan::KronOperatorPlan(const SumKronProd& skp)
+{
+    const vector<KronProd>& kp_list = skp.getKronProdList();
+    const DIM_LIST& spin_dim = skp.getDimList();
+
+    _nTerm = kp_list.size();
+    _nSpin = spin_dim.size();
+    _nDim  = _nTerm > 0 ? skp.getDim() : 0;
+    _spin_dim.assign( spin_dim.begin(), spin_dim.end() );
+
+    _nspin_m_lst.assign(_nSpin, 1);
+    _nspin_n_lst.assign(_nSpin, 1);
+    for(int k=1; k<_nSpin; ++k)
+        _nspin_m_lst[k] = _nspin_m_lst[k-1]*_spin_dim[k-1];
+    for(int k=(int)_nSpin-2; k>=0; --k)
+        _nspin_n_lst[k] = _nspin_n_lst[k+1]*_spin_dim[k+1];
+
+    _coeff_list.reserve(_nTerm);
+    _nBody_list.reserve(_nTerm);
+    _pos_offset.reserve(_nTerm+1);
+    _pos_offset.push_back(0);
+    _mat_offset.push_back(0);
+    for(int t=0; t<_nTerm; ++t)
+    {
+        const INDICES& idx = kp_list[t].getIndices();
+        const TERM&    mat = kp_list[t].getTermMat();
+        _coeff_list.push_back( kp_list[t].getCoeff() );
+        _nBody_list.push_back( idx.size() );
+        for(int f=0; f<idx.size(); ++f)
+        {
+            _pos_list.push_back( idx[f] );
+            _dim_list.push_back( mat[f].n_cols );
+            for(int q=0; q<mat[f].n_elem; ++q)
+            {
+                _matC.push_back( mat[f](q) );
+                _mat_re.push_back( mat[f](q).real() );
+                _mat_im.push_back( mat[f](q).imag() );
+                _mat_re_f.push_back( (float) mat[f](q).real() );
+                _mat_im_f.push_back( (float) mat[f](q).imag() );
+            }
+            _mat_offset.push_back( _matC.size() );
+        }
+        _pos_offset.push_back( _pos_list.size() );
+    }
+    _total_nbody = _pos_list.size();
+    _total_dim   = _matC.size();
+    make_hash();
+}
+
+KronOperatorPlan::~KronOperatorPlan()
+{ //LOG(INFO) << "Default destructor: KronOperatorPlan";
+}
+
+void KronOperatorPlan::getSpectralBounds(double& emin, double& emax) const
+{
+/// An interval containing the spectrum of the operator, assumed Hermitian, from the terms only:
+/// the identity terms shift it exactly, and every other term c A_1 (x) A_2 ... widens it
+/// by at most |c| prod_f ||A_f||_2.
+    double shift = 0.0, radius = 0.0;
+    for(int t=0; t<_nTerm; ++t)
+    {
+        if(_pos_offset[t+1] == _pos_offset[t])
+        {
+            shift += _coeff_list[t];
+            continue;
+        }
+        double r = fabs(_coeff_list[t]);
+        for(size_t f=_pos_offset[t]; f<_pos_offset[t+1]; ++f)
+        {
+            cx_mat A(&_matC[ _mat_offset[f] ], _dim_list[f], _dim_list[f]);
+            r *= norm(A, 2);
+        }
+        radius += r;
+    }
+    emin = shift - radius;
+    emax = shift + radius;
+}
+
+template<class T> static void hash_combine(size_t& h, const vector<T>& v)
+{
+    const unsigned char* p = v.empty() ? NULL : reinterpret_cast<const unsigned char*>(&v[0]);
+    for(size_t i=0; i<v.size()*sizeof(T); ++i)
+    {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+}
+
+void KronOperatorPlan::make_hash()
+{
+/// FNV-1a over the spin dimensions, coefficients, positions and matrices.
+    _hash = 14695981039346656037ULL;
+    hash_combine(_hash, _spin_dim);
+    hash_combine(_hash, _coeff_list);
+    hash_combine(_hash, _pos_offset);
+    hash_combine(_hash, _pos_list);
+    hash_combine(_hash, _matC);
+}
+
+bool operator == (const KronOperatorPlan& plan1, const KronOperatorPlan& plan2)
+{
+    if(plan1._hash != plan2._hash) return false;
+    return plan1._spin_dim   == plan2._spin_dim
+        && plan1._coeff_list == plan2._coeff_list
+        && plan1._pos_offset == plan2._pos_offset
+        && plan1._pos_list   == plan2._pos_list
+        && plan1._mat_offset == plan2._mat_offset
+        && plan1._matC       == plan2._matC;
+}
+
+ostream&  operator << (ostream& outs, const KronOperatorPlan& plan)
+{
+    outs << "#1. nSpin = " << plan._nSpin << endl << endl;
+    outs << "#2. nTerm = " << plan._nTerm << endl << endl;
+    outs << "#3. coeff_list = " << endl;
+    for(int i=0; i<plan._nTerm;++i)
+        outs << plan._coeff_list[i] << "\t";
+    outs << endl << endl;
+    outs << "#4. nBody_list = " << endl;
+    for(int i=0; i<plan._nTerm;++i)
+        outs << plan._nBody_list[i] << "\t";
+    outs << endl << endl;
+    outs << "#5. pos_offset = " << endl;
+    for(int i=0; i<plan._nTerm+1;++i)
+        outs << plan._pos_offset[i] << "\t";
+    outs << endl << endl;
+    outs << "#6. pos_list = " << endl;
+    for(int i=0; i<plan._total_nbody; ++i)
+        outs << plan._pos_list[i] << "\t";
+    outs << endl << endl;
+    outs << "#7. dim_list = " << endl;
+    for(int i=0; i<plan._total_nbody; ++i)
+        outs << plan._dim_list[i] << "\t";
+    outs << endl << endl;
+    outs << "#8. mat_offset = " << endl;
+    for(int i=0; i<plan._total_nbody+1; ++i)
+        outs << plan._mat_offset[i] << "\t";
+    outs << endl << endl;
+    outs << "#9. matC = " << endl;
+    for(int i=0; i<plan._total_dim; ++i)
+        outs << plan._matC[i] << "\t";
+    outs << endl << endl;
+    outs << "#10. nDim = " << plan._nDim << endl << endl;
+    outs << "#11. sin_dim = " << endl;
+    for(int i=0; i<plan._nSpin; ++i)
+        outs << plan._spin_dim[i] << "\t";
+    outs << endl << endl;
+    outs << "#13. total_nbody = " << plan._total_nbody << endl << endl;
+    outs << "#14. total_dim = " << plan._total_dim << endl << endl;
+    return outs;
+}
+//}}}
+////////////////////////////////////////////////////////////////////////////////
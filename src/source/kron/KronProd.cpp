@@ -1,3 +1,4 @@
+#include <assert.h>
 #include <armadillo>
 #include "include/kron/KronProd.h"
 #include "include/easylogging++.h"
@@ -58,7 +59,7 @@ void KronProd::fill(INDICES idx, MULTIPLIER coeff, TERM mat)
     _mat        = mat;
 }
 
-cx_mat KronProd::full()
+cx_mat KronProd::full() const
 {
     vector<cx_mat> all_mat;
     for(int i=0; i<_dim_list.size(); ++i)
@@ -159,7 +160,7 @@ SumKronProd::SumKronProd(const vector<KronProd>& kp_lst)
 SumKronProd::~SumKronProd()
 { //LOG(INFO) << "Default destructor: SumKronProd.";
 }
-cx_mat SumKronProd::full()
+cx_mat SumKronProd::full() const
 {
     cx_mat res = _kron_prod_list[0].full();
     for(int i=1; i<_kron_prod_list.size(); ++i)
@@ -188,6 +189,57 @@ SumKronProd Expand(const SumKronProd& skp, MatExpanFunc* expan_func)
     return res;
 }
 
+SumKronProd LiouvilleExpand(const SumKronProd& skp, MatExpanFunc* expan_func)
+{
+/// vec(rho) of the product space is the Kronecker product of the local vec(rho_k),
+/// so its modes run (col_0, row_0, col_1, row_1, ...) and spin k owns the modes 2k and 2k+1.
+/// CIRCLEC is split as the commutator of the whole term, c A(x)B rho - c rho conj(A(x)B).
+    bool is_left  = expan_func == FLAT  || expan_func == CIRCLEC;
+    bool is_right = expan_func == SHARP || expan_func == CIRCLEC;
+    assert(is_left || is_right);
+
+    DIM_LIST new_dim;
+    for(int i=0; i<skp._dim_list.size(); ++i)
+    {
+        new_dim.push_back( skp._dim_list[i] );
+        new_dim.push_back( skp._dim_list[i] );
+    }
+
+    vector<KronProd> new_kp_list;
+    new_kp_list.reserve( (is_left && is_right ? 2 : 1)*skp._kron_prod_list.size() );
+    for(int i=0; i<skp._kron_prod_list.size(); ++i)
+    {
+        const KronProd& kp = skp._kron_prod_list[i];
+        const INDICES& idx = kp.getIndices();
+        const TERM&    mat = kp.getTermMat();
+        if(is_left)
+        {
+            INDICES new_idx;
+            for(int j=0; j<idx.size(); ++j)
+                new_idx.push_back( 2*idx[j]+1 );
+            KronProd res(new_dim);
+            res.fill(new_idx, kp.getCoeff(), mat);
+            new_kp_list.push_back(res);
+        }
+        if(is_right)
+        {
+            INDICES new_idx;
+            TERM new_mat;
+            for(int j=0; j<idx.size(); ++j)
+            {
+                new_idx.push_back( 2*idx[j] );
+                new_mat.push_back( expan_func == SHARP ? cx_mat(mat[j].st()) : cx_mat(conj(mat[j])) );
+            }
+            KronProd res(new_dim);
+            res.fill(new_idx, expan_func == SHARP ? kp.getCoeff() : -kp.getCoeff(), new_mat);
+            new_kp_list.push_back(res);
+        }
+    }
+
+    SumKronProd res(new_kp_list);
+    return res;
+}
+
 vector<MULTIPLIER> SumKronProd::getCoeffList() const
 {
     vector<MULTIPLIER> res;
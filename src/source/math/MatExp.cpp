@@ -3,6 +3,7 @@
 #include "include/math/main_mkl.h" 
 #include "include/math/main_cache.h" 
 #include <complex>
+#include <cstring>
 
 ////////////////////////////////////////////////////////////////////////////////
 //{{{  MatExp
@@ -11,16 +12,46 @@ MatExp::MatExp(const cx_mat& m, cx_double prefactor, MatExpMethod method)
     _matrix = m;
     _prefactor = prefactor;
     _method = method;
+    _is_hermitian = false;
+    _norm1 = 0.0;
+    if(_method == ScalingSquaring)
+    {
+        _norm1 = norm(_matrix, 1);
+        _is_hermitian = norm(_matrix - _matrix.t(), 1) <= 1e-14*_norm1;
+    }
+}
+
+MatExp::MatExp(const cx_mat& m, MatExpMethod method)
+{
+/// The prefactor is given to run(prefactor, res).
+    _matrix = m;
+    _prefactor = 1.0;
+    _method = method;
+    _is_hermitian = false;
+    _norm1 = 0.0;
+    if(_method == ScalingSquaring)
+    {
+        _norm1 = norm(_matrix, 1);
+        _is_hermitian = norm(_matrix - _matrix.t(), 1) <= 1e-14*_norm1;
+    }
 }
 
 void MatExp::run()
+{
+    run(_resMatrix);
+}
+
+void MatExp::run(cx_mat& res)
 {
     switch (_method) {
         case ArmadilloExpMat:
-            _resMatrix = armadillo_exp_mat();
+            res = expmat(_prefactor*_matrix);
             break;
         case PadeApproximation:
-            _resMatrix = pade_exp_mat();
+            pade_exp_mat(res);
+            break;
+        case ScalingSquaring:
+            scaling_squaring_exp_mat(res);
             break;
         default:
             cout << "Exp method not sopport." << endl;
@@ -28,54 +59,181 @@ void MatExp::run()
     }
 }
 
-cx_mat MatExp::pade_exp_mat()
+void MatExp::pade_exp_mat(cx_mat& res)
 {
-    cx_mat res;
-    
     // computes exp(t*H), irreducible rational Pade approximation;
     int       ideg(6);// 
-    int       m(0);  // order of H;
+    int       m(_matrix.n_cols);  // order of H;
     double    t(1.0); // time-scale;
-    std::complex<double> *H(NULL);// matrix;
-    int       ldh(0);
-    std::complex<double> *wsp(NULL);
-    int       lwsp(0);
-    int       *ipiv(NULL);
+    int       ldh(m);
+    int       lwsp(4 * m * m + ideg + 1);
     int       iexph(0);
     int       ns(0);
     int       iflag(0);
     
-    res = _prefactor * _matrix;
-    m = res.n_cols;
-    H = res.memptr();
-    if (H == NULL)
-      return zeros<cx_mat>(m, m);
-    ldh = m;
-    lwsp = 4 * m * m + ideg + 1;
-    
-    wsp = new (std::nothrow) std::complex<double> [lwsp];
-    ipiv = new (std::nothrow) int [m];
-    if ((ipiv == NULL) || (wsp == NULL))
+    if (m == 0)
     {
-      delete []wsp;
-      delete []ipiv;
-      return zeros<cx_mat>(m, m);
+      res.reset();
+      return;
     }
+
+    WorkspaceArena& arena = WorkspaceArena::local();
+    std::complex<double> *H    = arena.getComplex(WorkspaceArena::PadeMatrix, m*m);
+    std::complex<double> *wsp  = arena.getComplex(WorkspaceArena::PadeWork, lwsp);
+    int                  *ipiv = arena.getInt(WorkspaceArena::PadeWork, m);
+
+    const std::complex<double> *A = _matrix.memptr();
+    for(int i=0; i<m*m; ++i)
+        H[i] = _prefactor * A[i];
     
     zgpadm_(&ideg, &m, &t, H, &ldh, wsp, &lwsp, ipiv, &iexph, &ns, &iflag);
     
+    res.set_size(m, m);
     if (iflag < 0)
     {
       std::cout << "problem in ZGPADM, iflag = " << iflag << std::endl;
-      delete []wsp;
-      delete []ipiv;
-      return zeros<cx_mat>(m, m);
+      res.zeros();
+      return;
     }
-    res = cx_mat( &wsp[iexph-1], m, m);// zero-based numbering;
-    
-    delete []wsp;
-    delete []ipiv;
-    return res;
+    memcpy(res.memptr(), &wsp[iexph-1], m*m*sizeof(std::complex<double>));// zero-based numbering;
+}
+
+const cx_mat& MatExp::power(int k)
+{
+/// H^k for k = 2, 4, 6, 8, computed once: H^2, H^4 = H^2 H^2, H^6 = H^4 H^2, H^8 = H^4 H^4.
+    int q = k/2 - 1;
+    while(_power_list.size() <= q)
+    {
+        int n = _power_list.size();
+        if(n == 0)      _power_list.push_back( _matrix*_matrix );
+        else if(n == 1) _power_list.push_back( _power_list[0]*_power_list[0] );
+        else if(n == 2) _power_list.push_back( _power_list[1]*_power_list[0] );
+        else            _power_list.push_back( _power_list[1]*_power_list[1] );
+    }
+    return _power_list[q];
+}
+
+int MatExp::ell(double scale, int m)
+{
+/// The extra squarings needed for the backward error of the degree m approximant of scale*H:
+/// ell = max(ceil(log2(alpha/u)/(2m)), 0), alpha = |c_{2m+1}| || |scale*H|^{2m+1} ||_1 / ||scale*H||_1.
+/// The norm of the power of |H| is exact: 1^T |H|^q, with q products of |H|^T and a vector.
+    const double log2_coeff[5] = {-16.62108, -33.22786, -51.99501, -72.32480, -116.44715};
+    const int    m_list[5]     = {3, 5, 7, 9, 13};
+    int idx = 0;
+    while(m_list[idx] != m) ++idx;
+
+    int q = 2*m+1;
+    if(_abs_power_norm.size() <= q)
+        _abs_power_norm.resize(q+1, datum::nan);
+    if(_abs_power_norm[q] != _abs_power_norm[q])
+    {
+        mat absH = abs(_matrix).t() / _norm1;
+        vec v = ones<vec>(_matrix.n_cols);
+        for(int k=0; k<q; ++k)
+            v = absH*v;
+        _abs_power_norm[q] = log2( max(v) );
+    }
+
+    double log2_alpha = log2_coeff[idx] + (q-1)*log2(scale*_norm1) + _abs_power_norm[q];
+    double u = 1.1102230246251565e-16;
+    int t = (int)ceil( (log2_alpha - log2(u)) / (2.0*m) );
+    return t > 0 ? t : 0;
+}
+
+void MatExp::scaling_squaring_exp_mat(cx_mat& res)
+{
+    const size_t n = _matrix.n_cols;
+    if(n == 0)
+    {
+        res.reset();
+        return;
+    }
+    if(_is_hermitian)
+    {
+        if(_eigval.is_empty())
+            eig_sym(_eigval, _eigvec, _matrix);
+        res = _eigvec * diagmat( exp( _prefactor*conv_to<cx_vec>::from(_eigval) ) ) * _eigvec.t();
+        return;
+    }
+
+    const double theta[5] = {1.495585217958292e-2, 2.539398330063230e-1, 9.504178996162932e-1, 2.097847961257068e0, 5.371920351148152e0};
+    const double b3[4]  = {120., 60., 12., 1.};
+    const double b5[6]  = {30240., 15120., 3360., 420., 30., 1.};
+    const double b7[8]  = {17297280., 8648640., 1995840., 277200., 25200., 1512., 56., 1.};
+    const double b9[10] = {17643225600., 8821612800., 2075673600., 302702400., 30270240., 2162160., 110880., 3960., 90., 1.};
+    const double b13[14]= {64764752532480000., 32382376266240000., 7771770303897600., 1187353796428800., 129060195264000., 
+                           10559470521600., 670442572800., 33522128640., 1323241920., 40840800., 960960., 16380., 182., 1.};
+
+    const double a = abs(_prefactor);
+    if(a*_norm1 == 0.0)
+    {
+        res = eye<cx_mat>(n, n);
+        return;
+    }
+    double d4 = a*pow( norm(power(4), 1), 1.0/4.0 );
+    double d6 = a*pow( norm(power(6), 1), 1.0/6.0 );
+    double eta1 = max(d4, d6);
+
+    int m = 13, s = 0;
+    const double* b = b13;
+    if(eta1 <= theta[0] && ell(a, 3) == 0)
+    {
+        m = 3; b = b3;
+    }
+    else if(eta1 <= theta[1] && ell(a, 5) == 0)
+    {
+        m = 5; b = b5;
+    }
+    else
+    {
+        double d8 = a*pow( norm(power(8), 1), 1.0/8.0 );
+        double eta3 = max(d6, d8);
+        if(eta3 <= theta[2] && ell(a, 7) == 0)
+        {
+            m = 7; b = b7;
+        }
+        else if(eta3 <= theta[3] && ell(a, 9) == 0)
+        {
+            m = 9; b = b9;
+        }
+        else
+        {
+            // d10 <= (||H^4|| ||H^6||)^{1/10}
+            double d10 = a*pow( norm(power(4), 1)*norm(power(6), 1), 1.0/10.0 );
+            double eta5 = min(eta3, max(d8, d10));
+            s = (int)ceil( log2(eta5/theta[4]) );
+            if(s < 0) s = 0;
+            s += ell(a/pow(2.0, s), 13);
+        }
+    }
+
+    // the approximant r_m(A) = (V-U)^{-1} (V+U) of A = prefactor*H/2^s, A^k = (prefactor/2^s)^k H^k
+    cx_double p = _prefactor/pow(2.0, s);
+    cx_double p2 = p*p, p4 = p2*p2, p6 = p4*p2, p8 = p4*p4;
+    cx_mat I = eye<cx_mat>(n, n);
+    cx_mat U, V;
+    if(m == 13)
+    {
+        cx_mat A2 = p2*power(2), A4 = p4*power(4), A6 = p6*power(6);
+        U = p*_matrix*( A6*(b[13]*A6 + b[11]*A4 + b[9]*A2) + b[7]*A6 + b[5]*A4 + b[3]*A2 + b[1]*I );
+        V = A6*(b[12]*A6 + b[10]*A4 + b[8]*A2) + b[6]*A6 + b[4]*A4 + b[2]*A2 + b[0]*I;
+    }
+    else
+    {
+        cx_mat Uodd = b[1]*I, Veven = b[0]*I;
+        for(int k=2; k<=m-1; k+=2)
+        {
+            cx_double pk = k == 2 ? p2 : (k == 4 ? p4 : (k == 6 ? p6 : p8));
+            Uodd  += (b[k+1]*pk)*power(k);
+            Veven += (b[k]*pk)*power(k);
+        }
+        U = p*_matrix*Uodd;
+        V = Veven;
+    }
+    res = solve(V - U, V + U);
+    for(int k=0; k<s; ++k)
+        res = res*res;
 }
 //}}}
 ////////////////////////////////////////////////////////////////////////////////
@@ -88,7 +246,7 @@ cx_mat MatExp::pade_exp_mat()
 MatExpVector::MatExpVector(const SumKronProd& skp, const cx_vec& v, const vec& time_list, MatExpVectorMethod method)
 {
     _method = method;
-    _skp = skp;
+    _plan = KronOperatorPlan(skp);
     _vector = v;
     //_prefactor = prefactor;
     _prefactor = cx_double(0.0, -1.0);
@@ -102,6 +260,9 @@ MatExpVector::MatExpVector(const SumKronProd& skp, const cx_vec& v, const vec& t
     _krylov_tol = 1e-12;
     _itrace = 0;
     _is_print_skp = false;
+    _is_hermitian = false;
+    _is_native = false;
+    _result = NULL;
 }
 MatExpVector::MatExpVector(const cx_mat& m, const cx_vec& v, const cx_double prefactor, const vec& time_list)
 {
@@ -119,6 +280,9 @@ MatExpVector::MatExpVector(const cx_mat& m, const cx_vec& v, const cx_double pre
     _krylov_tol = 1e-12;
     _itrace = 0;
     _is_print_skp = false;
+    _is_hermitian = false;
+    _is_native = false;
+    _result = NULL;
 }
 MatExpVector::MatExpVector(const sp_cx_mat& m, const cx_vec& v, const cx_double prefactor, const vec& time_list)
 {
@@ -136,50 +300,88 @@ MatExpVector::MatExpVector(const sp_cx_mat& m, const cx_vec& v, const cx_double
     _krylov_tol = 1e-12;
     _itrace = 0;
     _is_print_skp = false;
+    _is_hermitian = false;
+    _is_native = false;
+    _result = NULL;
 }
 
 cx_mat MatExpVector::run()
 {
-    cx_mat res;
+    _result = NULL;
+    run(_resVectorList);
+    return _resVectorList;
+}
+
+void MatExpVector::run(cx_mat& res)
+{
+    _result = &res;
     switch (_method) {
         case Explicit:
-            res = runExplicit();
+            runExplicit();
             break;
         case ExplicitSparse:
-            res = runExplicitSparse();
+            runExplicitSparse();
             break;
         case Inexplicit:
-            res = runInexplicit();
+            runInexplicit();
             break;
         case InexplicitGPU:
-            res = runInexplicitGPU();
+            runInexplicitGPU();
+            break;
+        case InexplicitNative:
+            runInexplicitNative();
+            break;
+        case InexplicitChebyshev:
+            runInexplicitChebyshev();
             break;
         default:
             cout << "Exp method not sopport." << endl;
             assert(0);
     }
-    return res;
+    _result = NULL;
 }
     
-cx_mat MatExpVector::runExplicit()
+template<class MatVec>
+const cx_mat& MatExpVector::run_native(const MatVec& op)
 {/*{{{*/
+    KrylovExpv<MatVec> expv(op, _dim, _prefactor);
+    expv.setKrylovDim(_krylov_m);
+    expv.setTolerance(_krylov_tol);
+    expv.setTrace(_itrace);
+    expv.setHermitian(_is_hermitian);
+    expv.setWorkspace( WorkspaceArena::local().getKrylovWorkspace() );
+
+    expv.run(_vector, _time_list, result());
+    _stats = expv.getStats();
+    return result();
+}/*}}}*/
+
+const cx_mat& MatExpVector::runExplicit()
+{/*{{{*/
+    // _matrix is stored with the prefactor, the native path needs the matrix itself.
+    if(_is_native || _is_hermitian)
+        return run_native( DenseMatVec(_matrix, 1.0/_prefactor) );
+
     std::complex<double> * mat = _matrix.memptr();
     std::complex<double> * vecC = _vector.memptr();
 
-    // krylov_zgexpv and krylov_zcooexpv;
-    std::complex<double> *w_seq = new std::complex<double> [_nTime * _dim];
+    // krylov_zgexpv and krylov_zcooexpv, writing directly into the result;
+    result().set_size(_dim, _nTime);
+    std::complex<double> *w_seq = result().memptr();
+    int lwsp = 0, liwsp = 0;
+    std::complex<double> *wsp = NULL; int *iwsp = NULL;
+    get_krylov_workspace(wsp, lwsp, iwsp, liwsp);
     
-    int err = krylov_zgexpv(_dim, (double _Complex *)mat, (double _Complex *)vecC, _nTime, &_time_list[0], (double _Complex *)w_seq, _klim, _krylov_m, _krylov_tol,  _itrace);
+    int err = krylov_zgexpv_wsp(_dim, (double _Complex *)mat, (double _Complex *)vecC, _nTime, &_time_list[0], (double _Complex *)w_seq, _klim, _krylov_m, _krylov_tol,  _itrace, (double _Complex *)wsp, lwsp, iwsp, liwsp);
 
-    cx_mat res(&w_seq[0], _dim, _nTime);
-    _resVectorList = res;
-
-    delete[] w_seq;
-    return _resVectorList;
+    return result();
 }/*}}}*/
 
-cx_mat MatExpVector::runExplicitSparse()
+const cx_mat& MatExpVector::runExplicitSparse()
 {/*{{{*/
+    if(_is_native || _is_hermitian)
+        return run_native( CSRMatVec(_sp_matrix, 1.0/_prefactor) );
+
     sp_cx_mat::const_iterator start = _sp_matrix.begin();
     sp_cx_mat::const_iterator end   = _sp_matrix.end();
 
@@ -187,9 +389,10 @@ cx_mat MatExpVector::runExplicitSparse()
 
     int nz = distance(start , end);
 
-    int * ia = new int [nz];
-    int * ja = new int [nz];
-    std::complex<double> * a = new std::complex<double> [nz];
+    WorkspaceArena& arena = WorkspaceArena::local();
+    int * ia = arena.getInt(WorkspaceArena::SparseRow, nz);
+    int * ja = arena.getInt(WorkspaceArena::SparseCol, nz);
+    std::complex<double> * a = arena.getComplex(WorkspaceArena::SparseValue, nz);
     //int i=0;
     for(sp_cx_mat::const_iterator it = start; it != end; ++it)
     {
@@ -200,137 +403,52 @@ cx_mat MatExpVector::runExplicitSparse()
         //i++;
     }
 
-    // krylov_zgexpv and krylov_zcooexpv;
-    std::complex<double> *w_seq = new std::complex<double> [_nTime * _dim];
+    // krylov_zgexpv and krylov_zcooexpv, writing directly into the result;
+    result().set_size(_dim, _nTime);
+    std::complex<double> *w_seq = result().memptr();
+    int lwsp = 0, liwsp = 0;
+    std::complex<double> *wsp = NULL; int *iwsp = NULL;
+    get_krylov_workspace(wsp, lwsp, iwsp, liwsp);
     
-    int err = krylov_zcooexpv(_dim, nz, ia, ja, (double _Complex *)a, (double _Complex *)vecC, _nTime, &_time_list[0], (double _Complex *)w_seq, _klim, _krylov_m, _krylov_tol, _itrace);
+    int err = krylov_zcooexpv_wsp(_dim, nz, ia, ja, (double _Complex *)a, (double _Complex *)vecC, _nTime, &_time_list[0], (double _Complex *)w_seq, _klim, _krylov_m, _krylov_tol, _itrace, (double _Complex *)wsp, lwsp, iwsp, liwsp);
 
-    cx_mat res(&w_seq[0], _dim, _nTime);
-    _resVectorList = res;
-
-    delete[] ia;
-    delete[] ja;
-    delete[] a;
-    delete[] w_seq;
-    return _resVectorList;
+    return result();
 }/*}}}*/
 
-cx_mat MatExpVector::runInexplicit()
+const cx_mat& MatExpVector::runInexplicit()
 {/*{{{*/
     //////////////////////////////////////////////////////////////////////////////
     //parameter preparation
-    DIM_LIST           spinDim = _skp.getDimList();
-    vector<MULTIPLIER> coeff = _skp.getCoeffList();
-    vector<size_t>     nBody = _skp.getMatNumList();
-    vector<INDICES>    indices_list = _skp.getIndicesList(); 
-    vector<TERM>       term_list = _skp.getTermList();
-    INDICES            full_indices = join_all(indices_list);
-    TERM               full_term = join_all(term_list);
-
-    vector<size_t> dim_vector;
-    for(size_t i=0; i<full_term.size(); ++i)
-        dim_vector.push_back( full_term[i].n_cols );
-
-    size_t nSpin = _skp.getKronNum();
-    size_t nTerm = _skp.getKronProdSize();
-    double * coeff_list = coeff.data();
-    size_t * nBody_list = nBody.data();
-    
-    size_t * pos_offset = new size_t [nTerm+1];
-    pos_offset[0]=0; partial_sum (nBody_list, nBody_list+nTerm, pos_offset+1);
-    size_t total_nbody = pos_offset[nTerm];
-
-    size_t * pos_list   = full_indices.data();
-    size_t * dim_list   =  dim_vector.data();
-    size_t * dim2 = new size_t [total_nbody];
-    for(int i=0; i<total_nbody; ++i)
-        dim2[i] = dim_list[i]*dim_list[i];
-    
-    size_t * mat_offset = new size_t [total_nbody+1];
-    mat_offset[0]=0; partial_sum(dim2, dim2+total_nbody, mat_offset+1);
-    size_t total_dim = mat_offset[total_nbody];
-
-    complex<double> * matC = new complex<double> [total_dim];
-    int count = 0;
-    for(int i=0; i<full_term.size();++i)
-        for(int j=0; j<dim2[i]; ++j)
-        {
-            matC[count] = full_term[i](j);
-            count ++;
-        }
-    size_t nDim = _skp.getDim();
-    size_t * spin_dim   = spinDim.data();
+    // the flattened operator is taken from the plan, which is compiled only once;
+    // main_mkl_ does not modify the arrays.
+    const KronOperatorPlan& plan = getPlan();
+    size_t nSpin       = plan.getSpinNum();
+    size_t nTerm       = plan.getTermNum();
+    size_t total_nbody = plan.getTotalBody();
+    size_t total_dim   = plan.getTotalMatSize();
+    size_t nDim        = plan.getDim();
+
+    double *          coeff_list = const_cast<double*>( plan.getCoeffList().data() );
+    size_t *          nBody_list = const_cast<size_t*>( plan.getBodyNumList().data() );
+    size_t *          pos_offset = const_cast<size_t*>( plan.getPosOffset().data() );
+    size_t *          pos_list   = const_cast<size_t*>( plan.getPosList().data() );
+    size_t *          dim_list   = const_cast<size_t*>( plan.getFactorDimList().data() );
+    size_t *          mat_offset = const_cast<size_t*>( plan.getMatOffset().data() );
+    complex<double> * matC       = const_cast<complex<double>*>( plan.getMatC().data() );
+    size_t *          spin_dim   = const_cast<size_t*>( plan.getSpinDimList().data() );
 
     complex<double> * vecC = _vector.memptr();
     
     size_t nt = _time_list.n_elem; 
     double * tlist =  _time_list.memptr();
 
-    complex<double> * w_seq;
+    result().set_size(nDim, nt);
+    complex<double> * w_seq = result().memptr();
     size_t w_seq_len= nDim * nt;
-    w_seq = new complex<double> [w_seq_len];
     //////////////////////////////////////////////////////////////////////////////
 
-    //////////////////////////////////////////////////////////////////////////////
-    // Print to screen
     if(_is_print_skp)
-    {/*{{{*/
-    cout << "#1. nSpin = " << nSpin << endl << endl;
-    cout << "#2. nTerm = " << nTerm << endl << endl;
-    cout << "#3. coeff_list = " << endl;
-    for(int i=0; i<nTerm;++i)
-        cout << coeff_list[i] << "\t";
-    cout << endl << endl;
-    cout << "#4. nBody_list = " << endl;
-    for(int i=0; i<nTerm;++i)
-        cout << nBody_list[i] << "\t";
-    cout << endl << endl;
-    cout << "#5. pos_offset = " << endl;
-    for(int i=0; i<nTerm+1;++i)
-        cout <<pos_offset[i] << "\t";
-    cout << endl << endl;
-
-    cout << "#6. pos_list = " << endl;
-    for(int i=0; i<total_nbody; ++i)
-        cout << pos_list[i] << "\t";
-    cout << endl << endl;
-    cout << "#7. dim_list = " << endl;
-    for(int i=0; i<total_nbody; ++i)
-        cout <<dim_list[i] << "\t";
-    cout << endl << endl;
-    cout << "#8. mat_offset = " << endl;
-    for(int i=0; i<total_nbody+1; ++i)
-        cout <<mat_offset[i] << "\t";
-    cout << endl << endl;
-
-    cout << "#9. matC = " << endl;
-    for(int i=0; i<total_dim; ++i)
-        cout << matC[i] << "\t";
-    cout << endl << endl;
-    cout << "#10. nDim = " << nDim << endl << endl;
-    cout << "#11. sin_dim = " << endl;
-    for(int i=0; i<nSpin; ++i)
-        cout << spin_dim[i] << "\t";
-    cout << endl << endl;
-    cout << "#12. vecC = " << endl;
-    for(int i=0; i<nDim; ++i) 
-        cout << vecC[i] << "\t";
-    cout << endl << endl;
-    cout << "#13. total_nbody = " << total_nbody << endl << endl;
-    cout << "#14. total_dim = " << total_dim << endl << endl;
-    cout << "#15. klim = " << _klim << endl << endl;
-    cout << "#16. nt = " << nt << endl << endl;
-    cout << "#17. tlist = " << endl;
-    for(int i=0; i<nt; ++i)
-        cout << tlist[i] << "\t";
-    cout << endl << endl;
-    cout << "#18. m= " << _krylov_m << endl << endl;
-    cout << "#19. tol = " << _krylov_tol << endl << endl;
-    cout << "#20. itrace = " << _itrace << endl << endl;
-    cout << "#21. w_seq = " << w_seq << endl << endl;
-    cout << "#22. w_seq_len = " << w_seq_len << endl << endl;
-
-    }/*}}}*/
+        print_parameters(w_seq, w_seq_len);
     
     main_mkl_(  &nSpin,
                 &nTerm, 
@@ -354,134 +472,44 @@ cx_mat MatExpVector::runInexplicit()
                 &_itrace,
                 w_seq,
                 &w_seq_len );
-    cx_mat res(w_seq, nDim, nt);
-    _resVectorList = res;
-
-    delete[] pos_offset;
-    delete[] dim2;
-    delete[] mat_offset;
-    delete[] matC;
-    delete[] w_seq;
 
-    return _resVectorList;
+    return result();
 }/*}}}*/
 
-cx_mat MatExpVector::runInexplicitGPU()
+const cx_mat& MatExpVector::runInexplicitGPU()
 {/*{{{*/
     //////////////////////////////////////////////////////////////////////////////
     //parameter preparation
-    DIM_LIST           spinDim = _skp.getDimList();
-    vector<MULTIPLIER> coeff = _skp.getCoeffList();
-    vector<size_t>     nBody = _skp.getMatNumList();
-    vector<INDICES>    indices_list = _skp.getIndicesList(); 
-    vector<TERM>       term_list = _skp.getTermList();
-    INDICES            full_indices = join_all(indices_list);
-    TERM               full_term = join_all(term_list);
-
-    vector<size_t> dim_vector;
-    for(size_t i=0; i<full_term.size(); ++i)
-        dim_vector.push_back( full_term[i].n_cols );
-
-    size_t nSpin = _skp.getKronNum();
-    size_t nTerm = _skp.getKronProdSize();
-    double * coeff_list = coeff.data();
-    size_t * nBody_list = nBody.data();
-    
-    size_t * pos_offset = new size_t [nTerm+1];
-    pos_offset[0]=0; partial_sum (nBody_list, nBody_list+nTerm, pos_offset+1);
-    size_t total_nbody = pos_offset[nTerm];
-
-    size_t * pos_list   = full_indices.data();
-    size_t * dim_list   =  dim_vector.data();
-    size_t * dim2 = new size_t [total_nbody];
-    for(int i=0; i<total_nbody; ++i)
-        dim2[i] = dim_list[i]*dim_list[i];
-    
-    size_t * mat_offset = new size_t [total_nbody+1];
-    mat_offset[0]=0; partial_sum(dim2, dim2+total_nbody, mat_offset+1);
-    size_t total_dim = mat_offset[total_nbody];
-
-    complex<double> * matC = new complex<double> [total_dim];
-    int count = 0;
-    for(int i=0; i<full_term.size();++i)
-        for(int j=0; j<dim2[i]; ++j)
-        {
-            matC[count] = full_term[i](j);
-            count ++;
-        }
-    size_t nDim = _skp.getDim();
-    size_t * spin_dim   = spinDim.data();
+    // the flattened operator is taken from the plan, which is compiled only once;
+    // main_cache_ does not modify the arrays.
+    const KronOperatorPlan& plan = getPlan();
+    size_t nSpin       = plan.getSpinNum();
+    size_t nTerm       = plan.getTermNum();
+    size_t total_nbody = plan.getTotalBody();
+    size_t total_dim   = plan.getTotalMatSize();
+    size_t nDim        = plan.getDim();
+
+    double *          coeff_list = const_cast<double*>( plan.getCoeffList().data() );
+    size_t *          nBody_list = const_cast<size_t*>( plan.getBodyNumList().data() );
+    size_t *          pos_offset = const_cast<size_t*>( plan.getPosOffset().data() );
+    size_t *          pos_list   = const_cast<size_t*>( plan.getPosList().data() );
+    size_t *          dim_list   = const_cast<size_t*>( plan.getFactorDimList().data() );
+    size_t *          mat_offset = const_cast<size_t*>( plan.getMatOffset().data() );
+    complex<double> * matC       = const_cast<complex<double>*>( plan.getMatC().data() );
+    size_t *          spin_dim   = const_cast<size_t*>( plan.getSpinDimList().data() );
 
     complex<double> * vecC = _vector.memptr();
     
     size_t nt = _time_list.n_elem; 
     double * tlist =  _time_list.memptr();
 
-    complex<double> * w_seq;
+    result().set_size(nDim, nt);
+    complex<double> * w_seq = result().memptr();
     size_t w_seq_len= nDim * nt;
-    w_seq = new complex<double> [w_seq_len];
     //////////////////////////////////////////////////////////////////////////////
 
-    //////////////////////////////////////////////////////////////////////////////
-    // Print to screen
     if(_is_print_skp)
-    {/*{{{*/
-    cout << "#1. nSpin = " << nSpin << endl << endl;
-    cout << "#2. nTerm = " << nTerm << endl << endl;
-    cout << "#3. coeff_list = " << endl;
-    for(int i=0; i<nTerm;++i)
-        cout << coeff_list[i] << "\t";
-    cout << endl << endl;
-    cout << "#4. nBody_list = " << endl;
-    for(int i=0; i<nTerm;++i)
-        cout << nBody_list[i] << "\t";
-    cout << endl << endl;
-    cout << "#5. pos_offset = " << endl;
-    for(int i=0; i<nTerm+1;++i)
-        cout <<pos_offset[i] << "\t";
-    cout << endl << endl;
-
-    cout << "#6. pos_list = " << endl;
-    for(int i=0; i<total_nbody; ++i)
-        cout << pos_list[i] << "\t";
-    cout << endl << endl;
-    cout << "#7. dim_list = " << endl;
-    for(int i=0; i<total_nbody; ++i)
-        cout <<dim_list[i] << "\t";
-    cout << endl << endl;
-    cout << "#8. mat_offset = " << endl;
-    for(int i=0; i<total_nbody+1; ++i)
-        cout <<mat_offset[i] << "\t";
-    cout << endl << endl;
-
-    cout << "#9. matC = " << endl;
-    for(int i=0; i<total_dim; ++i)
-        cout << matC[i] << "\t";
-    cout << endl << endl;
-    cout << "#10. nDim = " << nDim << endl << endl;
-    cout << "#11. sin_dim = " << endl;
-    for(int i=0; i<nSpin; ++i)
-        cout << spin_dim[i] << "\t";
-    cout << endl << endl;
-    cout << "#12. vecC = " << endl;
-    for(int i=0; i<nDim; ++i) 
-        cout << vecC[i] << "\t";
-    cout << endl << endl;
-    cout << "#13. total_nbody = " << total_nbody << endl << endl;
-    cout << "#14. total_dim = " << total_dim << endl << endl;
-    cout << "#15. klim = " << _klim << endl << endl;
-    cout << "#16. nt = " << nt << endl << endl;
-    cout << "#17. tlist = " << endl;
-    for(int i=0; i<nt; ++i)
-        cout << tlist[i] << "\t";
-    cout << endl << endl;
-    cout << "#18. m= " << _krylov_m << endl << endl;
-    cout << "#19. tol = " << _krylov_tol << endl << endl;
-    cout << "#20. itrace = " << _itrace << endl << endl;
-    cout << "#21. w_seq = " << w_seq << endl << endl;
-    cout << "#22. w_seq_len = " << w_seq_len << endl << endl;
-
-    }/*}}}*/
+        print_parameters(w_seq, w_seq_len);
     
     size_t  _maxThreadsPerBlock  = 256;
     size_t  _maxGridSize[3]      = {2147483647,65535,65535};
@@ -510,17 +538,62 @@ cx_mat MatExpVector::runInexplicitGPU()
                 &_itrace,
                 w_seq,
                 &w_seq_len );
-    cx_mat res(w_seq, nDim, nt);
-    _resVectorList = res;
 
-    delete[] pos_offset;
-    delete[] dim2;
-    delete[] mat_offset;
-    delete[] matC;
-    delete[] w_seq;
+    return result();
+}/*}}}*/
 
-    return _resVectorList;
+void MatExpVector::get_krylov_workspace(complex<double>*& wsp, int& lwsp, int*& iwsp, int& liwsp) const
+{/*{{{*/
+    // the sizes required by krylov_zgexpv_/krylov_zcooexpv_;
+    lwsp  = _dim * (_krylov_m + 2) + 5 * (_krylov_m + 2) * (_krylov_m + 2) + 7;
+    liwsp = _krylov_m + 2;
+    WorkspaceArena& arena = WorkspaceArena::local();
+    wsp  = arena.getComplex(WorkspaceArena::KrylovWork, lwsp);
+    iwsp = arena.getInt(WorkspaceArena::KrylovWork, liwsp);
+}/*}}}*/
+
+void MatExpVector::print_parameters(const complex<double>* w_seq, size_t w_seq_len) const
+{/*{{{*/
+    // Print to screen
+    const complex<double> * vecC = _vector.memptr();
+    cout << getPlan();
+    cout << "#12. vecC = " << endl;
+    for(int i=0; i<_dim; ++i) 
+        cout << vecC[i] << "\t";
+    cout << endl << endl;
+    cout << "#15. klim = " << _klim << endl << endl;
+    cout << "#16. nt = " << _nTime << endl << endl;
+    cout << "#17. tlist = " << endl;
+    for(int i=0; i<_nTime; ++i)
+        cout << _time_list[i] << "\t";
+    cout << endl << endl;
+    cout << "#18. m= " << _krylov_m << endl << endl;
+    cout << "#19. tol = " << _krylov_tol << endl << endl;
+    cout << "#20. itrace = " << _itrace << endl << endl;
+    cout << "#21. w_seq = " << w_seq << endl << endl;
+    cout << "#22. w_seq_len = " << w_seq_len << endl << endl;
+}/*}}}*/
+
+const cx_mat& MatExpVector::runInexplicitNative()
+{/*{{{*/
+/// Matrix-free evolution with the C++ Kronecker apply engine and Krylov driver;
+/// neither MKL nor Fortran is needed.
+    KronApply op( getPlan() );
+    return run_native(op);
+}/*}}}*/
+
+const cx_mat& MatExpVector::runInexplicitChebyshev()
+{/*{{{*/
+/// The spectral bounds and the coefficients of the step are computed once for the whole time list.
+    KronApply op( getPlan() );
+    double emin, emax;
+    getPlan().getSpectralBounds(emin, emax);
+
+    ChebyshevExpv<KronApply> expv(op, _dim, emin, emax);
+    expv.setTolerance(_krylov_tol);
+    expv.run(_vector, _time_list, result());
+    _stats = expv.getStats();
+    return result();
 }/*}}}*/
 //}}}
 ////////////////////////////////////////////////////////////////////////////////
-
@@ -0,0 +1,67 @@
+#include "include/math/WorkspaceArena.h"
+#include <cstdlib>
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ WorkspaceArena
+// The arena of each thread is created at its first use and lives until the end of the program;
+// every arena is kept in arena_list, which is released by an atexit handler.
+static WorkspaceArena* thread_arena = NULL;
+#pragma omp threadprivate(thread_arena)
+static vector<WorkspaceArena*> arena_list;
+
+WorkspaceArena::WorkspaceArena()
+{ //LOG(INFO) << "Default constructor: WorkspaceArena";
+    _nAlloc = 0;
+}
+
+WorkspaceArena::~WorkspaceArena()
+{ //LOG(INFO) << "Default destructor: WorkspaceArena";
+}
+
+WorkspaceArena& WorkspaceArena::local()
+{
+    if(thread_arena == NULL)
+    {
+        thread_arena = new WorkspaceArena();
+#pragma omp critical(WorkspaceArena_list)
+        {
+            if( arena_list.empty() )
+                atexit(&WorkspaceArena::release_all);
+            arena_list.push_back(thread_arena);
+        }
+    }
+    return *thread_arena;
+}
+
+void WorkspaceArena::release_all()
+{
+/// Frees the arenas of all threads; registered with atexit at the first call of local().
+    for(size_t i=0; i<arena_list.size(); ++i)
+        delete arena_list[i];
+    arena_list.clear();
+    thread_arena = NULL;
+}
+
+cx_double* WorkspaceArena::getComplex(Slot slot, size_t n)
+{
+    vector<cx_double>& buf = _cx_buf[slot];
+    if(buf.size() < n)
+    {
+        buf.resize(n);
+        _nAlloc++;
+    }
+    return buf.empty() ? NULL : &buf[0];
+}
+
+int* WorkspaceArena::getInt(Slot slot, size_t n)
+{
+    vector<int>& buf = _int_buf[slot];
+    if(buf.size() < n)
+    {
+        buf.resize(n);
+        _nAlloc++;
+    }
+    return buf.empty() ? NULL : &buf[0];
+}
+//}}}
+////////////////////////////////////////////////////////////////////////////////
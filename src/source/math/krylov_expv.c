@@ -15,18 +15,36 @@
   #include "omp.h"
 #endif
 
-int krylov_zgexpv(const int n, const double _Complex *a, const double _Complex *v, const int tn, const double *ta, double _Complex *w_seq, const int klim, const int m, const double tol,  const int itrace)
+int krylov_zgexpv_wsp(const int n, const double _Complex *a, const double _Complex *v, const int tn, const double *ta, double _Complex *w_seq, const int klim, const int m, const double tol,  const int itrace, double _Complex *wsp, const int lwsp, int *iwsp, const int liwsp)
 {
   int             iflag = 0;
+  double          anorm = 0.0;
+  int             w_seq_len = n * tn;
   
+  krylov_zgexpv_(&n, a, v, &tn, ta, &m, &tol, &anorm, wsp, &lwsp, iwsp, &liwsp, &itrace, &iflag, w_seq, &w_seq_len);
+  return iflag;
+}
+
+int krylov_zcooexpv_wsp(const int n, const int nz, const int *ia, const int *ja, const double _Complex *a, const double _Complex *v, const int tn, const double *ta, double _Complex *w_seq, const int klim, const int m, const double tol,  const int itrace, double _Complex *wsp, const int lwsp, int *iwsp, const int liwsp)
+{
+  int             iflag = 0;
   double          anorm = 0.0;
-  int             lwsp = 0, liwsp = 0, w_seq_len = 0;
+  int             w_seq_len = n * tn;
+  
+  krylov_zcooexpv_(&n, &nz, ia, ja, a, v, &tn, ta, &m, &tol, &anorm, wsp, &lwsp, iwsp, &liwsp, &itrace, &iflag, w_seq, &w_seq_len);
+  return iflag;
+}
+
+int krylov_zgexpv(const int n, const double _Complex *a, const double _Complex *v, const int tn, const double *ta, double _Complex *w_seq, const int klim, const int m, const double tol,  const int itrace)
+{
+  int             iflag = 0;
+  
+  int             lwsp = 0, liwsp = 0;
   double _Complex *wsp  = NULL;
   int             *iwsp = NULL;
   
   lwsp      = n * (m + 2) + 5 * (m + 2) * (m + 2) + 7;
   liwsp     = m + 2;
-  w_seq_len = n * tn;
   
   wsp = (double _Complex *) malloc(sizeof(double _Complex) * lwsp);
   if (wsp == NULL) return -1;
@@ -36,7 +54,7 @@ int krylov_zgexpv(const int n, const double _Complex *a, const double _Complex *
     return -1;
   }
   
-  krylov_zgexpv_(&n, a, v, &tn, ta, &m, &tol, &anorm, wsp, &lwsp, iwsp, &liwsp, &itrace, &iflag, w_seq, &w_seq_len);
+  iflag = krylov_zgexpv_wsp(n, a, v, tn, ta, w_seq, klim, m, tol, itrace, wsp, lwsp, iwsp, liwsp);
   
   free(iwsp);
   free(wsp);
@@ -48,14 +66,12 @@ int krylov_zcooexpv(const int n, const int nz, const int *ia, const int *ja, con
 {
   int             iflag = 0;
   
-  double          anorm = 0.0;
-  int             lwsp = 0, liwsp = 0, w_seq_len = 0;
+  int             lwsp = 0, liwsp = 0;
   double _Complex *wsp  = NULL;
   int             *iwsp = NULL;
   
   lwsp      = n * (m + 2) + 5 * (m + 2) * (m + 2) + 7;
   liwsp     = m + 2;
-  w_seq_len = n * tn;
   
   wsp = (double _Complex *) malloc(sizeof(double _Complex) * lwsp);
   if (wsp == NULL) return -1;
@@ -65,7 +81,7 @@ int krylov_zcooexpv(const int n, const int nz, const int *ia, const int *ja, con
     return -1;
   }
   
-  krylov_zcooexpv_(&n, &nz, ia, ja, a, v, &tn, ta, &m, &tol, &anorm, wsp, &lwsp, iwsp, &liwsp, &itrace, &iflag, w_seq, &w_seq_len);
+  iflag = krylov_zcooexpv_wsp(n, nz, ia, ja, a, v, tn, ta, w_seq, klim, m, tol, itrace, wsp, lwsp, iwsp, liwsp);
   
   free(iwsp);
   free(wsp);
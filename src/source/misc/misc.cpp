@@ -10,31 +10,59 @@ vec r_vect(const cSPIN& obj1, const cSPIN& obj2){
 
 vec dipole(const cSPIN& spin1, const cSPIN& spin2)
 {
-    double d=spin_distance(spin1, spin2);
+    vec r=r_vect(spin1, spin2);
+    return dipole_tensor(r[0], r[1], r[2], spin1.get_gamma(), spin2.get_gamma());
+};
+
+vec dipole_tensor(double rx, double ry, double rz, double gamma1, double gamma2)
+{
+/// Dipolar coupling tensor (row-major 3x3) for a separation r in Angstrom.
+    double d=sqrt(rx*rx + ry*ry + rz*rz);
     if(d<=DISTANCE_EPSILON)
     {
         vec res = zeros<vec>(9);
         return  res;
     }
-    vec    r=r_vect(spin1, spin2);
-    vec    n=r/d;
 
-    double nx = n[0];
-    double ny = n[1];
-    double nz = n[2];
+    double nx = rx/d;
+    double ny = ry/d;
+    double nz = rz/d;
 
     double d0=d*1e-10;
-    double g1=spin1.get_gamma();
-    double g2=spin2.get_gamma();
-    double prefactor = datum::h_bar * (datum::mu_0)/(4.0 * datum::pi) * (g1*g2)/(d0*d0*d0);
+    double prefactor = datum::h_bar * (datum::mu_0)/(4.0 * datum::pi) * (gamma1*gamma2)/(d0*d0*d0);
 
-    vec res;
-    res << 1.0-3.0*nx*nx <<     -3.0*nx*ny <<     -3.0*nx*nz
-        <<    -3.0*ny*nx <<  1.0-3.0*ny*ny <<     -3.0*ny*nz
-        <<    -3.0*nz*nx <<     -3.0*nz*ny <<  1.0-3.0*nz*nz;
+    vec res(9);
+    res[0] = 1.0-3.0*nx*nx; res[1] =    -3.0*nx*ny; res[2] =    -3.0*nx*nz;
+    res[3] =    -3.0*ny*nx; res[4] = 1.0-3.0*ny*ny; res[5] =    -3.0*ny*nz;
+    res[6] =    -3.0*nz*nx; res[7] =    -3.0*nz*ny; res[8] = 1.0-3.0*nz*nz;
     return prefactor*res;
 };
 
+double spin_distance(const cSpinStore& store, size_t i, size_t j)
+{
+    double rx = store.get_x(i) - store.get_x(j);
+    double ry = store.get_y(i) - store.get_y(j);
+    double rz = store.get_z(i) - store.get_z(j);
+    return sqrt(rx*rx + ry*ry + rz*rz);
+}
+
+vec dipole(const cSpinStore& store, size_t i, size_t j)
+{
+    return dipole_tensor(store.get_x(i) - store.get_x(j), 
+                         store.get_y(i) - store.get_y(j),
+                         store.get_z(i) - store.get_z(j),
+                         store.get_gamma(i), store.get_gamma(j) );
+}
+
+vec dipole(const cSPIN& spin, const cSpinStore& store, size_t j)
+{
+    vec coord = spin.get_coordinate();
+    return dipole_tensor(coord[0] - store.get_x(j), 
+                         coord[1] - store.get_y(j),
+                         coord[2] - store.get_z(j),
+                         spin.get_gamma(), store.get_gamma(j) );
+}
+
 vec zeeman(const cSPIN&spin, const vec& magB)
 {
     double bx=magB[0], by=magB[1], bz=magB[2];
@@ -47,6 +75,18 @@ vec zeeman(const cSPIN&spin, const vec& magB)
     return res;
 };
 
+vec zeeman(const cSpinStore& store, size_t i, const vec& magB)
+{
+    double bx=magB[0], by=magB[1], bz=magB[2];
+    double g=store.get_gamma(i);
+    double q=store.get_omegaQ(i);
+    double e=store.get_eta(i);
+
+    vec res;
+    res << -g*bx <<  -g*by <<  -g*bz <<   e/3.0 <<  -e/3.0 << q;
+    return res;
+};
+
 vec dipole_field(const cSPIN& spin, const cSPIN& source_spin, const cx_vec& source_state_vect)
 {
     vec dip=dipole(spin, source_spin);
@@ -56,6 +96,120 @@ vec dipole_field(const cSPIN& spin, const cSPIN& source_spin, const cx_vec& sour
     return res;
 };
 
+vec dipole_field(const cSpinStore& store, size_t i, size_t source, const vec& source_spin_vect)
+{
+/// The spin vector of the source is given directly, so that it is computed only once for each source.
+    vec dip=dipole(store, i, source);
+    mat dip_m = reshape(dip, 3, 3);
+    vec res = dip_m * source_spin_vect;
+    return res;
+};
+
+void dipole_tensor_batch(size_t npair, const double* rx, const double* ry, const double* rz, const double* gg,
+                         double* dxx, double* dxy, double* dxz, double* dyy, double* dyz, double* dzz)
+{
+/// Batch version of dipole_tensor for npair separations given as SoA arrays, 
+/// gg[k] is the product of the two gyromagnetic ratios of the k-th pair.
+/// Only the 6 unique components of the symmetric tensor are written. 
+/// The loop has no branch so that it can be vectorized; 
+/// pairs closer than DISTANCE_EPSILON get a zero tensor, as in dipole_tensor.
+    const double c = datum::h_bar * (datum::mu_0)/(4.0 * datum::pi) * 1e30;
+    const double eps2 = DISTANCE_EPSILON*DISTANCE_EPSILON;
+    #pragma omp simd
+    for(size_t k=0; k<npair; ++k)
+    {
+        double d2 = rx[k]*rx[k] + ry[k]*ry[k] + rz[k]*rz[k];
+        double mask = d2 > eps2 ? 1.0 : 0.0;
+        double inv_d2 = mask / (d2 + (1.0-mask));
+        double inv_d = sqrt(inv_d2);
+        double prefactor = c * gg[k] * inv_d2 * inv_d;
+        double p3 = 3.0 * prefactor * inv_d2;
+
+        dxx[k] = prefactor - p3*rx[k]*rx[k];
+        dxy[k] =           - p3*rx[k]*ry[k];
+        dxz[k] =           - p3*rx[k]*rz[k];
+        dyy[k] = prefactor - p3*ry[k]*ry[k];
+        dyz[k] =           - p3*ry[k]*rz[k];
+        dzz[k] = prefactor - p3*rz[k]*rz[k];
+    }
+}
+
+mat dipole(const cSpinStore& store, const vector<size_t>& pair_index)
+{
+/// pair_index is a flat list (i0, j0, i1, j1, ...) of spin pairs in the store.
+/// Each column of the result is the 9 components of a pair, in the order of dipole().
+    size_t npair = pair_index.size()/2;
+    if(npair == 0) return mat(9, 0);
+    const vector<double>& x = store.getX();
+    const vector<double>& y = store.getY();
+    const vector<double>& z = store.getZ();
+
+    vector<double> buf(10*npair);
+    double *rx = &buf[0], *ry = rx+npair, *rz = ry+npair, *gg = rz+npair;
+    double *dxx = gg+npair, *dxy = dxx+npair, *dxz = dxy+npair;
+    double *dyy = dxz+npair, *dyz = dyy+npair, *dzz = dyz+npair;
+    for(size_t k=0; k<npair; ++k)
+    {
+        size_t i = pair_index[2*k], j = pair_index[2*k+1];
+        rx[k] = x[i] - x[j]; ry[k] = y[i] - y[j]; rz[k] = z[i] - z[j];
+        gg[k] = store.get_gamma(i) * store.get_gamma(j);
+    }
+    dipole_tensor_batch(npair, rx, ry, rz, gg, dxx, dxy, dxz, dyy, dyz, dzz);
+
+    mat res(9, npair);
+    for(size_t k=0; k<npair; ++k)
+    {
+        double* col = res.colptr(k);
+        col[0] = dxx[k]; col[1] = dxy[k]; col[2] = dxz[k];
+        col[3] = dxy[k]; col[4] = dyy[k]; col[5] = dyz[k];
+        col[6] = dxz[k]; col[7] = dyz[k]; col[8] = dzz[k];
+    }
+    return res;
+}
+
+mat dipole_field(const cSpinStore& store, const uvec& target, const mat& source_spin_vec, const vec& weight)
+{
+/// Dipolar fields at the target spins, summed over all the spins of the store.
+/// source_spin_vec is a 3xN matrix of the spin vectors, and weight[j] scales the field of the j-th spin 
+/// (a zero weight removes the spin from the sum). The result is a 3 x target.n_elem matrix.
+    size_t nspin = store.getSpinNum();
+    if(nspin == 0) return zeros<mat>(3, target.n_elem);
+    const vector<double>& x = store.getX();
+    const vector<double>& y = store.getY();
+    const vector<double>& z = store.getZ();
+
+    vector<double> buf(10*nspin);
+    double *rx = &buf[0], *ry = rx+nspin, *rz = ry+nspin, *gg = rz+nspin;
+    double *dxx = gg+nspin, *dxy = dxx+nspin, *dxz = dxy+nspin;
+    double *dyy = dxz+nspin, *dyz = dyy+nspin, *dzz = dyz+nspin;
+    const double* sv = source_spin_vec.memptr();
+
+    mat res(3, target.n_elem);
+    for(int q=0; q<target.n_elem; ++q)
+    {
+        size_t i = target[q];
+        double gi = store.get_gamma(i);
+        for(size_t j=0; j<nspin; ++j)
+        {
+            rx[j] = x[i] - x[j]; ry[j] = y[i] - y[j]; rz[j] = z[i] - z[j];
+            gg[j] = gi * store.get_gamma(j) * weight[j];
+        }
+        dipole_tensor_batch(nspin, rx, ry, rz, gg, dxx, dxy, dxz, dyy, dyz, dzz);
+
+        double bx = 0.0, by = 0.0, bz = 0.0;
+        #pragma omp simd reduction(+:bx,by,bz)
+        for(size_t j=0; j<nspin; ++j)
+        {
+            double sx = sv[3*j], sy = sv[3*j+1], sz = sv[3*j+2];
+            bx += dxx[j]*sx + dxy[j]*sy + dxz[j]*sz;
+            by += dxy[j]*sx + dyy[j]*sy + dyz[j]*sz;
+            bz += dxz[j]*sx + dyz[j]*sy + dzz[j]*sz;
+        }
+        res(0, q) = bx; res(1, q) = by; res(2, q) = bz;
+    }
+    return res;
+}
+
 vector<double> Pulse_Timing(string pulsename, int n)
 {
     vector<double> res;
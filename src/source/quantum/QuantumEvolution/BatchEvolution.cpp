@@ -0,0 +1,300 @@
+#include "include/quantum/BatchEvolution.h"
+#include <algorithm>
+#include <cmath>
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ BatchPiecewiseCoherence
+BatchPiecewiseCoherence::BatchPiecewiseCoherence()
+{ //LOG(INFO) << "Default constructor: BatchPiecewiseCoherence";
+    _dim = 0; _nBatch = 0; _nOp = 0;
+}
+
+BatchPiecewiseCoherence::BatchPiecewiseCoherence(size_t dim, size_t batch_size, size_t op_num)
+{
+    _dim = dim; _nBatch = batch_size; _nOp = op_num;
+    _H_re.assign(_nOp*_dim*_dim*_nBatch, 0.0);
+    _H_im.assign(_nOp*_dim*_dim*_nBatch, 0.0);
+    _psi_re.assign(_dim*_nBatch, 0.0);
+    _psi_im.assign(_dim*_nBatch, 0.0);
+}
+
+BatchPiecewiseCoherence::~BatchPiecewiseCoherence()
+{ //LOG(INFO) << "Default destructor: BatchPiecewiseCoherence";
+}
+
+void BatchPiecewiseCoherence::setOperator(size_t item, size_t op, const cx_mat& H)
+{
+    size_t offset = op*_dim*_dim*_nBatch;
+    for(size_t r=0; r<_dim; ++r)
+        for(size_t c=0; c<_dim; ++c)
+        {
+            _H_re[offset + (r*_dim+c)*_nBatch + item] = real( H(r, c) );
+            _H_im[offset + (r*_dim+c)*_nBatch + item] = imag( H(r, c) );
+        }
+}
+
+void BatchPiecewiseCoherence::setState(size_t item, const cx_vec& psi)
+{
+    for(size_t r=0; r<_dim; ++r)
+    {
+        _psi_re[r*_nBatch + item] = real( psi(r) );
+        _psi_im[r*_nBatch + item] = imag( psi(r) );
+    }
+}
+
+void BatchPiecewiseCoherence::setDensity(size_t item, const cx_mat& rho)
+{
+    if(_rho_re.empty())
+    {
+        _rho_re.assign(_dim*_dim*_nBatch, 0.0);
+        _rho_im.assign(_dim*_dim*_nBatch, 0.0);
+    }
+    for(size_t r=0; r<_dim; ++r)
+        for(size_t c=0; c<_dim; ++c)
+        {
+            _rho_re[(r*_dim+c)*_nBatch + item] = real( rho(r, c) );
+            _rho_im[(r*_dim+c)*_nBatch + item] = imag( rho(r, c) );
+        }
+}
+
+void BatchPiecewiseCoherence::matmul(const double* Ar, const double* Ai, const double* Br, const double* Bi, double* Cr, double* Ci) const
+{
+/// C = A B for all the items; C must not overlap A or B.
+    const size_t d = _dim, nb = _nBatch;
+    for(size_t r=0; r<d; ++r)
+        for(size_t c=0; c<d; ++c)
+        {
+            double* cr = Cr + (r*d+c)*nb;
+            double* ci = Ci + (r*d+c)*nb;
+            #pragma omp simd
+            for(size_t b=0; b<nb; ++b) { cr[b] = 0.0; ci[b] = 0.0; }
+            for(size_t k=0; k<d; ++k)
+            {
+                const double* ar = Ar + (r*d+k)*nb; const double* ai = Ai + (r*d+k)*nb;
+                const double* br = Br + (k*d+c)*nb; const double* bi = Bi + (k*d+c)*nb;
+                #pragma omp simd
+                for(size_t b=0; b<nb; ++b)
+                {
+                    cr[b] += ar[b]*br[b] - ai[b]*bi[b];
+                    ci[b] += ar[b]*bi[b] + ai[b]*br[b];
+                }
+            }
+        }
+}
+
+void BatchPiecewiseCoherence::matvec(const double* Ar, const double* Ai, const double* xr, const double* xi, double* yr, double* yi) const
+{
+/// y = A x for all the items; y must not overlap x.
+    const size_t d = _dim, nb = _nBatch;
+    for(size_t r=0; r<d; ++r)
+    {
+        double* rr = yr + r*nb; double* ri = yi + r*nb;
+        #pragma omp simd
+        for(size_t b=0; b<nb; ++b) { rr[b] = 0.0; ri[b] = 0.0; }
+        for(size_t k=0; k<d; ++k)
+        {
+            const double* ar = Ar + (r*d+k)*nb; const double* ai = Ai + (r*d+k)*nb;
+            const double* vr = xr + k*nb;       const double* vi = xi + k*nb;
+            #pragma omp simd
+            for(size_t b=0; b<nb; ++b)
+            {
+                rr[b] += ar[b]*vr[b] - ai[b]*vi[b];
+                ri[b] += ar[b]*vi[b] + ai[b]*vr[b];
+            }
+        }
+    }
+}
+
+void BatchPiecewiseCoherence::expm(const double* Hr, const double* Hi, double tau, double* Ur, double* Ui) const
+{
+/// U = exp(-i H tau) for all the items.
+/// A = -i H tau is scaled by 2^-s so that its 1-norm is below 1/2 for every item,
+/// then exp(A 2^-s) is summed up to the 14th order (error < 1e-16) and squared s times.
+    const size_t d = _dim, nb = _nBatch, d2 = d*d, n = d2*nb;
+    double nrm = 0.0;
+    for(size_t c=0; c<d; ++c)
+        for(size_t b=0; b<nb; ++b)
+        {
+            double col = 0.0;
+            for(size_t r=0; r<d; ++r)
+                col += sqrt( Hr[(r*d+c)*nb+b]*Hr[(r*d+c)*nb+b] + Hi[(r*d+c)*nb+b]*Hi[(r*d+c)*nb+b] );
+            nrm = max(nrm, col);
+        }
+    nrm *= fabs(tau);
+    int s = nrm > 0.5 ? (int) ceil( log(nrm/0.5)/log(2.0) ) : 0;
+    double scale = tau * pow(0.5, s);
+
+    // A = -i H scale: Ar = scale*Hi, Ai = -scale*Hr
+    vector<double> buf(6*n);
+    double *Ar = &buf[0], *Ai = Ar+n, *Tr = Ai+n, *Ti = Tr+n, *Sr = Ti+n, *Si = Sr+n;
+    #pragma omp simd
+    for(size_t q=0; q<n; ++q) { Ar[q] = scale*Hi[q]; Ai[q] = -scale*Hr[q]; }
+
+    // U = I, T = I
+    for(size_t q=0; q<n; ++q) { Ur[q] = 0.0; Ui[q] = 0.0; }
+    for(size_t r=0; r<d; ++r)
+        for(size_t b=0; b<nb; ++b) Ur[(r*d+r)*nb+b] = 1.0;
+    copy(Ur, Ur+n, Tr); copy(Ui, Ui+n, Ti);
+
+    for(int k=1; k<=14; ++k)
+    {   // T = T A / k, U += T
+        matmul(Tr, Ti, Ar, Ai, Sr, Si);
+        double f = 1.0/k;
+        #pragma omp simd
+        for(size_t q=0; q<n; ++q)
+        {
+            Tr[q] = f*Sr[q]; Ti[q] = f*Si[q];
+            Ur[q] += Tr[q];  Ui[q] += Ti[q];
+        }
+    }
+    for(int k=0; k<s; ++k)
+    {
+        matmul(Ur, Ui, Ur, Ui, Sr, Si);
+        copy(Sr, Sr+n, Ur); copy(Si, Si+n, Ui);
+    }
+}
+
+static void index_keys(const vector<int>& op_index, const vector<double>& time_segment, double sign,
+                       vector< pair<int, double> >& key_list, vector<int>& key)
+{
+/// The segment j is the key (op_index[j], sign*time_segment[j]); the keys are shared by all the calls.
+    for(int j=0; j<op_index.size(); ++j)
+    {
+        pair<int, double> k = make_pair(op_index[j], sign*time_segment[j]);
+        int pos = find(key_list.begin(), key_list.end(), k) - key_list.begin();
+        if( pos == key_list.size() )
+            key_list.push_back(k);
+        key.push_back(pos);
+    }
+}
+
+void BatchPiecewiseCoherence::key_propagators(const vector< pair<int, double> >& key_list, double dt, vector<double>& U_re, vector<double>& U_im) const
+{
+/// U_k = exp(-i H tau_k dt) of each key (operator, tau_k), for all the items.
+    const size_t n = _dim*_dim*_nBatch;
+    U_re.resize(key_list.size()*n); U_im.resize(key_list.size()*n);
+    for(size_t k=0; k<key_list.size(); ++k)
+    {
+        size_t op_offset = key_list[k].first*n;
+        expm(&_H_re[op_offset], &_H_im[op_offset], key_list[k].second*dt, &U_re[k*n], &U_im[k*n]);
+    }
+}
+
+mat BatchPiecewiseCoherence::run(const vector<int>& op_index1, const vector<int>& op_index2, const vector<double>& time_segment, const vec& time_list)
+{
+/// res(i, b) = Re <psi_1(t_i)|psi_2(t_i)> of item b, with t_i = i*dt as in the piecewise engines.
+    const size_t d = _dim, nb = _nBatch, n = d*d*nb, nv = d*nb;
+    const size_t nTime = time_list.n_elem;
+    mat res(nTime, nb, fill::ones);
+    if(nTime < 2 || nb == 0) return res;
+    double dt = time_list(1) - time_list(0);
+
+    // distinct (operator, segment length) pairs of both branches
+    vector< pair<int, double> > key_list;
+    vector<int> key1, key2;
+    index_keys(op_index1, time_segment, 1.0, key_list, key1);
+    index_keys(op_index2, time_segment, 1.0, key_list, key2);
+
+    // U_k = exp(-i H tau_k dt), and their powers P_k = U_k^i
+    size_t nKey = key_list.size();
+    vector<double> U_re, U_im, S_re(n), S_im(n);
+    key_propagators(key_list, dt, U_re, U_im);
+    vector<double> P_re(U_re), P_im(U_im);
+
+    vector<double> x_re(nv), x_im(nv), y_re(nv), y_im(nv), z_re(nv), z_im(nv);
+    for(size_t i=1; i<nTime; ++i)
+    {
+        for(int branch=0; branch<2; ++branch)
+        {
+            const vector<int>& key = branch == 0 ? key1 : key2;
+            vector<double>& out_re = branch == 0 ? x_re : y_re;
+            vector<double>& out_im = branch == 0 ? x_im : y_im;
+            out_re = _psi_re; out_im = _psi_im;
+            for(int j=0; j<key.size(); ++j)
+            {
+                matvec(&P_re[key[j]*n], &P_im[key[j]*n], &out_re[0], &out_im[0], &z_re[0], &z_im[0]);
+                out_re.swap(z_re); out_im.swap(z_im);
+            }
+        }
+
+        for(size_t b=0; b<nb; ++b)
+        {
+            double re = 0.0;
+            for(size_t q=0; q<d; ++q)
+                re += x_re[q*nb+b]*y_re[q*nb+b] + x_im[q*nb+b]*y_im[q*nb+b];
+            res(i, b) = re;
+        }
+
+        for(size_t k=0; k<nKey; ++k)
+        {
+            matmul(&U_re[k*n], &U_im[k*n], &P_re[k*n], &P_im[k*n], &S_re[0], &S_im[0]);
+            copy(S_re.begin(), S_re.end(), P_re.begin()+k*n);
+            copy(S_im.begin(), S_im.end(), P_im.begin()+k*n);
+        }
+    }
+    return res;
+}
+
+mat BatchPiecewiseCoherence::runTrace(const vector<int>& left_index, const vector<int>& right_index, const vector<double>& time_segment, const vec& time_list)
+{
+/// res(i, b) = Re tr(L rho_b R) of item b at t_i = i*dt. The right segments are the keys of
+/// negative length, exp(i H tau); a time point costs one batched product per segment, plus rho R.
+    const size_t d = _dim, nb = _nBatch, n = d*d*nb;
+    const size_t nTime = time_list.n_elem;
+    mat res(nTime, nb, fill::ones);
+    if(nTime < 2 || nb == 0) return res;
+    double dt = time_list(1) - time_list(0);
+
+    vector< pair<int, double> > key_list;
+    vector<int> key1, key2;
+    index_keys(left_index, time_segment, 1.0, key_list, key1);
+    index_keys(right_index, time_segment, -1.0, key_list, key2);
+
+    size_t nKey = key_list.size();
+    vector<double> U_re, U_im, S_re(n), S_im(n);
+    key_propagators(key_list, dt, U_re, U_im);
+    vector<double> P_re(U_re), P_im(U_im);
+
+    vector<double> L_re(n), L_im(n), R_re(n), R_im(n), tr(nb);
+    for(size_t i=1; i<nTime; ++i)
+    {
+        for(int branch=0; branch<2; ++branch)
+        {
+            const vector<int>& key = branch == 0 ? key1 : key2;
+            vector<double>& out_re = branch == 0 ? L_re : R_re;
+            vector<double>& out_im = branch == 0 ? L_im : R_im;
+            copy(P_re.begin()+key[0]*n, P_re.begin()+(key[0]+1)*n, out_re.begin());
+            copy(P_im.begin()+key[0]*n, P_im.begin()+(key[0]+1)*n, out_im.begin());
+            for(int j=1; j<key.size(); ++j)
+            {
+                matmul(&out_re[0], &out_im[0], &P_re[key[j]*n], &P_im[key[j]*n], &S_re[0], &S_im[0]);
+                out_re.swap(S_re); out_im.swap(S_im);
+            }
+        }
+
+        // S = rho R, tr(L S) = sum_{ac} L(a,c) S(c,a)
+        matmul(&_rho_re[0], &_rho_im[0], &R_re[0], &R_im[0], &S_re[0], &S_im[0]);
+        for(size_t b=0; b<nb; ++b) tr[b] = 0.0;
+        for(size_t a=0; a<d; ++a)
+            for(size_t c=0; c<d; ++c)
+            {
+                const double* lr = &L_re[(a*d+c)*nb]; const double* li = &L_im[(a*d+c)*nb];
+                const double* sr = &S_re[(c*d+a)*nb]; const double* si = &S_im[(c*d+a)*nb];
+                #pragma omp simd
+                for(size_t b=0; b<nb; ++b)
+                    tr[b] += lr[b]*sr[b] - li[b]*si[b];
+            }
+        for(size_t b=0; b<nb; ++b)
+            res(i, b) = tr[b];
+
+        for(size_t k=0; k<nKey; ++k)
+        {
+            matmul(&U_re[k*n], &U_im[k*n], &P_re[k*n], &P_im[k*n], &S_re[0], &S_im[0]);
+            copy(S_re.begin(), S_re.end(), P_re.begin()+k*n);
+            copy(S_im.begin(), S_im.end(), P_im.begin()+k*n);
+        }
+    }
+    return res;
+}
+//}}}
+////////////////////////////////////////////////////////////////////////////////
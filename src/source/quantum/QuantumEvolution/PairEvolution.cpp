@@ -0,0 +1,129 @@
+#include "include/quantum/PairEvolution.h"
+#include <assert.h>
+#include <cmath>
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ SpinPairCoherence
+SpinPairCoherence::SpinPairCoherence()
+{ //LOG(INFO) << "Default constructor: SpinPairCoherence";
+    _dim = 0;
+}
+
+SpinPairCoherence::SpinPairCoherence(const vector<cx_mat>& hm_list)
+{
+/// The blocks are the connected components of the graph of the nonzero elements of H.
+    _dim = hm_list.empty() ? 0 : hm_list[0].n_rows;
+    _block_list.resize( hm_list.size() );
+    for(int k=0; k<hm_list.size(); ++k)
+    {
+        const cx_mat& H = hm_list[k];
+        assert(H.n_rows == _dim && H.n_cols == _dim);
+        vector<bool> is_visited(_dim, false);
+        for(size_t r0=0; r0<_dim; ++r0)
+        {
+            if(is_visited[r0]) continue;
+            vector<uword> idx(1, r0);
+            is_visited[r0] = true;
+            for(size_t q=0; q<idx.size(); ++q)
+                for(size_t c=0; c<_dim; ++c)
+                    if(!is_visited[c] && H(idx[q], c) != 0.0)
+                    {
+                        is_visited[c] = true;
+                        idx.push_back(c);
+                    }
+
+            PairBlock blk;
+            blk.index = conv_to<uvec>::from(idx);
+            blk.c0 = 0.0; blk.nz = 0.0; blk.b = 0.0;
+            cx_mat h = H.submat(blk.index, blk.index);
+            if(h.n_rows == 1)
+                blk.c0 = real( h(0, 0) );
+            else if(h.n_rows == 2)
+            {
+                blk.c0 = 0.5*real( h(0, 0) + h(1, 1) );
+                blk.nz = 0.5*real( h(0, 0) - h(1, 1) );
+                blk.b  = h(0, 1);
+            }
+            else
+                eig_sym(blk.E, blk.V, h);
+            _block_list[k].push_back(blk);
+        }
+    }
+}
+
+SpinPairCoherence::~SpinPairCoherence()
+{ //LOG(INFO) << "Default destructor: SpinPairCoherence";
+}
+
+cx_mat SpinPairCoherence::propagator(int op, double tau) const
+{
+    cx_mat U = zeros<cx_mat>(_dim, _dim);
+    const vector<PairBlock>& blocks = _block_list[op];
+    for(int k=0; k<blocks.size(); ++k)
+    {
+        const PairBlock& blk = blocks[k];
+        const cx_double phase = exp( cx_double(0.0, -blk.c0*tau) );
+        if(blk.index.n_elem == 1)
+            U(blk.index(0), blk.index(0)) = phase;
+        else if(blk.index.n_elem == 2)
+        {
+            double w = sqrt( blk.nz*blk.nz + norm(blk.b) );
+            double c = cos(w*tau), s = w > 0.0 ? sin(w*tau)/w : tau;
+            uword p = blk.index(0), q = blk.index(1);
+            U(p, p) = phase*cx_double(c, -s*blk.nz);
+            U(q, q) = phase*cx_double(c,  s*blk.nz);
+            U(p, q) = phase*cx_double(0.0, -s)*blk.b;
+            U(q, p) = phase*cx_double(0.0, -s)*conj(blk.b);
+        }
+        else
+        {
+            cx_vec ph = exp( cx_double(0.0, -tau)*conv_to<cx_vec>::from(blk.E) );
+            U.submat(blk.index, blk.index) = blk.V * diagmat(ph) * blk.V.t();
+        }
+    }
+    return U;
+}
+
+vec SpinPairCoherence::getTraceList(const vector<int>& left_index, const vector<int>& right_index,
+                                    const vector<double>& time_segment, const vec& time_list, const cx_mat& rho) const
+{
+    assert(left_index.size() == right_index.size());
+    size_t nTime = time_list.n_elem;
+    double dt = nTime > 1 ? time_list(1) - time_list(0) : 0.0;
+    vec res(nTime);
+    for(size_t i=0; i<nTime; ++i)
+    {
+        cx_mat L = eye<cx_mat>(_dim, _dim), R = eye<cx_mat>(_dim, _dim);
+        for(int j=0; j<left_index.size() && i>0; ++j)
+        {
+            double tau = time_segment[j]*dt*i;
+            L = L*propagator(left_index[j], tau);
+            R = R*propagator(right_index[j], -tau);
+        }
+        res(i) = real( trace(L*rho*R) );
+    }
+    return res;
+}
+
+vec SpinPairCoherence::getOverlapList(const vector<int>& op_index1, const vector<int>& op_index2,
+                                      const vector<double>& time_segment, const vec& time_list, const cx_vec& psi) const
+{
+    assert(op_index1.size() == op_index2.size());
+    size_t nTime = time_list.n_elem;
+    double dt = nTime > 1 ? time_list(1) - time_list(0) : 0.0;
+    vec res(nTime);
+    for(size_t i=0; i<nTime; ++i)
+    {
+        cx_vec psi1 = psi, psi2 = psi;
+        for(int j=0; j<op_index1.size() && i>0; ++j)
+        {
+            double tau = time_segment[j]*dt*i;
+            psi1 = propagator(op_index1[j], tau)*psi1;
+            psi2 = propagator(op_index2[j], tau)*psi2;
+        }
+        res(i) = real( cdot(psi1, psi2) );
+    }
+    return res;
+}
+//}}}
+////////////////////////////////////////////////////////////////////////////////
@@ -1,14 +1,167 @@
 #include "include/quantum/QuantumEvolutionAlgorithm.h"
+#include <algorithm>
+#include <map>
+#include <limits>
 
 
 ////////////////////////////////////////////////////////////////////////////////
 //{{{ QuantumEvolutionAlgorithm
 QuantumEvolutionAlgorithm::QuantumEvolutionAlgorithm(QuantumOperator& op, QuantumState& st)
 {
+    _observer = NULL; _is_subspace = false; _is_interaction_picture = false;
     _operator = op;
     _init_state = st;
     _state_dimension = st.getDimension()*st.getDimension();
 }
+
+/// The nonzero rows of a column of the operators, from the dense matrices or from the plans.
+struct DenseColumns
+{
+    const vector<cx_mat>& op_list;
+    DenseColumns(const vector<cx_mat>& ops) : op_list(ops) {};
+    void operator () (size_t c, vector<size_t>& row) const
+    {
+        row.clear();
+        for(int k=0; k<op_list.size(); ++k)
+        {
+            const cx_double* col = op_list[k].colptr(c);
+            for(size_t r=0; r<op_list[k].n_rows; ++r)
+                if(col[r] != 0.0) row.push_back(r);
+        }
+    };
+};
+
+struct PlanColumns
+{
+    const vector<KronOperatorPlan>& plan_list;
+    mutable vector< pair<size_t, cx_double> > col;
+    PlanColumns(const vector<KronOperatorPlan>& plans) : plan_list(plans) {};
+    void operator () (size_t c, vector<size_t>& row) const
+    {
+        row.clear();
+        for(int k=0; k<plan_list.size(); ++k)
+        {
+            kron_plan_column(plan_list[k], c, col);
+            for(size_t e=0; e<col.size(); ++e) row.push_back( col[e].first );
+        }
+    };
+};
+
+template<class Columns>
+static uvec reached_states(const Columns& columns, vector<size_t>& queue, vector<bool>& is_reached)
+{
+/// Breadth-first search from the states of queue (marked in is_reached) through the nonzero
+/// elements of the columns; the reached states are returned in ascending order.
+    vector<size_t> row;
+    for(size_t h=0; h<queue.size(); ++h)
+    {
+        columns(queue[h], row);
+        for(size_t e=0; e<row.size(); ++e)
+            if(!is_reached[ row[e] ])
+            {
+                is_reached[ row[e] ] = true;
+                queue.push_back( row[e] );
+            }
+    }
+    sort(queue.begin(), queue.end());
+    uvec sub(queue.size());
+    for(size_t n=0; n<queue.size(); ++n) sub(n) = queue[n];
+    return sub;
+}
+
+template<class Columns>
+static uvec support_states(const Columns& columns, const cx_vec& x)
+{
+    size_t dim = x.n_elem;
+    vector<bool>   is_reached(dim, false);
+    vector<size_t> queue;
+    for(size_t r=0; r<dim; ++r)
+        if(x(r) != 0.0)
+        {
+            is_reached[r] = true;
+            queue.push_back(r);
+        }
+    return reached_states(columns, queue, is_reached);
+}
+
+template<class Columns>
+static vector<uvec> split_states(const Columns& columns, size_t dim)
+{
+    vector<uvec>   blocks;
+    vector<bool>   is_reached(dim, false);
+    vector<size_t> queue;
+    for(size_t c=0; c<dim; ++c)
+        if(!is_reached[c])
+        {
+            is_reached[c] = true;
+            queue.assign(1, c);
+            blocks.push_back( reached_states(columns, queue, is_reached) );
+        }
+    return blocks;
+}
+
+uvec QuantumEvolutionAlgorithm::occupied_subspace(const vector<cx_mat>& op_list, const cx_vec& x)
+{
+/// The basis states reachable from the support of x through the nonzero elements of the operators,
+/// in ascending order. When the operators conserve a quantum number (e.g. the total Sz of a
+/// secular Hamiltonian), these are the blocks occupied by x.
+    return support_states(DenseColumns(op_list), x);
+}
+
+uvec QuantumEvolutionAlgorithm::occupied_subspace(const vector<KronOperatorPlan>& plan_list, const cx_vec& x)
+{
+/// The same, with the columns read from the plans (kron_plan_column), for the dimensions at which
+/// the dense matrices are out of reach.
+    return support_states(PlanColumns(plan_list), x);
+}
+
+vector<uvec> QuantumEvolutionAlgorithm::occupied_blocks(const vector<cx_mat>& op_list, size_t dim)
+{
+/// The partition of the basis into the smallest subspaces left invariant by all the operators,
+/// i.e. the occupied_subspace of each basis state, in ascending order of their first state.
+    return split_states(DenseColumns(op_list), dim);
+}
+
+vector<uvec> QuantumEvolutionAlgorithm::occupied_blocks(const vector<KronOperatorPlan>& plan_list, size_t dim)
+{
+    return split_states(PlanColumns(plan_list), dim);
+}
+
+void QuantumEvolutionAlgorithm::index_operators(const vector<QuantumOperator>& op_list, vector<QuantumOperator>& distinct_list, vector<int>& op_index)
+{
+/// op_list[j] is the same operator as distinct_list[ op_index[j] ].
+/// The operators of distinct_list are compiled on return.
+    distinct_list.clear(); op_index.clear();
+    for(int j=0; j<op_list.size(); ++j)
+    {
+        int k = 0;
+        while( k<distinct_list.size() && !distinct_list[k].isSame(op_list[j]) )
+            ++k;
+        if( k == distinct_list.size() )
+        {
+            distinct_list.push_back( op_list[j] );
+            distinct_list.back().compile();
+        }
+        op_index.push_back(k);
+    }
+}
+
+void QuantumEvolutionAlgorithm::index_segments(const vector<int>& op_index, const vector<double>& time_segment, vector< pair<int, double> >& key_list, vector<int>& key_index)
+{
+/// The segment j (operator op_index[j] during time_segment[j]) has the propagator of key_list[ key_index[j] ].
+/// The segment lengths are compared up to rounding, since the intervals of a sequence come as differences of its timings.
+    key_list.clear(); key_index.clear();
+    for(int j=0; j<op_index.size(); ++j)
+    {
+        pair<int, double> key = make_pair(op_index[j], time_segment[j]);
+        int k = 0;
+        while( k<key_list.size() && !( key_list[k].first == key.first && abs(key_list[k].second - key.second) <= 1e-12*abs(key.second) ) )
+            ++k;
+        if( k == key_list.size() )
+            key_list.push_back(key);
+        key_index.push_back(k);
+    }
+}
 //}}}
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -19,23 +172,26 @@ QuantumEvolutionAlgorithm::QuantumEvolutionAlgorithm(QuantumOperator& op, Quantu
 void SimpleFullMatrixVectorEvolution::perform()
 {
     _matrix = _operator.getMatrix();
-    _vector_list.push_back(_init_state.getVector());
+    StateListObserver store(_vector_list, _state_mat_list);
+    EvolutionObserver& obs = _observer ? *_observer : store;
     
     ////////////////////////////////////////////////////////////////////////////////
     //begin evolution
     double dt;
     double t_now     = _time_list[0];
-    cx_vec state_now = _vector_list[0];
+    cx_vec state_now = _init_state.getVector();
+    obs.observe(0, state_now);
     cx_vec state_next;
+    cx_mat expm;
 
     for(int i=1; i<_time_list.size(); ++i)
     {
         double t_next = _time_list[i];
         dt = t_next - t_now;
-        MatExp expM(_matrix, -1.0*dt*II, MatExp::PadeApproximation); expM.run();
-        state_next = expM.getResultMatrix() * state_now;
+        MatExp expM(_matrix, -1.0*dt*II, MatExp::PadeApproximation); expM.run(expm);
+        state_next = expm * state_now;
         
-        _vector_list.push_back( state_next );
+        obs.observe(i, state_next);
         
         t_now = t_next;
         state_now = state_next;
@@ -51,34 +207,282 @@ void SimpleFullMatrixVectorEvolution::perform()
 //{{{ PiecewiseFullMatrixVectorEvolution
 PiecewiseFullMatrixVectorEvolution::PiecewiseFullMatrixVectorEvolution(const vector<QuantumOperator>& op_list, const vector<double>& time_segment, const QuantumState& st)
 {
-   _op_list = op_list; 
+   index_operators(op_list, _op_list, _op_index);
    _time_segment = time_segment;
    _init_state = st;
     _state_dimension = st.getDimension()*st.getDimension();
 }
 
+template<int D>
+static void piecewise_vector_fixed(const vector<QuantumOperator>& op_list, const vector< pair<int, double> >& key_list, const vector<int>& key_index, double dt, const cx_vec& init, size_t nTime, EvolutionObserver& obs)
+{
+/// The same scheme as PiecewiseFullMatrixVectorEvolution::perform, on stack-sized D x D blocks.
+    const int nKey = key_list.size();
+    vector<cx_double> expm(nKey*D*D), expm1(nKey*D*D);
+    cx_double A[D*D], S[D*D], x[D], y[D];
+    for(int k=0; k<nKey; ++k)
+    {
+        cx_mat Hk = op_list[key_list[k].first].getMatrix();
+        const cx_double* H = Hk.memptr();
+        for(int q=0; q<D*D; ++q)
+            A[q] = -1.0*II* key_list[k].second*dt * H[q];
+        fixed_expm<D>(A, &expm[k*D*D]);
+    }
+
+    cx_vec state_i(D);
+    expm1 = expm;
+    for(int i=1; i<nTime; ++i)
+    {
+        for(int r=0; r<D; ++r) x[r] = init(r);
+        for(int j=0; j<key_index.size(); ++j)
+        {
+            fixed_matvec<D>(&expm1[key_index[j]*D*D], x, y);
+            for(int r=0; r<D; ++r) x[r] = y[r];
+        }
+        for(int k=0; k<nKey; ++k)
+        {
+            fixed_matmul<D>(&expm[k*D*D], &expm1[k*D*D], S);
+            for(int q=0; q<D*D; ++q) expm1[k*D*D+q] = S[q];
+        }
+        for(int r=0; r<D; ++r) state_i(r) = x[r];
+        obs.observe(i, state_i);
+    }
+}
+
 void PiecewiseFullMatrixVectorEvolution::perform()
 {
-    _vector_list.push_back(_init_state.getVector());
+    StateListObserver store(_vector_list, _state_mat_list);
     double dt = _time_list[1] - _time_list[0];
+    double seq_len = 0.0;
+    for(int j=0; j<_time_segment.size(); ++j) seq_len += _time_segment[j];
+    FrameObserver frame_obs(_observer ? *_observer : store, _frame, seq_len*dt);
+    EvolutionObserver& obs = _is_interaction_picture ? frame_obs : (_observer ? *_observer : store);
+    cx_vec init = _init_state.getVector();
+    obs.observe(0, init);
 
-    vector<cx_mat> expm_list, expm_list1;
-    for(int j=0; j<_op_list.size(); ++j)
+    vector< pair<int, double> > key_list;
+    vector<int> key_index;
+    index_segments(_op_index, _time_segment, key_list, key_index);
+
+    size_t nTime = _time_list.size();
+    switch( init.n_elem )
     {
-        MatExp expM(_op_list[j].getMatrix(), -1.0*II* _time_segment[j]*dt, MatExp::PadeApproximation); expM.run();
-        expm_list.push_back( expM.getResultMatrix() );
+        case 2: piecewise_vector_fixed<2>(_op_list, key_list, key_index, dt, init, nTime, obs); return;
+        case 3: piecewise_vector_fixed<3>(_op_list, key_list, key_index, dt, init, nTime, obs); return;
+        case 4: piecewise_vector_fixed<4>(_op_list, key_list, key_index, dt, init, nTime, obs); return;
+        case 6: piecewise_vector_fixed<6>(_op_list, key_list, key_index, dt, init, nTime, obs); return;
+        case 8: piecewise_vector_fixed<8>(_op_list, key_list, key_index, dt, init, nTime, obs); return;
+        case 9: piecewise_vector_fixed<9>(_op_list, key_list, key_index, dt, init, nTime, obs); return;
+        default: break;
     }
 
+    // one MatExp per distinct operator, shared by the segment lengths of that operator
+    vector<MatExp> expM_list;
+    for(int k=0; k<_op_list.size(); ++k)
+        expM_list.push_back( MatExp(_op_list[k].getMatrix(), MatExp::ScalingSquaring) );
+    vector<cx_mat> expm_list(key_list.size()), expm_list1;
+    for(int k=0; k<key_list.size(); ++k)
+        expM_list[key_list[k].first].run(-1.0*II* key_list[k].second*dt, expm_list[k]);
+
     expm_list1 = expm_list;
     for(int i=1; i<_time_list.size(); ++i)
     {
-        cx_vec state_i = _vector_list[0];
-        for(int j=0; j<_op_list.size(); ++j)
+        cx_vec state_i = init;
+        for(int j=0; j<key_index.size(); ++j)
+            state_i = expm_list1[key_index[j]]*state_i; 
+        for(int k=0; k<key_list.size(); ++k)
+            expm_list1[k] = expm_list[k]*expm_list1[k];
+        obs.observe(i, state_i);
+    }
+}
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ PiecewiseEigenVectorEvolution
+PiecewiseEigenVectorEvolution::PiecewiseEigenVectorEvolution(const vector<QuantumOperator>& op_list, const vector<double>& time_segment, const QuantumState& st)
+{
+   index_operators(op_list, _op_list, _op_index);
+   _time_segment = time_segment;
+   _init_state = st;
+    _state_dimension = st.getDimension()*st.getDimension();
+}
+
+template<int D>
+static void piecewise_eigen_fixed(const vector<vec>& eigval_list, const vector<cx_mat>& eigvec_list, const vector<int>& op_index, const vector<double>& time_segment, double dt, const cx_vec& init, size_t nTime, EvolutionObserver& obs)
+{
+    cx_double x[D], y[D];
+    cx_vec state_i(D);
+    for(int i=1; i<nTime; ++i)
+    {
+        for(int r=0; r<D; ++r) x[r] = init(r);
+        for(int j=0; j<op_index.size(); ++j)
+        {
+            int k = op_index[j];
+            fixed_eig_propagate<D>(eigvec_list[k].memptr(), eigval_list[k].memptr(), time_segment[j]*dt*i, x, y);
+            for(int r=0; r<D; ++r) x[r] = y[r];
+        }
+        for(int r=0; r<D; ++r) state_i(r) = x[r];
+        obs.observe(i, state_i);
+    }
+}
+
+void PiecewiseEigenVectorEvolution::perform()
+{
+    StateListObserver store(_vector_list, _state_mat_list);
+    double dt = _time_list[1] - _time_list[0];
+    double seq_len = 0.0;
+    for(int j=0; j<_time_segment.size(); ++j) seq_len += _time_segment[j];
+    FrameObserver frame_obs(_observer ? *_observer : store, _frame, seq_len*dt);
+    EvolutionObserver& obs = _is_interaction_picture ? frame_obs : (_observer ? *_observer : store);
+    cx_vec init = _init_state.getVector();
+    obs.observe(0, init);
+    size_t dim = init.n_elem;
+
+    int op_num = _op_list.size();
+    vector<cx_mat> hm_list(op_num);
+    for(int k=0; k<op_num; ++k)
+        hm_list[k] = _op_list[k].getMatrix();
+
+    uvec sub;
+    if(_is_subspace)
+    {
+        sub = occupied_subspace(hm_list, init);
+        if(sub.n_elem < dim)
+        {
+            for(int k=0; k<op_num; ++k)
+                hm_list[k] = hm_list[k].submat(sub, sub);
+            init = init.elem(sub);
+        }
+    }
+    SubspaceObserver sub_obs(obs, sub, dim);
+    EvolutionObserver& kernel_obs = init.n_elem < dim ? sub_obs : obs;
+
+    vector<vec>    eigval_list(op_num);
+    vector<cx_mat> eigvec_list(op_num);
+    for(int k=0; k<op_num; ++k)
+        eig_sym(eigval_list[k], eigvec_list[k], hm_list[k]);
+
+    size_t nTime = _time_list.size();
+    switch( init.n_elem )
+    {
+        case 2: piecewise_eigen_fixed<2>(eigval_list, eigvec_list, _op_index, _time_segment, dt, init, nTime, kernel_obs); return;
+        case 3: piecewise_eigen_fixed<3>(eigval_list, eigvec_list, _op_index, _time_segment, dt, init, nTime, kernel_obs); return;
+        case 4: piecewise_eigen_fixed<4>(eigval_list, eigvec_list, _op_index, _time_segment, dt, init, nTime, kernel_obs); return;
+        case 6: piecewise_eigen_fixed<6>(eigval_list, eigvec_list, _op_index, _time_segment, dt, init, nTime, kernel_obs); return;
+        case 8: piecewise_eigen_fixed<8>(eigval_list, eigvec_list, _op_index, _time_segment, dt, init, nTime, kernel_obs); return;
+        case 9: piecewise_eigen_fixed<9>(eigval_list, eigvec_list, _op_index, _time_segment, dt, init, nTime, kernel_obs); return;
+        default: break;
+    }
+
+    for(int i=1; i<_time_list.size(); ++i)
+    {
+        cx_vec state_i = init;
+        for(int j=0; j<_op_index.size(); ++j)
+        {
+            int k = _op_index[j];
+            double tau = _time_segment[j]*dt*i;
+            cx_vec phase = exp( -1.0*II*tau*conv_to<cx_vec>::from(eigval_list[k]) );
+            state_i = eigvec_list[k] * ( phase % (eigvec_list[k].t()*state_i) );
+        }
+        kernel_obs.observe(i, state_i);
+    }
+}
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ FloquetVectorEvolution
+FloquetVectorEvolution::FloquetVectorEvolution(const vector<QuantumOperator>& op_list, const vector<double>& time_segment, double period, const QuantumState& st)
+{
+   index_operators(op_list, _op_list, _op_index);
+   _time_segment = time_segment;
+   _period = period;
+   _init_state = st;
+   _state_dimension = st.getDimension()*st.getDimension();
+}
+
+vec FloquetVectorEvolution::getQuasiEnergies() const
+{
+/// lambda = exp(-i epsilon period), with epsilon in (-pi/period, pi/period].
+    vec res(_floquet_eigval.n_elem);
+    for(int k=0; k<_floquet_eigval.n_elem; ++k)
+        res(k) = -1.0*arg(_floquet_eigval(k)) / _period;
+    return res;
+}
+
+void FloquetVectorEvolution::make_floquet_operator()
+{
+    int op_num = _op_list.size();
+    _eigval_list.resize(op_num);
+    _eigvec_list.resize(op_num);
+    for(int k=0; k<op_num; ++k)
+        eig_sym(_eigval_list[k], _eigvec_list[k], _op_list[k].getMatrix());
+
+    int dim = _eigvec_list[0].n_rows;
+    cx_mat uf = eye<cx_mat>(dim, dim);
+    for(int j=0; j<_op_index.size(); ++j)
+    {
+        int k = _op_index[j];
+        double tau = _time_segment[j]*_period;
+        cx_vec phase = exp( -1.0*II*tau*conv_to<cx_vec>::from(_eigval_list[k]) );
+        uf = _eigvec_list[k] * diagmat(phase) * _eigvec_list[k].t() * uf;
+    }
+
+    // U_F is normal, so its complex Schur form T is diagonal and Q is a unitary eigenbasis,
+    // which stays orthonormal for the degenerate or nearly degenerate lambda of a symmetric sequence
+    cx_mat T;
+    schur(_floquet_eigvec, T, uf);
+    _floquet_eigval = T.diag();
+    // U_F is unitary: remove the rounding of |lambda| which would grow as lambda^N
+    for(int k=0; k<_floquet_eigval.n_elem; ++k)
+        _floquet_eigval(k) /= abs( _floquet_eigval(k) );
+}
+
+cx_vec FloquetVectorEvolution::partial_period(const cx_vec& x, double tau)
+{
+/// Apply the first tau (0 <= tau < period) of the sequence to x.
+    cx_vec state = x;
+    double t_start = 0.0;
+    for(int j=0; j<_op_index.size() && t_start < tau; ++j)
+    {
+        int k = _op_index[j];
+        double t_seg = min( _time_segment[j]*_period, tau - t_start );
+        cx_vec phase = exp( -1.0*II*t_seg*conv_to<cx_vec>::from(_eigval_list[k]) );
+        state = _eigvec_list[k] * ( phase % (_eigvec_list[k].t()*state) );
+        t_start += _time_segment[j]*_period;
+    }
+    return state;
+}
+
+void FloquetVectorEvolution::perform()
+{
+    make_floquet_operator();
+    StateListObserver store(_vector_list, _state_mat_list);
+    EvolutionObserver& obs = _observer ? *_observer : store;
+
+    cx_vec x0 = _init_state.getVector();
+    cx_vec coeff = _floquet_eigvec.t() * x0;
+    for(int i=0; i<_time_list.size(); ++i)
+    {
+        double n_period = floor( _time_list[i]/_period );
+        double tau = _time_list[i] - n_period*_period;
+        if( tau > (1.0-1e-12)*_period )
         {
-            state_i = expm_list1[j]*state_i; 
-            expm_list1[j] = expm_list[j]*expm_list1[j];
+            n_period += 1.0; tau = 0.0;
         }
-        _vector_list.push_back( state_i );
+
+        cx_vec power(coeff.n_elem);
+        for(int k=0; k<coeff.n_elem; ++k)
+            power(k) = pow( _floquet_eigval(k), n_period ) * coeff(k);
+        cx_vec state_i = _floquet_eigvec * power;
+        if( tau > 1e-12*_period )
+            state_i = partial_period(state_i, tau);
+        obs.observe(i, state_i);
     }
 }
 //}}}
@@ -90,44 +494,785 @@ void PiecewiseFullMatrixVectorEvolution::perform()
 //{{{ PiecewiseFullMatrixMatrixEvolution
 PiecewiseFullMatrixMatrixEvolution::PiecewiseFullMatrixMatrixEvolution( const vector<QuantumOperator>& left_op_list, const vector<QuantumOperator>& right_op_list, const vector<double>& time_segment, const DensityOperator& ds)
 {
-   _left_op_list = left_op_list; 
-   _right_op_list = right_op_list; 
+   index_operators(left_op_list, _left_op_list, _left_op_index);
+   index_operators(right_op_list, _right_op_list, _right_op_index);
    _time_segment = time_segment;
    _density_matrix = ds;
    _init_state = ds;
    _state_dimension = ds.getDimension()*ds.getDimension();
 }
 
+template<int D>
+static void piecewise_matrix_fixed(const vector<cx_mat>& left_expm_list, const vector<cx_mat>& right_expm_list, const vector<int>& left_key_index, const vector<int>& right_key_index, const cx_mat& rho0, size_t nTime, EvolutionObserver& obs)
+{
+/// The same scheme as PiecewiseFullMatrixMatrixEvolution::perform, on stack-sized D x D blocks.
+    const int nLeft = left_expm_list.size(), nRight = right_expm_list.size();
+    vector<cx_double> left(nLeft*D*D), right(nRight*D*D), left1, right1;
+    for(int k=0; k<nLeft; ++k)
+        for(int q=0; q<D*D; ++q) left[k*D*D+q] = left_expm_list[k](q);
+    for(int k=0; k<nRight; ++k)
+        for(int q=0; q<D*D; ++q) right[k*D*D+q] = right_expm_list[k](q);
+
+    cx_double rho[D*D], S[D*D];
+    cx_mat state_i(D, D);
+    int op_num = left_key_index.size();
+    left1 = left; right1 = right;
+    for(int i=1; i<nTime; ++i)
+    {
+        for(int q=0; q<D*D; ++q) rho[q] = rho0(q);
+        for(int j=0; j<op_num; ++j)
+        {
+            fixed_matmul<D>(&left1[ left_key_index[op_num-1-j]*D*D ], rho, S);
+            fixed_matmul<D>(S, &right1[ right_key_index[j]*D*D ], rho);
+        }
+        for(int k=0; k<nLeft; ++k)
+        {
+            fixed_matmul<D>(&left[k*D*D], &left1[k*D*D], S);
+            for(int q=0; q<D*D; ++q) left1[k*D*D+q] = S[q];
+        }
+        for(int k=0; k<nRight; ++k)
+        {
+            fixed_matmul<D>(&right[k*D*D], &right1[k*D*D], S);
+            for(int q=0; q<D*D; ++q) right1[k*D*D+q] = S[q];
+        }
+        for(int q=0; q<D*D; ++q) state_i(q) = rho[q];
+        obs.observe(i, state_i);
+    }
+}
+
 void PiecewiseFullMatrixMatrixEvolution::perform()
 {
-    _state_mat_list.push_back(_density_matrix.getMatrix());
+    StateListObserver store(_vector_list, _state_mat_list);
+    EvolutionObserver& obs = _observer ? *_observer : store;
+    cx_mat rho0 = _density_matrix.getMatrix();
+    obs.observe(0, rho0);
 
     double dt = _time_list[1] - _time_list[0];
 
     vector<cx_mat> left_expm_list, right_expm_list, expm_list1, expm_list2;
-    if (_left_op_list.size()!=_right_op_list.size()) assert(0);
+    if (_left_op_index.size()!=_right_op_index.size()) assert(0);
     
-    int op_num=_left_op_list.size();
-    for(int j=0; j<op_num; ++j)
+    vector< pair<int, double> > left_key_list, right_key_list;
+    vector<int> left_key_index, right_key_index;
+    index_segments(_left_op_index, _time_segment, left_key_list, left_key_index);
+    index_segments(_right_op_index, _time_segment, right_key_list, right_key_index);
+
+    left_expm_list.resize( left_key_list.size() );
+    right_expm_list.resize( right_key_list.size() );
+    vector<MatExp> left_expM_list, right_expM_list;
+    for(int k=0; k<_left_op_list.size(); ++k)
+        left_expM_list.push_back( MatExp(_left_op_list[k].getMatrix(), MatExp::ScalingSquaring) );
+    for(int k=0; k<_right_op_list.size(); ++k)
+        right_expM_list.push_back( MatExp(_right_op_list[k].getMatrix(), MatExp::ScalingSquaring) );
+    for(int k=0; k<left_key_list.size(); ++k)
+        left_expM_list[left_key_list[k].first].run(-1.0*II* left_key_list[k].second*dt, left_expm_list[k]);
+    for(int k=0; k<right_key_list.size(); ++k)
+        right_expM_list[right_key_list[k].first].run(1.0*II* right_key_list[k].second*dt, right_expm_list[k]);
+
+    size_t nTime = _time_list.size();
+    switch( _density_matrix.getDimension() )
     {
-        MatExp expM_left(_left_op_list[j].getMatrix(), -1.0*II* _time_segment[j]*dt, MatExp::PadeApproximation); expM_left.run();
-        MatExp expM_right(_right_op_list[j].getMatrix(), 1.0*II* _time_segment[j]*dt, MatExp::PadeApproximation); expM_right.run();
-        left_expm_list.push_back( expM_left.getResultMatrix() );
-        right_expm_list.push_back( expM_right.getResultMatrix() );
+        case 2: piecewise_matrix_fixed<2>(left_expm_list, right_expm_list, left_key_index, right_key_index, rho0, nTime, obs); return;
+        case 3: piecewise_matrix_fixed<3>(left_expm_list, right_expm_list, left_key_index, right_key_index, rho0, nTime, obs); return;
+        case 4: piecewise_matrix_fixed<4>(left_expm_list, right_expm_list, left_key_index, right_key_index, rho0, nTime, obs); return;
+        case 6: piecewise_matrix_fixed<6>(left_expm_list, right_expm_list, left_key_index, right_key_index, rho0, nTime, obs); return;
+        case 8: piecewise_matrix_fixed<8>(left_expm_list, right_expm_list, left_key_index, right_key_index, rho0, nTime, obs); return;
+        case 9: piecewise_matrix_fixed<9>(left_expm_list, right_expm_list, left_key_index, right_key_index, rho0, nTime, obs); return;
+        default: break;
     }
 
+    int op_num=_left_op_index.size();
     expm_list1 = left_expm_list; expm_list2 = right_expm_list;
     for(int i=1; i<_time_list.size(); ++i)
     {
-        cx_mat state_i = _density_matrix.getMatrix();
+        cx_mat state_i = rho0;
         for(int j=0; j<op_num; ++j)
+            state_i = expm_list1[ left_key_index[op_num-1-j] ]*state_i*expm_list2[ right_key_index[j] ];
+        for(int k=0; k<left_key_list.size(); ++k)
+            expm_list1[k] = left_expm_list[k]*expm_list1[k];
+        for(int k=0; k<right_key_list.size(); ++k)
+            expm_list2[k] = right_expm_list[k]*expm_list2[k];
+        
+        obs.observe(i, state_i);
+    }
+}
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{  PiecewiseTraceEvolution
+struct ChainPlan
+{
+    int head;    ///< key_index[0, head) multiplied one by one
+    int period;  ///< the pattern key_index[head, head+period)
+    int repeat;  ///< number of repetitions of the pattern; the rest is the tail
+};
+
+static ChainPlan plan_chain(const vector<int>& key_index)
+{
+/// The cheapest head * pattern^repeat * tail split of the sequence,
+/// costing head + period + tail - 1 + 2 log2(repeat) products.
+    int n = key_index.size();
+    ChainPlan best = {0, n, 1};
+    double best_cost = n-1;
+    for(int p=1; 2*p<=n; ++p)
+        for(int a=0; a<p && a+2*p<=n; ++a)
         {
-            state_i = expm_list1[op_num-1-j]*state_i*expm_list2[j];
-            expm_list1[op_num-1-j] = left_expm_list[op_num-1-j]*expm_list1[op_num-1-j];
-            expm_list2[j] = right_expm_list[j]*expm_list2[j];
+            int e = a+p;
+            while( e<n && key_index[e] == key_index[e-p] ) ++e;
+            int r = (e-a)/p;
+            if(r < 2) continue;
+            double cost = n - r*p + p - 1 + 2.0*log(r)/log(2.0);
+            if(cost < best_cost)
+            {
+                best_cost = cost;
+                best.head = a; best.period = p; best.repeat = r;
+            }
         }
-        
-        _state_mat_list.push_back(state_i);
+    return best;
+}
+
+static cx_mat chain_product(const vector<cx_mat>& expm_list, const vector<int>& key_index, const ChainPlan& plan)
+{
+    cx_mat pattern = expm_list[ key_index[plan.head] ];
+    for(int j=plan.head+1; j<plan.head+plan.period; ++j)
+        pattern = pattern*expm_list[ key_index[j] ];
+
+    cx_mat power;
+    int r = plan.repeat;
+    while(r > 0)
+    {
+        if(r & 1)
+            power = power.is_empty() ? pattern : cx_mat(power*pattern);
+        r >>= 1;
+        if(r > 0) pattern = pattern*pattern;
+    }
+
+    for(int j=plan.head-1; j>=0; --j)
+        power = expm_list[ key_index[j] ]*power;
+    for(int j=plan.head+plan.period*plan.repeat; j<key_index.size(); ++j)
+        power = power*expm_list[ key_index[j] ];
+    return power;
+}
+
+PiecewiseTraceEvolution::PiecewiseTraceEvolution( const vector<QuantumOperator>& left_op_list, const vector<QuantumOperator>& right_op_list, const vector<double>& time_segment, const DensityOperator& ds)
+{
+   index_operators(left_op_list, _left_op_list, _left_op_index);
+   index_operators(right_op_list, _right_op_list, _right_op_index);
+   _time_segment = time_segment;
+   _is_identity = false;
+   DensityOperator rho = ds;
+   _rho_plan = KronOperatorPlan( rho.getKronProdForm() );
+   _init_state = ds;
+   _state_dimension = ds.getDimension()*ds.getDimension();
+}
+
+PiecewiseTraceEvolution::PiecewiseTraceEvolution( const vector<QuantumOperator>& left_op_list, const vector<QuantumOperator>& right_op_list, const vector<double>& time_segment, size_t dim)
+{
+   index_operators(left_op_list, _left_op_list, _left_op_index);
+   index_operators(right_op_list, _right_op_list, _right_op_index);
+   _time_segment = time_segment;
+   _is_identity = true;
+   _state_dimension = dim*dim;
+}
+
+template<class RhoApply>
+static void piecewise_trace(const vector<cx_mat>& left_hm_list, const vector<cx_mat>& right_hm_list,
+                            const vector< pair<int, double> >& left_key_list, const vector<int>& left_key_index, const ChainPlan& left_plan,
+                            const vector< pair<int, double> >& right_key_list, const vector<int>& right_key_index, const ChainPlan& right_plan,
+                            const RhoApply* rho, double scale, double dt, vec& trace_list)
+{
+/// trace_list(i) += scale * Re tr(L rho R) at t = i*dt, rho = NULL standing for the identity.
+    vector<cx_mat> left_expm_list( left_key_list.size() ), right_expm_list( right_key_list.size() );
+    vector<MatExp> left_expM_list, right_expM_list;
+    for(int k=0; k<left_hm_list.size(); ++k)
+        left_expM_list.push_back( MatExp(left_hm_list[k], MatExp::ScalingSquaring) );
+    for(int k=0; k<right_hm_list.size(); ++k)
+        right_expM_list.push_back( MatExp(right_hm_list[k], MatExp::ScalingSquaring) );
+    for(int k=0; k<left_key_list.size(); ++k)
+        left_expM_list[left_key_list[k].first].run(-1.0*II* left_key_list[k].second*dt, left_expm_list[k]);
+    for(int k=0; k<right_key_list.size(); ++k)
+        right_expM_list[right_key_list[k].first].run(1.0*II* right_key_list[k].second*dt, right_expm_list[k]);
+
+    size_t dim = left_expm_list[0].n_rows;
+    cx_mat rhoR;
+    if(rho) rhoR.set_size(dim, dim);
+
+    vector<cx_mat> expm_list1(left_key_list.size()), expm_list2(right_key_list.size());
+    for(int i=0; i<trace_list.n_elem; ++i)
+    {
+        for(int k=0; k<left_key_list.size(); ++k)
+            expm_list1[k] = i == 0 ? eye<cx_mat>(dim, dim) : cx_mat(left_expm_list[k]*expm_list1[k]);
+        for(int k=0; k<right_key_list.size(); ++k)
+            expm_list2[k] = i == 0 ? eye<cx_mat>(dim, dim) : cx_mat(right_expm_list[k]*expm_list2[k]);
+
+        cx_mat L = chain_product(expm_list1, left_key_index, left_plan);
+        cx_mat R = chain_product(expm_list2, right_key_index, right_plan);
+        if(!rho)
+            trace_list(i) += scale * real( accu(L % R.st()) );
+        else
+        {
+            for(int a=0; a<dim; ++a)
+                rho->apply(R.colptr(a), rhoR.colptr(a));
+            trace_list(i) += scale * real( accu(L % rhoR.st()) );
+        }
+    }
+}
+
+void PiecewiseTraceEvolution::perform()
+{
+/// In subspace mode, the propagators are block diagonal in the invariant subspaces of the segments
+/// (occupied_blocks, e.g. the blocks of total Sz of a secular Hamiltonian), and so is rho unless it
+/// is polarized off the z axis; the trace is then summed block by block, at sum_b d_b^3 instead of d^3.
+/// A rho which mixes the blocks is traced in the full space.
+    double dt = _time_list[1] - _time_list[0];
+    if (_left_op_index.size()!=_right_op_index.size()) assert(0);
+
+    vector< pair<int, double> > left_key_list, right_key_list;
+    vector<int> left_key_index, right_key_index;
+    index_segments(_left_op_index, _time_segment, left_key_list, left_key_index);
+    index_segments(_right_op_index, _time_segment, right_key_list, right_key_index);
+    ChainPlan left_plan = plan_chain(left_key_index), right_plan = plan_chain(right_key_index);
+
+    vector<cx_mat> left_hm_list, right_hm_list;
+    for(int k=0; k<_left_op_list.size(); ++k)
+        left_hm_list.push_back( _left_op_list[k].getMatrix() );
+    for(int k=0; k<_right_op_list.size(); ++k)
+        right_hm_list.push_back( _right_op_list[k].getMatrix() );
+    size_t dim = left_hm_list[0].n_rows;
+    double scale = _is_identity ? 1.0/dim : 1.0;
+    _trace_list = zeros<vec>( _time_list.size() );
+
+    vector<uvec> blocks;
+    vector<KronSubspaceApply> rho_blocks;
+    if(_is_subspace)
+    {
+        vector<cx_mat> hm_list(left_hm_list);
+        hm_list.insert(hm_list.end(), right_hm_list.begin(), right_hm_list.end());
+        blocks = occupied_blocks(hm_list, dim);
+        for(int b=0; b<blocks.size() && !_is_identity; ++b)
+        {
+            rho_blocks.push_back( KronSubspaceApply(_rho_plan, blocks[b]) );
+            if( !rho_blocks.back().isInvariant() )
+            {
+                blocks.clear();
+                break;
+            }
+        }
+    }
+
+    if(blocks.size() < 2)
+    {
+        KronApply rho(_rho_plan);
+        piecewise_trace(left_hm_list, right_hm_list, left_key_list, left_key_index, left_plan,
+                        right_key_list, right_key_index, right_plan, _is_identity ? NULL : &rho, scale, dt, _trace_list);
+        return;
+    }
+
+    vector<cx_mat> left_sub_list(left_hm_list.size()), right_sub_list(right_hm_list.size());
+    for(int b=0; b<blocks.size(); ++b)
+    {
+        for(int k=0; k<left_hm_list.size(); ++k)
+            left_sub_list[k] = left_hm_list[k].submat(blocks[b], blocks[b]);
+        for(int k=0; k<right_hm_list.size(); ++k)
+            right_sub_list[k] = right_hm_list[k].submat(blocks[b], blocks[b]);
+        piecewise_trace(left_sub_list, right_sub_list, left_key_list, left_key_index, left_plan,
+                        right_key_list, right_key_index, right_plan, _is_identity ? NULL : &rho_blocks[b], scale, dt, _trace_list);
+    }
+}
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{  PiecewiseTypicalityEvolution
+PiecewiseTypicalityEvolution::PiecewiseTypicalityEvolution( const vector<QuantumOperator>& left_op_list, const vector<QuantumOperator>& right_op_list, const vector<double>& time_segment, const DensityOperator& ds, int sample_num, unsigned int seed)
+{
+   index_operators(left_op_list, _left_op_list, _left_op_index);
+   index_operators(right_op_list, _right_op_list, _right_op_index);
+   _time_segment = time_segment;
+   _is_identity = false;
+   _is_single_precision = false; _is_rerun = false; _residual_tol = 1e-5;
+   DensityOperator rho = ds;
+   _rho_plan = KronOperatorPlan( rho.getKronProdForm() );
+   _dim = ds.getDimension();
+   _sample_num = sample_num;
+   _rng = seed;
+   _init_state = ds;
+   _state_dimension = _dim*_dim;
+}
+
+PiecewiseTypicalityEvolution::PiecewiseTypicalityEvolution( const vector<QuantumOperator>& left_op_list, const vector<QuantumOperator>& right_op_list, const vector<double>& time_segment, size_t dim, int sample_num, unsigned int seed)
+{
+   index_operators(left_op_list, _left_op_list, _left_op_index);
+   index_operators(right_op_list, _right_op_list, _right_op_index);
+   _time_segment = time_segment;
+   _is_identity = true;
+   _is_single_precision = false; _is_rerun = false; _residual_tol = 1e-5;
+   _dim = dim;
+   _sample_num = sample_num;
+   _rng = seed;
+   _state_dimension = _dim*_dim;
+}
+
+cx_vec PiecewiseTypicalityEvolution::random_phase_state(size_t dim)
+{
+/// exp(i theta_n) with theta_n uniform in [0, 2 pi), from a 64-bit LCG owned by the object,
+/// so that the samples of a cluster do not depend on the other users of rand().
+    cx_vec phi(dim);
+    for(size_t n=0; n<dim; ++n)
+    {
+        _rng = _rng*6364136223846793005ULL + 1442695040888963407ULL;
+        double theta = 2.0*datum::pi * (_rng >> 11) * (1.0/9007199254740992.0);
+        phi(n) = cx_double( cos(theta), sin(theta) );
+    }
+    return phi;
+}
+
+template<class T, class Apply>
+static void typicality_segments(const vector<Apply>& op_apply, const vector<int>& op_index, const vector<double>& time_segment,
+                                double t_unit, bool is_backward, size_t dim, BlockKrylovWorkspace<T>& wsp, cx_mat& psi)
+{
+/// psi <- exp(-i H_j tau_j) psi over all the segments, tau_j = time_segment[j]*t_unit, j running
+/// forward or backward. The Krylov tolerance is kept above the rounding level of T.
+/// All the segments share the Krylov basis of wsp.
+    int op_num = op_index.size();
+    double tol = max(1e-12, 10.0*numeric_limits<T>::epsilon());
+    cx_mat res;
+    for(int k=0; k<op_num; ++k)
+    {
+        int j = is_backward ? op_num-1-k : k;
+        BlockKrylovExpv<Apply, T> expv_run(op_apply[ op_index[j] ], dim, -1.0*II);
+        expv_run.setTolerance(tol);
+        expv_run.setWorkspace(wsp);
+        expv_run.run(psi, time_segment[j]*t_unit, res); psi.swap(res);
+    }
+}
+
+template<class T, class Apply>
+static void typicality_samples(const vector<Apply>& left_apply, const vector<int>& left_index,
+                               const vector<Apply>& right_apply, const vector<int>& right_index,
+                               const vector<double>& time_segment, double dt, size_t dim,
+                               const cx_mat& phi, const cx_mat& chi, BlockKrylovWorkspace<T>& wsp, mat& samples)
+{
+    cx_mat psi1, psi2;
+    for(int i=0; i<samples.n_rows; ++i)
+    {
+        // L phi: the last left segment acts first
+        psi1 = phi;
+        if(i > 0) typicality_segments<T>(left_apply, left_index, time_segment, dt*i, true, dim, wsp, psi1);
+        // R^+ rho phi: R_j^+ = exp(-i H tau), the first right segment acts first
+        psi2 = chi;
+        if(i > 0) typicality_segments<T>(right_apply, right_index, time_segment, dt*i, false, dim, wsp, psi2);
+        for(int s=0; s<samples.n_cols; ++s)
+            samples(i, s) = real( cdot(psi2.col(s), psi1.col(s)) );
+    }
+}
+
+template<class Apply>
+static bool typicality_run(const vector<Apply>& left_apply, const vector<int>& left_index,
+                           const vector<Apply>& right_apply, const vector<int>& right_index,
+                           const vector<double>& time_segment, double dt, size_t dim, const cx_mat& phi, const cx_mat& chi,
+                           bool is_single_precision, double residual_tol, mat& samples)
+{
+/// The samples in single precision with the residual check, or in double; returns true
+/// if the single-precision samples failed the check and were rerun in double.
+    size_t nTime = samples.n_rows;
+    // one Krylov basis per precision for all the segments and time points
+    BlockKrylovWorkspace<float>  float_wsp;
+    BlockKrylovWorkspace<double> double_wsp;
+    bool is_rerun = false;
+    if(is_single_precision)
+    {
+        typicality_samples<float>(left_apply, left_index, right_apply, right_index, time_segment, dt, dim, phi, chi, float_wsp, samples);
+
+        cx_mat psi1 = phi.col(0), psi2 = chi.col(0);
+        typicality_segments<double>(left_apply, left_index, time_segment, dt*(nTime-1), true, dim, double_wsp, psi1);
+        typicality_segments<double>(right_apply, right_index, time_segment, dt*(nTime-1), false, dim, double_wsp, psi2);
+        double residual = fabs( real( cdot(psi2.col(0), psi1.col(0)) ) - samples(nTime-1, 0) );
+        is_rerun = residual > residual_tol;
+    }
+    if(!is_single_precision || is_rerun)
+        typicality_samples<double>(left_apply, left_index, right_apply, right_index, time_segment, dt, dim, phi, chi, double_wsp, samples);
+    return is_rerun;
+}
+
+void PiecewiseTypicalityEvolution::perform()
+{
+/// All the samples go through the segments together, as the columns of one block.
+/// In subspace mode, the invariant subspaces of the segments are found from the plans
+/// (occupied_blocks) and each block is sampled on its own, by random-phase vectors of the block
+/// evolved by the restricted operators (KronSubspaceApply); the sample s of the trace is the sum
+/// of the samples s of the blocks. A rho which mixes the blocks is sampled in the full space.
+    double dt = _time_list[1] - _time_list[0];
+    if (_left_op_index.size()!=_right_op_index.size()) assert(0);
+    size_t nTime = _time_list.size();
+
+    vector<KronApply> left_apply, right_apply;
+    for(int k=0; k<_left_op_list.size(); ++k)
+    {
+        assert( _left_op_list[k].isCompiled() );
+        left_apply.push_back( KronApply(_left_op_list[k].getPlan()) );
+    }
+    for(int k=0; k<_right_op_list.size(); ++k)
+    {
+        assert( _right_op_list[k].isCompiled() );
+        right_apply.push_back( KronApply(_right_op_list[k].getPlan()) );
+    }
+
+    vector<uvec> blocks;
+    vector<KronSubspaceApply> rho_blocks;
+    if(_is_subspace)
+    {
+        vector<KronOperatorPlan> plan_list;
+        for(int k=0; k<_left_op_list.size(); ++k)
+            plan_list.push_back( _left_op_list[k].getPlan() );
+        for(int k=0; k<_right_op_list.size(); ++k)
+            plan_list.push_back( _right_op_list[k].getPlan() );
+        blocks = occupied_blocks(plan_list, _dim);
+        for(int b=0; b<blocks.size() && !_is_identity; ++b)
+        {
+            rho_blocks.push_back( KronSubspaceApply(_rho_plan, blocks[b]) );
+            if( !rho_blocks.back().isInvariant() )
+            {
+                blocks.clear();
+                break;
+            }
+        }
+    }
+
+    mat samples(nTime, _sample_num);
+    _is_rerun = false;
+    if(blocks.size() < 2)
+    {
+        KronApply rho(_rho_plan);
+        cx_mat phi(_dim, _sample_num), chi(_dim, _sample_num);
+        for(int s=0; s<_sample_num; ++s)
+        {
+            phi.col(s) = random_phase_state(_dim);
+            chi.col(s) = _is_identity ? cx_vec(phi.col(s) / (double) _dim) : cx_vec(rho * cx_vec(phi.col(s)));
+        }
+        _is_rerun = typicality_run(left_apply, _left_op_index, right_apply, _right_op_index, _time_segment, dt, _dim,
+                                   phi, chi, _is_single_precision, _residual_tol, samples);
+    }
+    else
+    {
+        samples.zeros();
+        mat block_samples(nTime, _sample_num);
+        for(int b=0; b<blocks.size(); ++b)
+        {
+            vector<KronSubspaceApply> left_sub, right_sub;
+            for(int k=0; k<_left_op_list.size(); ++k)
+                left_sub.push_back( KronSubspaceApply(_left_op_list[k].getPlan(), blocks[b]) );
+            for(int k=0; k<_right_op_list.size(); ++k)
+                right_sub.push_back( KronSubspaceApply(_right_op_list[k].getPlan(), blocks[b]) );
+
+            size_t n = blocks[b].n_elem;
+            cx_mat phi(n, _sample_num), chi(n, _sample_num);
+            for(int s=0; s<_sample_num; ++s)
+            {
+                phi.col(s) = random_phase_state(n);
+                if(_is_identity)
+                    chi.col(s) = phi.col(s) / (double) _dim;
+                else
+                    rho_blocks[b].apply(phi.colptr(s), chi.colptr(s));
+            }
+            if( typicality_run(left_sub, _left_op_index, right_sub, _right_op_index, _time_segment, dt, n,
+                               phi, chi, _is_single_precision, _residual_tol, block_samples) )
+                _is_rerun = true;
+            samples += block_samples;
+        }
+    }
+
+    _trace_list = mean(samples, 1);
+    if(_sample_num > 1)
+        _error_list = stddev(samples, 0, 1) / sqrt( (double) _sample_num );
+    else
+        _error_list = zeros<vec>(nTime);
+}
+//}}}
+////////////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{  PiecewiseTrotterVectorEvolution
+struct TrotterGate
+{
+    vector<size_t> site;  ///< the spin (or the two spins, in ascending order) the gate acts on
+    vector<size_t> dim;   ///< their dimensions
+    size_t m, s1, mid, s2, n; ///< the strides of kron_gate_apply
+    cx_mat h;             ///< the local Hamiltonian, in the basis p*s2+q
+    vec    E;             ///< h = V diag(E) V^+
+    cx_mat V;
+};
+
+static bool make_trotter_gates(const KronOperatorPlan& plan, vector<TrotterGate>& gates, double& shift)
+{
+/// Groups the terms of the plan by the spins they act on; shift is the sum of the identity terms.
+/// Returns false if a term acts on more than two spins, the operator having no gate form then.
+    const vector<double>&    coeff      = plan.getCoeffList();
+    const vector<size_t>&    pos_offset = plan.getPosOffset();
+    const vector<size_t>&    pos_list   = plan.getPosList();
+    const vector<size_t>&    mat_offset = plan.getMatOffset();
+    const vector<cx_double>& matC       = plan.getMatC();
+    const vector<size_t>&    spin_dim   = plan.getSpinDimList();
+    const vector<size_t>&    nspin_m    = plan.getStrideM();
+    const vector<size_t>&    nspin_n    = plan.getStrideN();
+
+    shift = 0.0;
+    map< pair<size_t, size_t>, int > gate_pos;
+    gates.clear();
+    for(int t=0; t<plan.getTermNum(); ++t)
+    {
+        size_t f0 = pos_offset[t], nbody = pos_offset[t+1]-f0;
+        if(nbody == 0)
+        {
+            shift += coeff[t];
+            continue;
+        }
+        if(nbody > 2)
+        {
+            gates.clear();
+            return false;
+        }
+
+        size_t k = pos_list[f0], l = nbody == 2 ? pos_list[f0+1] : k;
+        cx_mat A(&matC[ mat_offset[f0] ], spin_dim[k], spin_dim[k]);
+        cx_mat h_t = coeff[t]*A;
+        if(nbody == 2)
+        {
+            cx_mat B(&matC[ mat_offset[f0+1] ], spin_dim[l], spin_dim[l]);
+            h_t = k < l ? cx_mat( coeff[t]*kron(A, B) ) : cx_mat( coeff[t]*kron(B, A) );
+            if(l < k) swap(k, l);
+        }
+
+        pair<size_t, size_t> key = make_pair(k, l);
+        if(gate_pos.find(key) == gate_pos.end())
+        {
+            TrotterGate gate;
+            gate.site.push_back(k); gate.dim.push_back(spin_dim[k]);
+            if(l != k)
+            {
+                gate.site.push_back(l); gate.dim.push_back(spin_dim[l]);
+            }
+            gate.m   = nspin_m[k];
+            gate.s1  = spin_dim[k];
+            gate.mid = l != k ? nspin_m[l]/(nspin_m[k]*spin_dim[k]) : 1;
+            gate.s2  = l != k ? spin_dim[l] : 1;
+            gate.n   = nspin_n[l];
+            gate.h   = zeros<cx_mat>(h_t.n_rows, h_t.n_cols);
+            gate_pos[key] = gates.size();
+            gates.push_back(gate);
+        }
+        gates[ gate_pos[key] ].h += h_t;
+    }
+
+    for(int g=0; g<gates.size(); ++g)
+        eig_sym(gates[g].E, gates[g].V, gates[g].h);
+    return true;
+}
+
+static cx_mat embed_gate(const TrotterGate& gate, const vector<size_t>& site, const vector<size_t>& dim)
+{
+/// The gate as an operator on the spins site (ascending, containing those of the gate),
+/// the identity on the others.
+    size_t nsite = site.size(), total = 1;
+    for(size_t q=0; q<nsite; ++q) total *= dim[q];
+    vector<int> loc(nsite, -1);
+    for(size_t q=0; q<nsite; ++q)
+        for(size_t e=0; e<gate.site.size(); ++e)
+            if(gate.site[e] == site[q]) loc[q] = e;
+
+    umat digit(nsite, total);
+    for(size_t r=0; r<total; ++r)
+    {
+        size_t x = r;
+        for(int q=nsite-1; q>=0; --q)
+        {
+            digit(q, r) = x % dim[q]; x /= dim[q];
+        }
+    }
+
+    cx_mat M = zeros<cx_mat>(total, total);
+    for(size_t c=0; c<total; ++c)
+        for(size_t r=0; r<total; ++r)
+        {
+            bool is_same = true;
+            size_t lr = 0, lc = 0;
+            for(size_t q=0; q<nsite && is_same; ++q)
+                if(loc[q] < 0)
+                    is_same = digit(q, r) == digit(q, c);
+                else
+                {
+                    lr = lr*dim[q] + digit(q, r);
+                    lc = lc*dim[q] + digit(q, c);
+                }
+            if(is_same) M(r, c) = gate.h(lr, lc);
+        }
+    return M;
+}
+
+static double trotter_max_step(const vector<TrotterGate>& gates, int order, double tol)
+{
+/// tau_max from err(tau) = tau^order * beta * Lambda^{order-1} / 12 = tol.
+    double beta = 0.0, lambda = 0.0;
+    for(int i=0; i<gates.size(); ++i)
+    {
+        lambda = max( lambda, max( abs(gates[i].E) ) );
+        for(int j=i+1; j<gates.size(); ++j)
+        {
+            vector<size_t> site, dim;
+            for(int e=0; e<gates[i].site.size(); ++e)
+            {
+                site.push_back(gates[i].site[e]); dim.push_back(gates[i].dim[e]);
+            }
+            bool is_overlap = false;
+            for(int e=0; e<gates[j].site.size(); ++e)
+            {
+                vector<size_t>::iterator it = find(site.begin(), site.end(), gates[j].site[e]);
+                if(it != site.end())
+                    is_overlap = true;
+                else
+                {
+                    size_t q = upper_bound(site.begin(), site.end(), gates[j].site[e]) - site.begin();
+                    site.insert(site.begin()+q, gates[j].site[e]);
+                    dim.insert(dim.begin()+q, gates[j].dim[e]);
+                }
+            }
+            if(!is_overlap) continue;
+            cx_mat hi = embed_gate(gates[i], site, dim), hj = embed_gate(gates[j], site, dim);
+            beta += norm(hi*hj - hj*hi, "fro");
+        }
+    }
+    if(beta == 0.0) return datum::inf;
+    return pow( 12.0*tol / ( beta*pow(lambda, order-1) ), 1.0/order );
+}
+
+static void trotter_gate_exp(const vector<TrotterGate>& gates, double tau, vector<cx_mat>& U)
+{
+/// The exponentials of the S2(tau) sweep: exp(-i h_g tau/2), the last gate exp(-i h_G tau).
+    U.resize(gates.size());
+    for(int g=0; g<gates.size(); ++g)
+    {
+        double t = g+1 < gates.size() ? 0.5*tau : tau;
+        U[g] = gates[g].V * diagmat( exp( -1.0*II*t*conv_to<cx_vec>::from(gates[g].E) ) ) * gates[g].V.t();
+    }
+}
+
+static void trotter_sweep(const vector<TrotterGate>& gates, const vector<cx_mat>& U, cx_vec& x)
+{
+/// x <- S2(tau) x, U being given by trotter_gate_exp(gates, tau, U).
+    int G = gates.size();
+    for(int g=0; g<G; ++g)
+        kron_gate_apply(gates[g].m, gates[g].s1, gates[g].mid, gates[g].s2, gates[g].n, U[g].memptr(), x.memptr());
+    for(int g=G-2; g>=0; --g)
+        kron_gate_apply(gates[g].m, gates[g].s1, gates[g].mid, gates[g].s2, gates[g].n, U[g].memptr(), x.memptr());
+}
+
+PiecewiseTrotterVectorEvolution::PiecewiseTrotterVectorEvolution(const vector<QuantumOperator>& op_list, const vector<double>& time_segment, const QuantumState& st, int order)
+{
+   index_operators(op_list, _op_list, _op_index);
+   _time_segment = time_segment;
+   _init_state = st;
+   _state_dimension = st.getDimension()*st.getDimension();
+   assert(order == 2 || order == 4);
+   _order = order;
+   _tol = 1e-6;
+   _step_num = 0;
+}
+
+void PiecewiseTrotterVectorEvolution::perform()
+{
+    StateListObserver store(_vector_list, _state_mat_list);
+    double dt = _time_list[1] - _time_list[0];
+    double seq_len = 0.0;
+    for(int j=0; j<_time_segment.size(); ++j) seq_len += _time_segment[j];
+    FrameObserver frame_obs(_observer ? *_observer : store, _frame, seq_len*dt);
+    EvolutionObserver& obs = _is_interaction_picture ? frame_obs : (_observer ? *_observer : store);
+    cx_vec init = _init_state.getVector();
+    obs.observe(0, init);
+
+    int op_num = _op_list.size();
+    vector< vector<TrotterGate> > gate_list(op_num);
+    vector<double> shift(op_num), tau_max(op_num);
+    vector<bool> is_gate(op_num);
+    vector<KronApply> op_apply;
+    for(int k=0; k<op_num; ++k)
+    {
+        assert( _op_list[k].isCompiled() );
+        is_gate[k] = make_trotter_gates(_op_list[k].getPlan(), gate_list[k], shift[k]);
+        tau_max[k] = is_gate[k] ? trotter_max_step(gate_list[k], _order, _tol) : 0.0;
+        op_apply.push_back( KronApply(_op_list[k].getPlan()) );
+    }
+
+    vector< pair<int, double> > key_list;
+    vector<int> key_index;
+    index_segments(_op_index, _time_segment, key_list, key_index);
+
+    const double p = 1.0/(4.0 - pow(4.0, 1.0/3.0));
+    int nKey = key_list.size();
+    vector<size_t> step_num(nKey);
+    vector< vector<cx_mat> > U1(nKey), U2(nKey);
+    _step_num = 0;
+    for(int i=1; i<_time_list.size(); ++i)
+    {
+        // the gates of one step, for each distinct segment of this time point
+        for(int q=0; q<nKey; ++q)
+        {
+            int k = key_list[q].first;
+            if(!is_gate[k]) continue;
+            double T = key_list[q].second*dt*i;
+            step_num[q] = tau_max[k] < T ? (size_t) ceil(T/tau_max[k]) : 1;
+            double tau = T/step_num[q];
+            if(_order == 2)
+                trotter_gate_exp(gate_list[k], tau, U1[q]);
+            else
+            {
+                trotter_gate_exp(gate_list[k], p*tau, U1[q]);
+                trotter_gate_exp(gate_list[k], (1.0-4.0*p)*tau, U2[q]);
+            }
+        }
+
+        cx_vec state_i = init;
+        double phase = 0.0;
+        for(int j=0; j<key_index.size(); ++j)
+        {
+            int q = key_index[j], k = key_list[q].first;
+            if(!is_gate[k])
+            {
+                // no gate form: the segment is propagated by Krylov instead
+                vec t_seg(2);
+                t_seg(0) = 0.0; t_seg(1) = key_list[q].second*dt*i;
+                KrylovExpv<KronApply> expv(op_apply[k], state_i.n_elem, -1.0*II);
+                expv.setHermitian(true);
+                expv.setTolerance(_tol);
+                expv.setWorkspace( WorkspaceArena::local().getKrylovWorkspace() );
+                cx_mat w;
+                expv.run(state_i, t_seg, w);
+                state_i = w.col(1);
+                continue;
+            }
+            const vector<TrotterGate>& gates = gate_list[k];
+            for(size_t r=0; r<step_num[q]; ++r)
+            {
+                if(_order == 2)
+                    trotter_sweep(gates, U1[q], state_i);
+                else
+                {
+                    trotter_sweep(gates, U1[q], state_i); trotter_sweep(gates, U1[q], state_i);
+                    trotter_sweep(gates, U2[q], state_i);
+                    trotter_sweep(gates, U1[q], state_i); trotter_sweep(gates, U1[q], state_i);
+                }
+            }
+            _step_num += step_num[q];
+            phase += shift[k]*key_list[q].second*dt*i;
+        }
+        state_i *= exp(-1.0*II*phase);
+        obs.observe(i, state_i);
     }
 }
 //}}}
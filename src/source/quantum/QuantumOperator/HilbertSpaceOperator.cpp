@@ -36,6 +36,7 @@ void HilbertSpaceOperator::make()
     _kron_form = _interaction_list[0].getSumKronProd();
     for(int i=1; i<_interaction_list.size(); ++i)
         _kron_form = _kron_form + _interaction_list[i].getSumKronProd();
+    invalidate_plan();
 }
 //}}}
 ////////////////////////////////////////////////////////////////////////////////
@@ -17,7 +17,13 @@ LiouvilleSpaceOperator::LiouvilleSpaceOperator(const HilbertSpaceOperator& op, M
     _expan.op = op;
     _expan.func = func;
 
-    _kron_form = Expand(_expan.op.getKronProdForm(), func);
+    // factors stay d x d on the row/column modes of rho, so the plan applies the
+    // superoperator matrix-free with the same vec(rho) layout as Expand
+    _kron_form = LiouvilleExpand(_expan.op.getKronProdFormRef(), func);
+    invalidate_plan();
+    // _dim_list holds the 2n modes (d_0, d_0, d_1, d_1, ...) instead of the n dimensions d_k^2;
+    // its readers are _dimension below (unchanged), operator +/- (which copy it from the
+    // first operand) and KronOperatorPlan (through the SumKronProd, for the mode strides)
     _dim_list = _kron_form.getDimList();
     _dimension = 1;
     //for( auto d : _dim_list)
@@ -42,7 +48,8 @@ Liouvillian::Liouvillian(const QuantumOperator& op)
     _is_expanded = false;
     _dimension = op.getDimension();
     _dim_list = op.getDimList();
-    _kron_form = op.getKronProdForm();
+    _kron_form = op.getKronProdFormRef();
+    invalidate_plan();
 }
 
 Liouvillian::~Liouvillian()
@@ -30,14 +30,23 @@ void QuantumOperator::saveMatrix(string name)
 }
 #endif
 
+const KronOperatorPlan& QuantumOperator::getPlan() const
+{
+    if(!_is_plan_ready)
+    {
+        _plan = KronOperatorPlan(_kron_form);
+        _is_plan_ready = true;
+    }
+    return _plan;
+}
+
 QuantumOperator operator + (const QuantumOperator& op1, const QuantumOperator& op2)
 {
     QuantumOperator res;
     res._dim_list = op1._dim_list;
     res._dimension = op1._dimension;
     SumKronProd skp1 =  op1.getKronProdForm();
-    SumKronProd skp2 =  op2.getKronProdForm();
-    res._kron_form = skp1 + skp2;
+    res._kron_form = skp1 + op2.getKronProdFormRef();
     return res;
 }
 
@@ -19,10 +19,11 @@ cSPIN::cSPIN(arma::vec coord, string isotope_str)
     //cSPINDATA SPIN_DATABASE=cSPINDATA();
     coordinate = coord;
     isotope = isotope_str;
-    multiplicity = SPIN_DATABASE.getData(isotope_str).multiplicity;
-    gamma = SPIN_DATABASE.getData(isotope_str).gamma;
-    omegaQ = SPIN_DATABASE.getData(isotope_str).omegaQ;
-    eta = SPIN_DATABASE.getData(isotope_str).eta;
+    SpinProperty prop = SPIN_DATABASE.getData(isotope_str);
+    multiplicity = prop.multiplicity;
+    gamma = prop.gamma;
+    omegaQ = prop.omegaQ;
+    eta = prop.eta;
 }
 
 cx_mat cSPIN::sx() const
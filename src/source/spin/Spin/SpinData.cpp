@@ -16,6 +16,16 @@ cSPINDATA::cSPINDATA()
     data["E"]=ELECTRON;
     data["NVe"]=NVE;
 }
+
+SpinProperty cSPINDATA::getData(const string& name) const
+{
+/// Unknown names give a zero-filled SpinProperty without inserting into the table.
+    map<string, SpinProperty>::const_iterator it = data.find(name);
+    if( it != data.end() )
+        return it->second;
+    SpinProperty none = {0, 0.0, 0.0, 0.0};
+    return none;
+}
 //}}}
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -160,9 +160,10 @@ vector<cSPIN> cSpinCluster::getCluster(size_t order, size_t index) const
 vector<vec> cSpinCluster::getClusterCoord(size_t order, size_t index) const
 {
     vector<vec> coord_list;
-    vector<cSPIN> sl = getCluster(order, index);
-    for(int i=0; i<sl.size(); ++i)
-        coord_list.push_back( sl[i].get_coordinate() );
+    uvec idx = getClusterIndex(order, index).getIndex();
+    const cSpinStore& store = _spin_collection.getSpinStore();
+    for(int i=0; i<idx.n_elem; ++i)
+        coord_list.push_back( store.get_coordinate( idx[i] ) );
     return coord_list;
 }
 
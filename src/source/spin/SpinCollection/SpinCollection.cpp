@@ -22,26 +22,23 @@ cSpinCollection::~cSpinCollection()
 
 vector<cSPIN> cSpinCollection::getSpinList(const cClusterIndex& clst) const
 {
-    vector<cSPIN> sl;
-    uvec id = clst.getIndex();
-    for(int i=0; i<id.size(); ++i)
-        sl.push_back(_spin_list[ id[i] ]);
-    return sl;
+    return _spin_store.getSpinList( clst.getIndex() );
 }
 void cSpinCollection::make()
 {
 /// call the 'generate' method of the cSpinSource to generate _spin_list.
     _spin_list= _source->generate();
+    _spin_store = cSpinStore(_spin_list);
 
     size_t nspin=_spin_list.size();
     mat d(nspin, nspin); d.zeros();
-    for (int i=0; i<_spin_list.size(); ++i)
+    for (int i=0; i<nspin; ++i)
     {
-        for (int j=i; j<_spin_list.size(); ++j)
+        for (int j=i; j<nspin; ++j)
         {
             //d(i,j)=distance(_spin_list[i].get_coordinate(),
             //                _spin_list[j].get_coordinate() );
-            d(i,j)=spin_distance(_spin_list[i], _spin_list[j]);
+            d(i,j)=spin_distance(_spin_store, i, j);
         }
     }
     d =d+d.t();
@@ -58,9 +55,14 @@ sp_mat cSpinCollection::getConnectionMatrix(double threshold) const
 
 mat cSpinCollection::getCoordinateMat() const
 {
-    mat res=zeros<mat> (_spin_list.size(), 3);
-    for(int i=0; i<_spin_list.size(); ++i)
-        res.row(i) = trans( _spin_list[i].get_coordinate() );
+    size_t nspin=_spin_store.getSpinNum();
+    mat res(nspin, 3);
+    for(int i=0; i<nspin; ++i)
+    {
+        res(i, 0) = _spin_store.get_x(i);
+        res(i, 1) = _spin_store.get_y(i);
+        res(i, 2) = _spin_store.get_z(i);
+    }
     return res;
 }
 
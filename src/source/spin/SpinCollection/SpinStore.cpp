@@ -0,0 +1,88 @@
+#include <armadillo>
+#include "include/spin/SpinStore.h"
+
+using namespace std;
+using namespace arma;
+
+////////////////////////////////////////////////////////////////////////////////
+//{{{ cSpinStore
+cSpinStore::cSpinStore()
+{ //LOG(INFO) << "Default constructor: cSpinStore.";
+}
+
+cSpinStore::cSpinStore(const vector<cSPIN>& spin_list)
+{
+    reserve( spin_list.size() );
+    for(int i=0; i<spin_list.size(); ++i)
+        append( spin_list[i] );
+}
+
+cSpinStore::~cSpinStore()
+{ //LOG(INFO) << "Default destructor: cSpinStore.";
+}
+
+void cSpinStore::reserve(size_t n)
+{
+    _x.reserve(n); _y.reserve(n); _z.reserve(n);
+    _isotope_id.reserve(n);
+}
+
+void cSpinStore::append(const cSPIN& spin)
+{
+    vec coord = spin.get_coordinate();
+    _x.push_back( coord[0] );
+    _y.push_back( coord[1] );
+    _z.push_back( coord[2] );
+    _isotope_id.push_back( intern(spin) );
+}
+
+int cSpinStore::intern(const cSPIN& spin)
+{
+/// The isotope table is tiny (a few species per bath), so a linear scan is cheaper than a map.
+/// Two spins share an id only if the name and all the properties agree.
+    for(int id=0; id<_isotope_name.size(); ++id)
+        if( _isotope_name[id] == spin.get_isotope()
+                && _multiplicity_table[id] == spin.get_multiplicity()
+                && _gamma_table[id] == spin.get_gamma()
+                && _omegaQ_table[id] == spin.get_omegaQ()
+                && _eta_table[id] == spin.get_eta() )
+            return id;
+
+    _isotope_name.push_back( spin.get_isotope() );
+    _multiplicity_table.push_back( spin.get_multiplicity() );
+    _gamma_table.push_back( spin.get_gamma() );
+    _omegaQ_table.push_back( spin.get_omegaQ() );
+    _eta_table.push_back( spin.get_eta() );
+    return _isotope_name.size()-1;
+}
+
+vec cSpinStore::get_coordinate(size_t i) const
+{
+    vec res(3);
+    res[0] = _x[i]; res[1] = _y[i]; res[2] = _z[i];
+    return res;
+}
+
+cSPIN cSpinStore::getSpin(size_t i) const
+{
+/// Rebuild a cSPIN object from the tables, without looking up SPIN_DATABASE.
+    int id = _isotope_id[i];
+    cSPIN spin;
+    spin.set_coordinate( get_coordinate(i) );
+    spin.set_isotope( _isotope_name[id] );
+    spin.set_multiplicity( _multiplicity_table[id] );
+    spin.set_gamma( _gamma_table[id] );
+    spin.set_omegaQ( _omegaQ_table[id] );
+    spin.set_eta( _eta_table[id] );
+    return spin;
+}
+
+vector<cSPIN> cSpinStore::getSpinList(const uvec& idx) const
+{
+    vector<cSPIN> sl; sl.reserve( idx.n_elem );
+    for(int i=0; i<idx.n_elem; ++i)
+        sl.push_back( getSpin( idx[i] ) );
+    return sl;
+}
+//}}}
+////////////////////////////////////////////////////////////////////////////////
@@ -13,7 +13,7 @@ cSpinInteraction::cSpinInteraction()
 
 cSpinInteraction::cSpinInteraction(const vector<cSPIN>& spin_list)
 { //LOG(INFO) << "Constructor: cSpinInteraction with spin_list.";
-    _spin_list=spin_list;
+    _spin_store=cSpinStore(spin_list);
 }
 
 cSpinInteraction::~cSpinInteraction()
@@ -26,21 +26,19 @@ void cSpinInteraction::make()
     assert(_domain.getLength() == _coeff.getLength());
     assert(_form.get_nTerm() == _coeff.get_nCoeff() );
 
-    if( !_spin_list.empty() )
-        for(int i=0; i<_spin_list.size(); ++i)
-        {
-            cSPIN spin=_spin_list[i];
-            _dim_list.push_back( spin.get_dimension() );
-        }
+    _dim_list.clear();
+    for(int i=0; i<_spin_store.getSpinNum(); ++i)
+        _dim_list.push_back( _spin_store.get_dimension(i) );
     //if( !_spin_list.empty() )
     //    for(auto spin: _spin_list)
     //        _dim_list.push_back( spin.get_dimension() );
 
-    INDEX_LIST  idxList=_domain.getIndexList();
-    MAT_LIST    matList=_form.getMatList();
-    COEFF_LIST coefList=_coeff.getCoeffList();
+    const INDEX_LIST&  idxList=_domain.getIndexList();
+    const MAT_LIST&    matList=_form.getMatList();
+    const COEFF_LIST& coefList=_coeff.getCoeffList();
 
     vector<KronProd> kronProd_list;
+    kronProd_list.reserve( _domain.getLength()*_form.get_nTerm() );
     size_t domainSize = _domain.getLength();
     int nTerm = _form.get_nTerm();
     for(int i=0; i<domainSize; ++i)
@@ -54,6 +52,14 @@ void cSpinInteraction::make()
     _sum_kron_prod=SumKronProd(kronProd_list);
 }
 
+void cSpinInteraction::make_secular()
+{
+/// Drop the non-secular part of the coefficients and remake the interaction,
+/// so that it conserves the Sz of each species.
+    _coeff.truncate_secular(_domain, _spin_store);
+    make();
+}
+
 ostream&  operator << (ostream& outs, cSpinInteraction& interaction)
 {
     cout << interaction._sum_kron_prod << endl;
@@ -70,13 +76,13 @@ SpinDipolarInteraction::SpinDipolarInteraction()
 { //LOG(INFO) << "Default constructor: SpinDipolarInteraction.";
 }
 
-SpinDipolarInteraction::SpinDipolarInteraction(const vector<cSPIN>& spin_list)
+SpinDipolarInteraction::SpinDipolarInteraction(const vector<cSPIN>& spin_list, bool is_secular)
 { //LOG(INFO) << "Constructor: SpinDipolarInteraction with spin_list";
-    _spin_list=spin_list;
+    _spin_store=cSpinStore(spin_list);
 
-    _domain=SpinPair(spin_list);
-    _form=TwoSpinInteractionForm(_domain);
-    _coeff=DipolarInteractionCoeff(_domain);
+    _domain=SpinPair( spin_list.size() );
+    _form=TwoSpinInteractionForm(_domain, _spin_store);
+    _coeff=DipolarInteractionCoeff(_domain, _spin_store, is_secular);
     
     make();
 }
@@ -98,11 +104,11 @@ SpinZeemanInteraction::SpinZeemanInteraction()
 SpinZeemanInteraction::SpinZeemanInteraction(const vector<cSPIN>& spin_list, const vec& magB)
 { //LOG(INFO) << "Constructor: SpinZeemanInteraction with spin_list and magB";
 
-    _spin_list=spin_list;
+    _spin_store=cSpinStore(spin_list);
 
-    _domain=SingleSpin(spin_list);
-    _form=SingleSpinInteractionForm(_domain);
-    _coeff=ZeemanInteractionCoeff(_domain, magB);
+    _domain=SingleSpin( spin_list.size() );
+    _form=SingleSpinInteractionForm(_domain, _spin_store);
+    _coeff=ZeemanInteractionCoeff(_domain, _spin_store, magB);
     
     make();
 }
@@ -124,35 +130,46 @@ DipolarField::DipolarField()
 DipolarField::DipolarField(const vector<cSPIN>& spin_list, const cSPIN& center_spin, const PureState& state)
 { //LOG(INFO) << "Constructor: DipolarField with center spin and spin state";
 
-    _spin_list=spin_list;
+    _spin_store=cSpinStore(spin_list);
 
-    _domain=SingleSpin(spin_list);
-    _form=SingleSpinInteractionForm(_domain);
-    _coeff=DipolarFieldInteractionCoeff(_domain, center_spin, state);
+    _domain=SingleSpin( spin_list.size() );
+    _form=SingleSpinInteractionForm(_domain, _spin_store);
+    _coeff=DipolarFieldInteractionCoeff(_domain, _spin_store, center_spin, state);
 
     make();
 }
 DipolarField::DipolarField(const vector<cSPIN>& spin_list, const vector<cSPIN>& source_list, const vector<PureState>& state_list)
 {
-    _spin_list=spin_list;
+    _spin_store=cSpinStore(spin_list);
 
-    _domain=SingleSpin(spin_list);
-    _form=SingleSpinInteractionForm(_domain);
-    _coeff=DipolarFieldInteractionCoeff(_domain, source_list, state_list);
+    _domain=SingleSpin( spin_list.size() );
+    _form=SingleSpinInteractionForm(_domain, _spin_store);
+    _coeff=DipolarFieldInteractionCoeff(_domain, _spin_store, source_list, state_list);
 
     make();
 }
 DipolarField::DipolarField(const vector<cSPIN>& spin_list, const vector<cSPIN>& source_list, const vector<PureState>& state_list, const uvec& exclude_idx)
 {
-    _spin_list=spin_list;
+    _spin_store=cSpinStore(spin_list);
 
-    _domain=SingleSpin(spin_list);
-    _form=SingleSpinInteractionForm(_domain);
+    _domain=SingleSpin( spin_list.size() );
+    _form=SingleSpinInteractionForm(_domain, _spin_store);
 
     vec mask = ones<vec>(source_list.size() );
     for(int i=0; i< exclude_idx.n_elem; ++i)
         mask( exclude_idx[i]) = 0.0;
-    _coeff=DipolarFieldInteractionCoeff(_domain, source_list, state_list, mask);
+    _coeff=DipolarFieldInteractionCoeff(_domain, _spin_store, source_list, state_list, mask);
+
+    make();
+}
+DipolarField::DipolarField(const vector<cSPIN>& spin_list, const cSpinStore& bath, const uvec& clst_idx, const mat& source_spin_vec)
+{
+/// spin_list is the cluster picked out of the bath by clst_idx; the bath spins out of the cluster are the sources.
+    _spin_store=cSpinStore(spin_list);
+
+    _domain=SingleSpin( spin_list.size() );
+    _form=SingleSpinInteractionForm(_domain, _spin_store);
+    _coeff=DipolarFieldInteractionCoeff(_domain, bath, clst_idx, source_spin_vec);
 
     make();
 }
@@ -37,31 +37,29 @@ ostream&  operator << (ostream& outs, const cSpinInteractionDomain& dm)
     }
     return outs;
 }
+
+void cSpinInteractionDomain::append(const INDICES& idx)
+{
+    _index_list.push_back(idx);
+    for(int i=0; i<idx.size(); ++i)
+        _index_array.push_back( idx[i] );
+}
 //}}}
 //----------------------------------------------------------------------------//
 //{{{ SpinPair
-SpinPair::SpinPair(const vector<cSPIN>& spin_list)
-{ //LOG(INFO) << "Constructor: SpinPair with spin_list";
-    size_t nspin=spin_list.size();
-
+SpinPair::SpinPair(size_t nspin)
+{ //LOG(INFO) << "Constructor: SpinPair with nspin";
     _nbody = 2;
 
+    size_t npair = nspin > 1 ? nspin*(nspin-1)/2 : 0;
+    _index_list.reserve(npair);
+    _index_array.reserve(2*npair);
     for(int i=0; i<nspin; ++i)
         for(int j=i+1; j<nspin; ++j)
         {
-            vector<size_t> x; x.push_back(i); x.push_back(j);
-            _index_list.push_back(x);
+            INDICES x; x.push_back(i); x.push_back(j);
+            append(x);
         }
-
-    //for(auto idx:_index_list)
-    //    _spin_aggregate.push_back( vector<cSPIN> { spin_list[ idx[0] ] , spin_list[ idx[1] ] });
-    for(int i=0; i<_index_list.size(); ++i)
-    {
-        vector<cSPIN> x;
-        x.push_back( spin_list[ _index_list[i][0] ] );
-        x.push_back( spin_list[ _index_list[i][1] ] );
-        _spin_aggregate.push_back(x);
-    }
 }
 SpinPair::~SpinPair()
 { //LOG(INFO) << "Default destructor: SpinPair.";
@@ -69,50 +67,27 @@ SpinPair::~SpinPair()
 //}}}
 //----------------------------------------------------------------------------//
 //{{{ SingleSpin
-SingleSpin::SingleSpin(const vector<cSPIN>& spin_list)
-{ //LOG(INFO) << "Constructor: SingleSpin with spin_list";
-    size_t nspin=spin_list.size();
-
+SingleSpin::SingleSpin(size_t nspin)
+{ //LOG(INFO) << "Constructor: SingleSpin with nspin";
     _nbody = 1;
 
-    //for(int i=0; i<nspin; ++i)
-    //    _index_list.push_back( vector<int> {i} );
+    _index_array.reserve(nspin);
     for(int i=0; i<nspin; ++i)
     {
-        vector<size_t> x; x.push_back(i);
-        _index_list.push_back(x);
-    }
-
-    //for(auto idx:_index_list)
-    //    _spin_aggregate.push_back( vector<cSPIN> { spin_list[ idx[0] ] });
-    for(int i=0; i<_index_list.size(); ++i)
-    {
-        vector<cSPIN> x;
-        x.push_back( spin_list[ _index_list[i][0] ] );
-        _spin_aggregate.push_back(x);
+        INDICES x; x.push_back(i);
+        append(x);
     }
 }
 
-SingleSpin::SingleSpin(const vector<cSPIN>& spin_list, const vector<int>& pick_up_spins)
-{ //LOG(INFO) << "Constructor: SingleSpin with spin_list and pick_up list.";
-    //size_t nspin=spin_list.size();
+SingleSpin::SingleSpin(const vector<int>& pick_up_spins)
+{ //LOG(INFO) << "Constructor: SingleSpin with pick_up list.";
     _nbody = 1;
 
-    //for(int i : pick_up_spins)
-    //    _index_list.push_back( vector<int> {i} );
+    _index_array.reserve( pick_up_spins.size() );
     for(int i=0; i<pick_up_spins.size(); ++i)
     {
-        vector<size_t> x; x.push_back(i);
-        _index_list.push_back(x);
-    }
-
-    //for(auto idx:_index_list)
-    //    _spin_aggregate.push_back( vector<cSPIN> { spin_list[ idx[0] ] });
-    for(int i=0; i<_index_list.size(); ++i)
-    {
-        vector<cSPIN> x;
-        x.push_back( spin_list[ _index_list[i][0] ] );
-        _spin_aggregate.push_back(x);
+        INDICES x; x.push_back( pick_up_spins[i] );
+        append(x);
     }
 }
 
@@ -180,51 +155,53 @@ ostream&  operator << (ostream& outs, cSpinInteractionForm& form)
 }
 //}}}
 //----------------------------------------------------------------------------//
+//{{{ spin operator table
+static void spin_operator_table(const cSpinStore& spin_store, vector<cx_mat>& sx, vector<cx_mat>& sy, vector<cx_mat>& sz)
+{
+/// The spin operators only depend on the isotope, 
+/// so they are built once for each isotope id of the store.
+    size_t niso = spin_store.getIsotopeNum();
+    sx.resize(niso); sy.resize(niso); sz.resize(niso);
+    vector<bool> done(niso, false);
+    for(int i=0; i<spin_store.getSpinNum(); ++i)
+    {
+        int id = spin_store.get_isotope_id(i);
+        if( done[id] ) continue;
+        cSPIN spin = spin_store.getSpin(i);
+        sx[id] = spin.sx(); sy[id] = spin.sy(); sz[id] = spin.sz();
+        done[id] = true;
+    }
+}
+//}}}
+//----------------------------------------------------------------------------//
 //{{{ TwoSpinInteractionFrom
-TwoSpinInteractionForm::TwoSpinInteractionForm(const cSpinInteractionDomain& domain)
+TwoSpinInteractionForm::TwoSpinInteractionForm(const cSpinInteractionDomain& domain, const cSpinStore& spin_store)
 {
     _nterm = 9;
 
-    //auto sag = domain.getSpinAggregate();
-    //for(auto it=sag.begin(); it!=sag.end(); ++it)
-    //{
-    //    cSPIN spin0=(*it)[0];    cSPIN spin1=(*it)[1];
-
-    //    vector<TERM> term_list;
+    vector<cx_mat> sx, sy, sz;
+    spin_operator_table(spin_store, sx, sy, sz);
 
-    //    term_list.push_back( TERM { spin0.sx(), spin1.sx() } );
-    //    term_list.push_back( TERM { spin0.sx(), spin1.sy() } );
-    //    term_list.push_back( TERM { spin0.sx(), spin1.sz() } );
-
-    //    term_list.push_back( TERM { spin0.sy(), spin1.sx() } );
-    //    term_list.push_back( TERM { spin0.sy(), spin1.sy() } );
-    //    term_list.push_back( TERM { spin0.sy(), spin1.sz() } );
-
-    //    term_list.push_back( TERM { spin0.sz(), spin1.sx() } );
-    //    term_list.push_back( TERM { spin0.sz(), spin1.sy() } );
-    //    term_list.push_back( TERM { spin0.sz(), spin1.sz() } );
-
-    //    _mat_list.push_back( term_list );
-    //}
-    vector< vector<cSPIN> > sag;
-    sag = domain.getSpinAggregate();
-    vector< vector<cSPIN> >::iterator it;
-    for(it=sag.begin(); it!=sag.end(); ++it)
+    size_t len = domain.getLength();
+    const INDICES& idx = domain.getIndexArray();
+    _mat_list.reserve(len);
+    for(int q=0; q<len; ++q)
     {
-        cSPIN spin0=(*it)[0];    cSPIN spin1=(*it)[1];
+        int id0 = spin_store.get_isotope_id( idx[2*q] );
+        int id1 = spin_store.get_isotope_id( idx[2*q+1] );
 
-        vector<TERM> term_list;
+        vector<TERM> term_list; term_list.reserve(_nterm);
 
         TERM t;  t.reserve(2);
-        t.push_back( spin0.sx() ); t.push_back( spin1.sx() ); term_list.push_back( t ); t.clear();
-        t.push_back( spin0.sx() ); t.push_back( spin1.sy() ); term_list.push_back( t ); t.clear();
-        t.push_back( spin0.sx() ); t.push_back( spin1.sz() ); term_list.push_back( t ); t.clear();
-        t.push_back( spin0.sy() ); t.push_back( spin1.sx() ); term_list.push_back( t ); t.clear();
-        t.push_back( spin0.sy() ); t.push_back( spin1.sy() ); term_list.push_back( t ); t.clear();
-        t.push_back( spin0.sy() ); t.push_back( spin1.sz() ); term_list.push_back( t ); t.clear();
-        t.push_back( spin0.sz() ); t.push_back( spin1.sx() ); term_list.push_back( t ); t.clear();
-        t.push_back( spin0.sz() ); t.push_back( spin1.sy() ); term_list.push_back( t ); t.clear();
-        t.push_back( spin0.sz() ); t.push_back( spin1.sz() ); term_list.push_back( t ); t.clear();
+        t.push_back( sx[id0] ); t.push_back( sx[id1] ); term_list.push_back( t ); t.clear();
+        t.push_back( sx[id0] ); t.push_back( sy[id1] ); term_list.push_back( t ); t.clear();
+        t.push_back( sx[id0] ); t.push_back( sz[id1] ); term_list.push_back( t ); t.clear();
+        t.push_back( sy[id0] ); t.push_back( sx[id1] ); term_list.push_back( t ); t.clear();
+        t.push_back( sy[id0] ); t.push_back( sy[id1] ); term_list.push_back( t ); t.clear();
+        t.push_back( sy[id0] ); t.push_back( sz[id1] ); term_list.push_back( t ); t.clear();
+        t.push_back( sz[id0] ); t.push_back( sx[id1] ); term_list.push_back( t ); t.clear();
+        t.push_back( sz[id0] ); t.push_back( sy[id1] ); term_list.push_back( t ); t.clear();
+        t.push_back( sz[id0] ); t.push_back( sz[id1] ); term_list.push_back( t ); t.clear();
 
         _mat_list.push_back( term_list );
     }
@@ -235,43 +212,35 @@ TwoSpinInteractionForm::~TwoSpinInteractionForm()
 //}}}
 //----------------------------------------------------------------------------//
 //{{{ SingleSpinInteractionForm
-SingleSpinInteractionForm::SingleSpinInteractionForm(const cSpinInteractionDomain& domain)
+SingleSpinInteractionForm::SingleSpinInteractionForm(const cSpinInteractionDomain& domain, const cSpinStore& spin_store)
 {
     _nterm = 6;
 
-    //auto sag = domain.getSpinAggregate();
-    //for(auto it=sag.begin(); it!=sag.end(); ++it)
-    //{
-    //    cSPIN spin0=(*it)[0];
-
-    //    vector<TERM> term_list;
-
-    //    term_list.push_back( TERM { spin0.sx() } );
-    //    term_list.push_back( TERM { spin0.sy() } );
-    //    term_list.push_back( TERM { spin0.sz() } );
-
-    //    term_list.push_back( TERM { spin0.sx()*spin0.sx() } );
-    //    term_list.push_back( TERM { spin0.sy()*spin0.sy() } );
-    //    term_list.push_back( TERM { spin0.sz()*spin0.sz() } );
+    vector<cx_mat> sx, sy, sz;
+    spin_operator_table(spin_store, sx, sy, sz);
+    size_t niso = sx.size();
+    vector<cx_mat> sxx(niso), syy(niso), szz(niso);
+    for(int id=0; id<niso; ++id)
+    {
+        sxx[id] = sx[id]*sx[id]; syy[id] = sy[id]*sy[id]; szz[id] = sz[id]*sz[id];
+    }
 
-    //    _mat_list.push_back( term_list );
-    //}
-    vector< vector<cSPIN> > sag;
-    sag = domain.getSpinAggregate();
-    vector< vector<cSPIN> >::iterator it;
-    for(it=sag.begin(); it!=sag.end(); ++it)
+    size_t len = domain.getLength();
+    const INDICES& idx = domain.getIndexArray();
+    _mat_list.reserve(len);
+    for(int q=0; q<len; ++q)
     {
-        cSPIN spin0=(*it)[0];
+        int id0 = spin_store.get_isotope_id( idx[q] );
 
-        vector<TERM> term_list;
+        vector<TERM> term_list; term_list.reserve(_nterm);
 
         TERM t;  t.reserve(1);
-        t.push_back( spin0.sx() ); term_list.push_back( t ); t.clear();
-        t.push_back( spin0.sy() ); term_list.push_back( t ); t.clear();
-        t.push_back( spin0.sz() ); term_list.push_back( t ); t.clear();
-        t.push_back( spin0.sx()*spin0.sx() ); term_list.push_back( t ); t.clear();
-        t.push_back( spin0.sy()*spin0.sy() ); term_list.push_back( t ); t.clear();
-        t.push_back( spin0.sz()*spin0.sz() ); term_list.push_back( t ); t.clear();
+        t.push_back( sx[id0] ); term_list.push_back( t ); t.clear();
+        t.push_back( sy[id0] ); term_list.push_back( t ); t.clear();
+        t.push_back( sz[id0] ); term_list.push_back( t ); t.clear();
+        t.push_back( sxx[id0] ); term_list.push_back( t ); t.clear();
+        t.push_back( syy[id0] ); term_list.push_back( t ); t.clear();
+        t.push_back( szz[id0] ); term_list.push_back( t ); t.clear();
 
         _mat_list.push_back( term_list );
     }
@@ -292,6 +261,35 @@ cSpinInteractionCoeff::cSpinInteractionCoeff()
 cSpinInteractionCoeff::~cSpinInteractionCoeff()
 { //LOG(INFO) << "Default destructor: cSpinInteractionCoeff.";
 }
+void cSpinInteractionCoeff::truncate_secular(const cSpinInteractionDomain& domain, const cSpinStore& spin_store)
+{
+/// Keep only the part of each term that commutes with the Zeeman Hamiltonian of each species,
+/// i.e. the secular part w.r.t. a strong field along z (heteronuclear flip-flops are dropped).
+/// single-spin terms (x, y, z, xx, yy, zz): z, zz and (xx+yy)/2 (SxSx+SySy);
+/// two-spin terms (xx, xy, ..., zz): zz, plus the flip-flop part
+/// (xx+yy)/2 (SxSx+SySy) + (xy-yx)/2 (SxSy-SySx) for two spins of the same isotope.
+/// The zeroed coefficients are dropped when the interaction is made.
+    for(int q=0; q<_coeff_list.size(); ++q)
+    {
+        Col<MULTIPLIER>& c = _coeff_list[q];
+        if(_nCoeff == 6)
+        {
+            double a = 0.5*(c(3)+c(4));
+            c(0) = 0.0; c(1) = 0.0;
+            c(3) = a;   c(4) = a;
+        }
+        else if(_nCoeff == 9)
+        {
+            bool is_homo = spin_store.get_isotope_id( domain.getIndex(q, 0) )
+                        == spin_store.get_isotope_id( domain.getIndex(q, 1) );
+            double a = is_homo ? 0.5*(c(0)+c(4)) : 0.0;
+            double b = is_homo ? 0.5*(c(1)-c(3)) : 0.0;
+            c(0) = a; c(1) = b;  c(2) = 0.0;
+            c(3) =-b; c(4) = a;  c(5) = 0.0;
+            c(6) = 0.0; c(7) = 0.0;
+        }
+    }
+}
 ostream&  operator << (ostream& outs, cSpinInteractionCoeff& coef)
 {
     //int i = 0;
@@ -319,26 +317,17 @@ ostream&  operator << (ostream& outs, cSpinInteractionCoeff& coef)
 //}}}
 //----------------------------------------------------------------------------//
 //{{{ DipolarInteractionCoeff
-DipolarInteractionCoeff::DipolarInteractionCoeff(const cSpinInteractionDomain& domain)
+DipolarInteractionCoeff::DipolarInteractionCoeff(const cSpinInteractionDomain& domain, const cSpinStore& spin_store, bool is_secular)
 {
     _nCoeff = 9;
 
-    //auto sag = domain.getSpinAggregate();
-    //for(auto it=sag.begin(); it!=sag.end(); ++it)
-    //{
-    //    cSPIN spin0=(*it)[0];    cSPIN spin1=(*it)[1];
-    //    vec coeffs = dipole(spin0, spin1);
-    //    _coeff_list.push_back(coeffs);
-    //}
-    vector< vector<cSPIN> > sag;
-    sag = domain.getSpinAggregate();
-    vector< vector<cSPIN> >::iterator it;
-    for(it=sag.begin(); it!=sag.end(); ++it)
-    {
-        cSPIN spin0=(*it)[0];    cSPIN spin1=(*it)[1];
-        vec coeffs = dipole(spin0, spin1);
-        _coeff_list.push_back(coeffs);
-    }
+    size_t len = domain.getLength();
+    mat dip = dipole(spin_store, domain.getIndexArray() );
+    _coeff_list.reserve(len);
+    for(int q=0; q<len; ++q)
+        _coeff_list.push_back( dip.col(q) );
+    if(is_secular)
+        truncate_secular(domain, spin_store);
 }
 DipolarInteractionCoeff::~DipolarInteractionCoeff()
 { //LOG(INFO) << "Default destructor: DipolarInteractionCoeff.";
@@ -346,26 +335,15 @@ DipolarInteractionCoeff::~DipolarInteractionCoeff()
 //}}}
 //----------------------------------------------------------------------------//
 //{{{ ZeemanInteractionCoeff
-ZeemanInteractionCoeff::ZeemanInteractionCoeff(const cSpinInteractionDomain& domain, const vec& magB)
+ZeemanInteractionCoeff::ZeemanInteractionCoeff(const cSpinInteractionDomain& domain, const cSpinStore& spin_store, const vec& magB)
 {
     _nCoeff = 6;
 
-    //auto sag = domain.getSpinAggregate();
-    //for(auto it=sag.begin(); it!=sag.end(); ++it)
-    //{
-    //    cSPIN spin0=(*it)[0];
-    //    vec coeffs = zeeman(spin0, magB);
-    //    _coeff_list.push_back(coeffs);
-    //}
-    vector< vector<cSPIN> > sag;
-    sag = domain.getSpinAggregate();
-    vector< vector<cSPIN> >::iterator it;
-    for(it=sag.begin(); it!=sag.end(); ++it)
-    {
-        cSPIN spin0=(*it)[0];
-        vec coeffs = zeeman(spin0, magB);
-        _coeff_list.push_back(coeffs);
-    }
+    size_t len = domain.getLength();
+    const INDICES& idx = domain.getIndexArray();
+    _coeff_list.reserve(len);
+    for(int q=0; q<len; ++q)
+        _coeff_list.push_back( zeeman(spin_store, idx[q], magB) );
 }
 ZeemanInteractionCoeff::~ZeemanInteractionCoeff()
 { //LOG(INFO) << "Default destructor: ZeemanInteractionCoeff.";
@@ -373,59 +351,90 @@ ZeemanInteractionCoeff::~ZeemanInteractionCoeff()
 //}}}
 //----------------------------------------------------------------------------//
 //{{{ DipolarFieldInteractionCoeff
-DipolarFieldInteractionCoeff::DipolarFieldInteractionCoeff(const cSpinInteractionDomain& domain, const cSPIN& center_spin, const PureState& state)
+DipolarFieldInteractionCoeff::DipolarFieldInteractionCoeff(const cSpinInteractionDomain& domain, const cSpinStore& spin_store, const cSPIN& center_spin, const PureState& state)
 { 
     _nCoeff = 6;
 
-    vector< vector<cSPIN> > sag;
-    sag = domain.getSpinAggregate();
-    vector< vector<cSPIN> >::iterator it;
-    for(it=sag.begin(); it!=sag.end(); ++it)
+    vec s_vec = center_spin.get_spin_vector( state.getVector() );
+
+    size_t len = domain.getLength();
+    const INDICES& idx = domain.getIndexArray();
+    _coeff_list.reserve(len);
+    for(int q=0; q<len; ++q)
     {
-        cSPIN spin0=(*it)[0];
-        vec dip_field = dipole_field(spin0, center_spin, state.getVector() );
+        vec dip_field = reshape( dipole(center_spin, spin_store, idx[q]), 3, 3) * s_vec;
         vec coeffs; coeffs << dip_field[0] << dip_field[1] << dip_field[2] << 0.0 << 0.0 << 0.0;
         _coeff_list.push_back(coeffs);
     }
 }
-DipolarFieldInteractionCoeff::DipolarFieldInteractionCoeff(const cSpinInteractionDomain& domain, const vector<cSPIN>& spin_list, const vector<PureState>& state_list)
+DipolarFieldInteractionCoeff::DipolarFieldInteractionCoeff(const cSpinInteractionDomain& domain, const cSpinStore& spin_store, const vector<cSPIN>& spin_list, const vector<PureState>& state_list)
 {
     _nCoeff = 6;
 
-    vector< vector<cSPIN> > sag;
-    sag = domain.getSpinAggregate();
-    vector< vector<cSPIN> >::iterator it;
-    for(it=sag.begin(); it!=sag.end(); ++it)
-    {
-        cSPIN spin0=(*it)[0];
+    vector<vec> s_vec_list; s_vec_list.reserve( spin_list.size() );
+    for(int i=0; i<spin_list.size(); ++i)
+        s_vec_list.push_back( spin_list[i].get_spin_vector( state_list[i].getVector() ) );
 
+    size_t len = domain.getLength();
+    const INDICES& idx = domain.getIndexArray();
+    _coeff_list.reserve(len);
+    for(int q=0; q<len; ++q)
+    {
         vec dip_field = zeros<vec>(3);
         for(int i=0; i<spin_list.size(); ++i)
-            dip_field += dipole_field(spin0, spin_list[i], state_list[i].getVector() );
+            dip_field += reshape( dipole(spin_list[i], spin_store, idx[q]), 3, 3) * s_vec_list[i];
         
         vec coeffs; coeffs << dip_field[0] << dip_field[1] << dip_field[2] << 0.0 << 0.0 << 0.0;
         _coeff_list.push_back(coeffs);
     }
 }
-DipolarFieldInteractionCoeff::DipolarFieldInteractionCoeff(const cSpinInteractionDomain& domain, const vector<cSPIN>& spin_list, const vector<PureState>& state_list, const vec& pre_factor_list)
+DipolarFieldInteractionCoeff::DipolarFieldInteractionCoeff(const cSpinInteractionDomain& domain, const cSpinStore& spin_store, const vector<cSPIN>& spin_list, const vector<PureState>& state_list, const vec& pre_factor_list)
 {
     _nCoeff = 6;
 
-    vector< vector<cSPIN> > sag;
-    sag = domain.getSpinAggregate();
-    vector< vector<cSPIN> >::iterator it;
-    for(it=sag.begin(); it!=sag.end(); ++it)
-    {
-        cSPIN spin0=(*it)[0];
+    vector<vec> s_vec_list; s_vec_list.reserve( spin_list.size() );
+    for(int i=0; i<spin_list.size(); ++i)
+        s_vec_list.push_back( pre_factor_list[i] * spin_list[i].get_spin_vector( state_list[i].getVector() ) );
 
+    size_t len = domain.getLength();
+    const INDICES& idx = domain.getIndexArray();
+    _coeff_list.reserve(len);
+    for(int q=0; q<len; ++q)
+    {
         vec dip_field = zeros<vec>(3);
         for(int i=0; i<spin_list.size(); ++i)
-            dip_field += pre_factor_list[i] * dipole_field(spin0, spin_list[i], state_list[i].getVector() );
+            if( pre_factor_list[i] != 0.0 )
+                dip_field += reshape( dipole(spin_list[i], spin_store, idx[q]), 3, 3) * s_vec_list[i];
         
         vec coeffs; coeffs << dip_field[0] << dip_field[1] << dip_field[2] << 0.0 << 0.0 << 0.0;
         _coeff_list.push_back(coeffs);
     }
 }
+DipolarFieldInteractionCoeff::DipolarFieldInteractionCoeff(const cSpinInteractionDomain& domain, const cSpinStore& bath, const uvec& clst_idx, const mat& source_spin_vec)
+{
+/// The i-th spin of the cluster is the clst_idx[i]-th spin of the bath;
+/// the field is summed over all the bath spins out of the cluster.
+/// source_spin_vec is a 3xN matrix, each column is the spin vector of a bath spin.
+    _nCoeff = 6;
+
+    vec weight = ones<vec>( bath.getSpinNum() );
+    for(int i=0; i<clst_idx.n_elem; ++i)
+        weight[ clst_idx[i] ] = 0.0;
+
+    size_t len = domain.getLength();
+    const INDICES& idx = domain.getIndexArray();
+    uvec target(len);
+    for(int q=0; q<len; ++q)
+        target[q] = clst_idx[ idx[q] ];
+    mat dip_field = dipole_field(bath, target, source_spin_vec, weight);
+
+    _coeff_list.reserve(len);
+    for(int q=0; q<len; ++q)
+    {
+        vec coeffs; coeffs << dip_field(0, q) << dip_field(1, q) << dip_field(2, q) << 0.0 << 0.0 << 0.0;
+        _coeff_list.push_back(coeffs);
+    }
+}
 
 DipolarFieldInteractionCoeff::~DipolarFieldInteractionCoeff()
 { //LOG(INFO) << "Default destructor: DipolarFieldInteractionCoeff";
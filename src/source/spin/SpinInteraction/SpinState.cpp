@@ -36,10 +36,10 @@ SpinPolarization::SpinPolarization()
 
 SpinPolarization::SpinPolarization(const vector<cSPIN>& spin_list, const vector<int>& index_list, const vector<vec>& pol_list)
 {
-    _spin_list=spin_list;
+    _spin_store=cSpinStore(spin_list);
 
-    _domain=SingleSpin(spin_list, index_list);
-    _form=SingleSpinInteractionForm(_domain);
+    _domain=SingleSpin(index_list);
+    _form=SingleSpinInteractionForm(_domain, _spin_store);
     _coeff=PolarizationCoeff(_domain, pol_list);
 
     make();
@@ -47,13 +47,13 @@ SpinPolarization::SpinPolarization(const vector<cSPIN>& spin_list, const vector<
 
 SpinPolarization::SpinPolarization(const vector<cSPIN>& spin_list, const vec& pol)
 {
-    _spin_list=spin_list;
+    _spin_store=cSpinStore(spin_list);
     vector<vec> pol_list;
     for(int i=0; i<spin_list.size(); ++i)
         pol_list.push_back(pol);
 
-    _domain=SingleSpin(spin_list);
-    _form=SingleSpinInteractionForm(_domain);
+    _domain=SingleSpin( spin_list.size() );
+    _form=SingleSpinInteractionForm(_domain, _spin_store);
     _coeff=PolarizationCoeff(_domain, pol_list);
 
     make();